@@ -6,7 +6,11 @@
 #ifndef BUDDY_H
 #define BUDDY_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "utils.h"
 #include "list/kdoubly_linked_list.h"
@@ -17,107 +21,269 @@
 //
 // Print config
 //
-#define DBG_ENABLE					0
-#define ERR_ENABLE					0
+#define BUDDY_DBG_ENABLE			0
+#define BUDDY_ERR_ENABLE			0
 
 //
 // Print macros
 //
-#if DBG_ENABLE
+#if BUDDY_DBG_ENABLE
     #define BUDDY_DBG(fmt, ...)	printf("DBG: %s: " fmt, __func__, ##__VA_ARGS__)
 #else
     #define BUDDY_DBG(fmt, ...)
 #endif
 
-#if ERR_ENABLE
+#if BUDDY_ERR_ENABLE
     #define BUDDY_ERR(fmt, ...)	printf("ERR: %s: " fmt, __func__, ##__VA_ARGS__)
 #else
     #define BUDDY_ERR(fmt, ...)
 #endif
 
 
+/*****************************************************************************/
+
+/**
+ * Buddy Allocator Overview
+ * ------------------------
+ * The allocator manages an arena of `size` bytes (page multiple), mapped with
+ * mmap, as blocks of 2^order pages, order 0 to BUDDY_MAX_ORDER.
+ *
+ *   - Free blocks of each order are kept in a free list, whose nodes live in
+ *     the free blocks themselves (no metadata per free block).
+ *   - A bitmap per order tells whether a block is in its free list, so the
+ *     buddy of a freed block is checked in O(1) when merging.
+ *   - A mask of non-empty free lists gives the smallest order with a free
+ *     block, at least the requested one, with a single ctz. That block is
+ *     split down to the requested order in one pass, so allocation does not
+ *     depend on fragmentation.
+ *   - The order of each allocated block is kept in a byte per page (first
+ *     page of the block), so `buddy_free()` needs no size.
+ *   - Arenas need not be a power of two: the arena is split into the largest
+ *     aligned blocks fitting in it, buddies past its end are never free.
+ *
+ * Bitmaps and orders (~0.03% of the arena) are allocated from the heap, the
+ * arena pages are only touched when used (MAP_NORESERVE).
+ *
+ * Thread Safety:
+ * --------------
+ *   - Blocks are split and merged under the buddy lock.
+ *   - Single pages (order 0, the most frequent request) are served from per
+ *     cpu page lists, each one with its own lock (uncontended as long as the
+ *     threads run on different cpus). A cpu list is refilled from the buddy
+ *     BUDDY_PCP_BATCH pages at a time, and drained by BUDDY_PCP_BATCH pages
+ *     once it holds more than BUDDY_PCP_HIGH, so the buddy lock is taken once
+ *     per batch (Linux pcp lists).
+ *   - Cpu lists are only used by arenas of at least BUDDY_PCP_MIN_PAGES
+ *     pages, so they hold at most a quarter of the arena. Batches would
+ *     fragment smaller arenas, whose pages are allocated under the lock.
+ *   - Pages of a cpu list are free (double free is still detected) but not
+ *     merged. When an allocation fails, all cpu lists are drained and the
+ *     allocation retried, before asking the shrinkers (`buddy_drain()` does
+ *     it on demand).
+ *
+ * Statistics:
+ * -----------
+ *   - `buddy_stats()` returns free blocks per order, free pages (cpu lists
+ *     included), largest free block, fragmentation, split/merge counters and
+ *     alloc/free latency histograms.
+ *   - Free blocks and split/merge counters are kept under the buddy lock,
+ *     operation counters per cpu (relaxed atomics, no shared cache line).
+ *   - Latency is measured for one of every BUDDY_STATS_SAMPLE operations of
+ *     each thread, in power of two buckets of nanoseconds (bucket i counts
+ *     [2^i, 2^(i+1)) ns, the last one everything above).
+ *   - Fragmentation is 1 - largest free block / free memory: 0 when all free
+ *     memory is a single block, close to 1 when it is scattered in pages.
+ *
+ * With BUDDY_HUGEPAGE, the arena is backed by huge pages (MAP_HUGETLB) when
+ * the system has them reserved, otherwise it is aligned to BUDDY_HUGEPAGE_SIZE
+ * and marked for transparent huge pages (MADV_HUGEPAGE).
+ *
+ * With `buddy_init_node()`, the arena pages are placed on a NUMA node (mbind
+ * with MPOL_PREFERRED, before any page is touched): pages come from the node
+ * while it has free memory, from other nodes afterwards instead of failing.
+ */
+
+
 /*****************************************************************************/
 
 //
-// Buddy (32 pages in total + xtra to ensure alignemnt)
+// Orders (largest block is 2^BUDDY_MAX_ORDER pages, 4GiB)
 //
-#define BUDDY_ORDERS		5
-#define BUDDY_MEM			((1 << BUDDY_ORDERS) * PAGE_SIZE)
-#define BUDDY_XTRA			(PAGE_SIZE - 1)
+#define BUDDY_MAX_ORDER		20
+
+_Static_assert(BUDDY_MAX_ORDER < 32, "Free orders do not fit in mask");
 
 //
-// Buddy total memory
+// Creation flags
 //
-#define BUDDY_TOTAL_MEM		(BUDDY_MEM + BUDDY_XTRA)
+#define BUDDY_HUGEPAGE		(1U << 0)	// huge pages backing
 
+#define BUDDY_FLAGS_MASK	(BUDDY_HUGEPAGE)
 
-/*****************************************************************************/
+#define BUDDY_HUGEPAGE_SIZE	(2 * _1MiB)
 
 //
-// Convert memory size to order
+// NUMA nodes
 //
-#define SIZE_2_PAGES(x)		((PAGE_ALIGN(x)) / (PAGE_SIZE))
-#define PAGES_2_ORDER(x)	((x) == 1 ? 0 : 32 - __builtin_clz((x) - 1))
-#define SIZE_2_ORDER(x)		(PAGES_2_ORDER(SIZE_2_PAGES(x)))
+#define BUDDY_NODE_ANY		(-1)	// default memory policy
+#define BUDDY_MAX_NODES		64
 
 //
-// Convert from order to tree level
+// Per cpu page lists
 //
-#define ORDER_2_LEVEL(x)	(BUDDY_ORDERS - (x))
-#define LEVEL_2_ORDER(x)	(ORDER_2_LEVEL(x))
+#define BUDDY_MAX_CPUS		16
+#define BUDDY_PCP_BATCH		16		// pages moved from/to buddy at once
+#define BUDDY_PCP_HIGH		64		// pages kept by a cpu list
+#define BUDDY_PCP_MIN_PAGES	(4 * BUDDY_MAX_CPUS * (BUDDY_PCP_HIGH + 1))
 
 //
-// Tree levels
+// Statistics
+//
+#define BUDDY_STATS_SAMPLE	64		// operations per latency sample
+#define BUDDY_LAT_BUCKETS	24		// 1ns to 8ms and above
+
 //
-#define LEN_OF_LEVEL(n)		(1ULL << (n))
-#define SIZE_OF_LEVEL(n)	(BUDDY_MEM / LEN_OF_LEVEL(n))
+// Memory pressure callbacks (asked to release memory when allocation fails)
+//
+#define BUDDY_MAX_SHRINKERS	4
+
 
+/*****************************************************************************/
 
 //
-// Make sure tree mask is not exceeded by updating 'BUDDY_ORDERS'
+// Convert memory size to order
 //
+#define SIZE_2_PAGES(x)		((PAGE_ALIGN(x)) / (PAGE_SIZE))
+#define PAGES_2_ORDER(x)	((x) == 1 ? 0 : 64 - __builtin_clzll((x) - 1))
+#define SIZE_2_ORDER(x)		(PAGES_2_ORDER(SIZE_2_PAGES(x)))
 
-#if ((1ULL << (BUDDY_ORDERS + 1)) - 1) > 64
-	#error "BUDDY_ORDERS exceeds the number of bits available in tree_mask!"
-#endif
+//
+// Block size of order
+//
+#define ORDER_2_SIZE(x)		((size_t)PAGE_SIZE << (x))
 
 
 /*****************************************************************************/
 
-typedef enum blk_status_s {
+// Return number of bytes released
+typedef size_t (*buddy_shrink_cb)(void *arg);
+
+typedef struct buddy_shrinker_s {
 
-	BLK_FREE = 0,
-	BLK_SPLIT,
-	BLK_ALLOCATED,
+	buddy_shrink_cb				shrink;
+	void						*arg;
 
-} blk_status_e;
+} buddy_shrinker_t;
 
 
 /*****************************************************************************/
 
+// per cpu free pages (order 0) and operation counters
+typedef struct buddy_pcp_s {
+
+	pthread_mutex_t				lock;
+
+	//
+	kdlist_head_t				pages;
+	size_t						count;
+
+	//
+	atomic_size_t				allocs;
+	atomic_size_t				frees;
+	atomic_size_t				failures;
+	atomic_size_t				alloc_lat[BUDDY_LAT_BUCKETS];
+	atomic_size_t				free_lat[BUDDY_LAT_BUCKETS];
+
+} __attribute__((aligned(64))) buddy_pcp_t;
+
+//
+typedef struct buddy_stats_s {
+
+	size_t						free_blocks[BUDDY_MAX_ORDER+1];
+	size_t						free_pages;		// cpu lists included
+	size_t						pcp_pages;		// free pages in cpu lists
+	size_t						largest_free;	// bytes
+	double						fragmentation;	// 0 to 1
+
+	//
+	size_t						splits;
+	size_t						merges;
+
+	//
+	size_t						allocs;
+	size_t						frees;
+	size_t						failures;
+
+	// sampled latency, bucket i is [2^i, 2^(i+1)) ns
+	size_t						alloc_lat[BUDDY_LAT_BUCKETS];
+	size_t						free_lat[BUDDY_LAT_BUCKETS];
+
+} buddy_stats_t;
+
 typedef struct buddy_s {
 
 	void						*mem;
-	kdlist_head_t				free_list[BUDDY_ORDERS+1];
-	uint64_t					tree_mask;
+	size_t						size;			// arena size (bytes)
+	size_t						pages;
+	int							orders;			// largest block order
+	uint32_t					flags;
+	bool						hugetlb;		// MAP_HUGETLB backing
+	int							node;			// NUMA node or BUDDY_NODE_ANY
+	bool						pcp_enabled;	// per cpu page lists
+
+	//
+	pthread_mutex_t				lock;			// free lists and shrinkers
+	kdlist_head_t				free_list[BUDDY_MAX_ORDER+1];
+	uint32_t					free_orders;	// non-empty free lists
+	size_t						free_blocks[BUDDY_MAX_ORDER+1];
+	uint64_t					*free_map[BUDDY_MAX_ORDER+1];	// in free list
+	uint8_t						*blk_order;		// allocated order + 1 per page
+
+	//
+	size_t						splits;
+	size_t						merges;
+
+	//
+	buddy_shrinker_t			shrinkers[BUDDY_MAX_SHRINKERS];
+	int							shrinkers_no;
+
+	//
+	buddy_pcp_t					pcp[BUDDY_MAX_CPUS];
 
 } buddy_t;
 
 
 /*****************************************************************************/
 
-// Initialize buddy allocator
-buddy_t *buddy_init(void);
+// Initialize buddy allocator (size rounded up to pages)
+buddy_t *buddy_init(size_t size);
+buddy_t *buddy_init_flags(size_t size, uint32_t flags);
+buddy_t *buddy_init_node(size_t size, uint32_t flags, int node);
 
 // Destroy buddy allocator
 void buddy_destroy(buddy_t *buddy);
 
-// Alloc memory
-void *buddy_alloc(buddy_t *buddy, uint32_t bytes_no);
+// Alloc memory (thread safe)
+void *buddy_alloc(buddy_t *buddy, size_t bytes_no);
 
-// Free memory
+// Free memory (thread safe)
 int buddy_free(buddy_t *buddy, void *addr);
 
+// Give pages of per cpu lists back to buddy
+void buddy_drain(buddy_t *buddy);
+
+// Fragmentation and latency statistics
+int buddy_stats(buddy_t *buddy, buddy_stats_t *stats);
+
+// Check if address belongs to buddy memory
+bool buddy_contains(buddy_t *buddy, void *addr);
+
+// Memory pressure callbacks, called (and allocation retried once) when an
+// allocation fails
+int buddy_register_shrinker(buddy_t *buddy, buddy_shrink_cb shrink, void *arg);
+int buddy_unregister_shrinker(buddy_t *buddy, buddy_shrink_cb shrink,
+							void *arg);
+
 // Dump buddy allocator info
 void buddy_dump(buddy_t *buddy);
 
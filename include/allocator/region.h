@@ -0,0 +1,151 @@
+/**
+ * Region (bump pointer) allocator with checkpoints and bulk reset.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#ifndef REGION_H
+#define REGION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "utils.h"
+#include "allocator/buddy.h"
+
+
+/*****************************************************************************/
+
+//
+// Print config
+//
+#define REGION_DBG_ENABLE			0
+#define REGION_ERR_ENABLE			0
+
+//
+// Print macros
+//
+#if REGION_DBG_ENABLE
+    #define REGION_DBG(fmt, ...)	printf("DBG: %s: " fmt, __func__, ##__VA_ARGS__)
+#else
+    #define REGION_DBG(fmt, ...)
+#endif
+
+#if REGION_ERR_ENABLE
+    #define REGION_ERR(fmt, ...)	printf("ERR: %s: " fmt, __func__, ##__VA_ARGS__)
+#else
+    #define REGION_ERR(fmt, ...)
+#endif
+
+
+/*****************************************************************************/
+
+/**
+ * Region Allocator Overview
+ * -------------------------
+ * Objects with the same lifetime (e.g. all the structures of a request) are
+ * allocated from a region by moving a pointer forward, and freed all together
+ * by moving it back. There is no per object free and no per object header.
+ *
+ *   chunk 0               chunk 1               chunk 2 (spare)
+ *   +--------+--------+   +--------+--------+   +-----------------+
+ *   | header | used   |-->| header | used | |-->| header |        |
+ *   +--------+--------+   +--------+------|-+   +-----------------+
+ *                                         pos
+ *
+ *   - Memory comes in chunks of at least `chunk_size` bytes, taken from the
+ *     buddy allocator given to `region_create()` (sizes rounded up to power
+ *     of two pages), or from malloc when it is NULL or exhausted.
+ *   - Chunks are chained, allocation only looks at the current one: when it
+ *     is full, the next chunk is used (kept from a previous reset, if large
+ *     enough) or a new one is inserted after the current one. A request
+ *     larger than `chunk_size` gets a chunk of its own.
+ *   - Objects are REGION_ALIGN aligned (like malloc), `region_alloc_align()`
+ *     gives any power of two alignment up to PAGE_SIZE.
+ *
+ * Checkpoints and Reset:
+ * ----------------------
+ *   - `region_mark()` saves the current position (chunk and pointer),
+ *     `region_rewind()` frees everything allocated after it, in O(1).
+ *   - `region_reset()` frees everything (rewind to the first chunk).
+ *   - Chunks are kept for reuse after a rewind, `region_trim()` gives back
+ *     the chunks past the current position.
+ *
+ * A region is not thread safe, it is meant to be owned by a single thread
+ * (one region per request or per worker).
+ */
+
+
+/*****************************************************************************/
+
+//
+// Objects alignment (malloc)
+//
+#define REGION_ALIGN				16
+
+//
+// Chunk size (default, bytes)
+//
+#define REGION_CHUNK_SIZE			(16 * PAGE_SIZE)
+
+
+/****************************** DATA STRUCTURE *******************************/
+
+typedef struct region_chunk_s {
+
+	struct region_chunk_s			*next;
+	size_t							size;		// bytes (header included)
+	bool							buddy;		// from buddy (or malloc)
+
+	// objects follow the header
+	uint8_t							mem[] __attribute__((aligned(REGION_ALIGN)));
+
+} region_chunk_t;
+
+typedef struct region_s {
+
+	//
+	buddy_t							*buddy;		// chunks allocator (or NULL)
+	size_t							chunk_size;
+
+	//
+	region_chunk_t					*first;
+	region_chunk_t					*chunk;		// current chunk
+	uint8_t							*pos;		// next free byte of chunk
+	uint8_t							*end;		// end of chunk
+
+} region_t;
+
+// position in a region (checkpoint)
+typedef struct region_mark_s {
+
+	region_chunk_t					*chunk;
+	uint8_t							*pos;
+
+} region_mark_t;
+
+
+/******************************** PUBLIC API *********************************/
+
+// Create region (buddy may be NULL, chunk_size 0 for REGION_CHUNK_SIZE)
+region_t *region_create(buddy_t *buddy, size_t chunk_size);
+void region_destroy(region_t *region);
+
+// Allocate memory (REGION_ALIGN or given alignment)
+void *region_alloc(region_t *region, size_t size);
+void *region_alloc_align(region_t *region, size_t size, size_t align);
+
+// Checkpoints
+region_mark_t region_mark(region_t *region);
+void region_rewind(region_t *region, region_mark_t mark);
+
+// Free all objects (chunks kept for reuse)
+void region_reset(region_t *region);
+
+// Give back chunks past the current position
+void region_trim(region_t *region);
+
+// Bytes of all chunks (headers included)
+size_t region_size(region_t *region);
+
+#endif	// REGION_H
@@ -7,8 +7,11 @@
 #define SLAB_H
 
 #include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "utils.h"
+#include "allocator/buddy.h"
 #include "list/kdoubly_linked_list.h"
 
 /*****************************************************************************/
@@ -16,9 +19,8 @@
 //
 // CONFIG
 //
-#define DBG_ENABLE					1
-#define ERR_ENABLE					1
-#define RED_ZONE					1
+#define SLAB_DBG_ENABLE				0
+#define SLAB_ERR_ENABLE				1
 
 
 /*****************************************************************************/
@@ -27,27 +29,47 @@
  * Slab Allocator Overview
  * ------------------------
  * This slab allocator manages memory in chunks called "slabs", each backed
- * by a memory region of page size (4096 bytes).
+ * by a memory region of 2^order pages (4096 bytes to 2^SLAB_MAX_ORDER pages).
  *
  * Each slab contains:
- *   - Metadata (bitmap, count, list node, padding)
+ *   - Metadata (count, free word hint, list node, bitmap, padding)
  *   - A series of aligned objects (32B, 64B, etc.)
- *   - Optional red zones for buffer overflow detection (enabled via macro)
+ *   - Optional red zones for buffer overflow detection (SLAB_RED_ZONE caches)
  *
- * The object region is aligned to SLAB_OBJ_ALIGNMENT (e.g., 64B) to ensure
- * efficient cache usage and to avoid false sharing.
+ * The object region and the objects are aligned to the cache alignment,
+ * selected by a creation flag (SLAB_ALIGN_8, SLAB_ALIGN_16 or
+ * SLAB_HWCACHE_ALIGN, the default, to avoid false sharing).
+ *
+ * Slab Size (order):
+ * ------------------
+ *   - Each cache selects its own slab order at creation time: the smallest
+ *     order wasting at most 1/SLAB_WASTE_RATIO of the slab (header, padding
+ *     and unused tail), or the order wasting the least otherwise.
+ *   - Slabs are aligned to their size, so the slab of an object is found by
+ *     masking its address with the slab size of its cache.
+ *   - Without the cache (`slab_cache_of()`), the slab is found by probing the
+ *     2^order aligned addresses below the object, from order 0 up, for a
+ *     header with SLAB_MAGIC and the matching order. Lower probes read object
+ *     bytes, so a header is only trusted if its cache id names a registered
+ *     cache with the same address and slab order (a forged header is
+ *     skipped, probing goes on).
  *
  * ┌──────────────────────────────┐
  * │          slab_t              │
  * ├──────────────────────────────┤
  * │ uint64_t magic               │ // metadata
- * │ uint64_t *bitmap             │
- * │ size_t    count              │
+ * │ uint32_t count               │
+ * │ uint32_t free_idx            │
+ * │ uint16_t cpu_id              │
+ * │ uint16_t order               │
+ * │ uint32_t cache_id            │
+ * │ slab_cache_s *slab_cache     │
  * │ kdlist_node_t node           │
+ * │ uint64_t bitmap[]            │ // bitmap_size words
  * ├──────────────────────────────┤
- * │ uint8_t _pad[]               │ // padding to align `mem[]` start
+ * │ padding                      │ // padding to align objects start
  * ├──────────────────────────────┤
- * │ uint8_t mem[]                │ // start of aligned objects
+ * │ mem (slab + mem_offset)      │ // start of aligned objects
  * │ ┌──────────────┐             │
  * │ │   object 0   │ ← aligned   │
  * │ ├──────────────┤             │
@@ -65,19 +87,106 @@
  * │ └──────────────┘             │
  * └──────────────────────────────┘
  *
+ * Free Tracking:
+ * --------------
+ *   - The allocation bitmap lives in the slab header, so a slab is exactly
+ *     one block and needs no other heap metadata. Its size depends on the
+ *     objects per slab of the cache.
+ *   - Bits past the last object are set when the slab is created, so every
+ *     bitmap word is handled the same way (full when all ones).
+ *   - `free_idx` is the first bitmap word with a free bit (all words before
+ *     it are full). Allocation takes the lowest free bit of that word
+ *     (ctz), free lowers the hint, so both are O(1) in practice.
+ *
  * Alignment guarantees:
  * ---------------------
- *   - slab itself is page-aligned (posix_memalign)
- *   - mem[] starts at SLAB_OBJ_ALIGNMENT boundary
- *   - All objects are SLAB_OBJ_ALIGNMENT-aligned
+ *   - slab itself is aligned to its size (posix_memalign or arena block)
+ *   - mem starts at cache alignment boundary
+ *   - All objects are aligned to cache alignment
+ *
+ * Debug Caches (optional):
+ * ------------------------
+ * Debugging is selected per cache by creation flags, so caches created
+ * without them pay a single flags test on alloc/free:
+ *
+ *   - SLAB_RED_ZONE: the bytes after each object, up to the next 8 bytes
+ *     boundary plus RED_ZONE_SIZE, are filled with RED_ZONE_MAGIC when the
+ *     slab is created and validated on every free (buffer overruns).
+ *   - SLAB_POISON: free objects are filled with SLAB_POISON_FREE (on slab
+ *     creation and on every free) and validated on every alloc, so writes to
+ *     freed objects (use after free) are caught when the object is reused.
+ *   - SLAB_CONSISTENCY_CHECKS: every free address is validated (slab header,
+ *     owner cache, object boundary) and objects skip the thread magazines,
+ *     so double frees are caught right away by the slab bitmap.
+ *   - SLAB_DEBUG enables all of them.
+ *
+ * Without SLAB_CONSISTENCY_CHECKS, invalid and double frees are only caught
+ * when objects go back to their slab (see Magazine Layer).
+ *
+ * Magazine Layer (thread safety):
+ * -------------------------------
+ *
+ *   thread 0               thread 1                  (lock-free, O(1))
+ *   loaded | previous      loaded | previous         magazines of objects
+ *       \                     /
+ *        +------ depot ------+                       (locked, batches)
+ *        | full | empty      |                       magazines
+ *        +-------------------+
+ *                 |
+ *   per cpu slabs [cpu 0] [cpu 1] ... [MAX_CPUS-1]   (locked per cpu)
+ *
+ *   - Each thread owns two magazines (arrays of SLAB_MAG_SIZE objects).
+ *     Alloc/free pop/push objects from/to the loaded magazine, swapping it
+ *     with the previous one when empty/full. No lock or atomic is used.
+ *   - When both magazines are empty (full), a full (empty) magazine is
+ *     exchanged with the depot, under the depot lock.
+ *   - The depot is refilled (drained) SLAB_MAG_SIZE objects at a time from
+ *     (to) the per cpu slabs. Each slab remembers its cpu, so objects freed
+ *     by any thread are returned to the lists (and lock) of the cpu owning
+ *     the slab.
+ *   - `cpu_id` selects the per cpu slabs used to refill the depot. Use
+ *     SLAB_CPU_ANY to select it automatically (current cpu of the thread).
+ *     An id out of [0, MAX_CPUS) is rejected: `slab_cache_free()` leaves
+ *     the object alone, `slab_cache_alloc()` returns NULL once its magazines
+ *     need a refill (the allocation fast path does not check it).
+ *   - Thread magazines are given back to the depot when the thread exits.
+ *     The magazines of all caches hang off a single thread key, in a per
+ *     thread table indexed by cache id (ids are reused, a generation number
+ *     tells stale entries apart), so the number of caches is not limited by
+ *     PTHREAD_KEYS_MAX (but by SLAB_MAX_CACHES).
+ *   - Double free is only detected when objects go back to their slab.
+ *
+ * Reclaim:
+ * --------
+ *   - Each cpu keeps at most `free_slabs_max` free slabs (watermark, default
+ *     SLAB_FREE_SLABS_MAX, see `slab_cache_set_watermark()`). A slab becoming
+ *     free above the watermark is released on the spot, so memory is given
+ *     back as traffic goes down, with no background thread.
+ *   - `slab_cache_reclaim()` drains the depot and releases all free slabs of
+ *     all cpus. `slab_reclaim_all()` does it for every slab cache (caches are
+ *     registered on creation).
+ *   - `slab_shrinker()` is registered as memory pressure callback of every
+ *     slabs arena (`buddy_register_shrinker()`): when the arena is exhausted,
+ *     the caches of the arena are reclaimed and the bytes given back to it
+ *     are reported, so the failed arena allocation is retried. The cpu lock
+ *     is not held while slab memory is allocated, so a cache can reclaim
+ *     itself from its own allocation path.
+ *   - Objects cached in thread magazines are only given back when threads
+ *     exit.
  *
- * Red Zone Support (optional):
- * ----------------------------
- *   - Red zones are placed *after* each object
- *   - They are filled with a known byte pattern (RED_ZONE_MAGIC)
- *   - On free, the red zone is validated for corruption
- *   - Used for detecting buffer overruns during testing/debug
- *   - Enabled by defining `SLAB_ENABLE_REDZONE` macro
+ * Slab Memory (huge pages, NUMA):
+ * -------------------------------
+ *   - Slabs are allocated with posix_memalign by default.
+ *   - Slabs of SLAB_HUGEPAGE caches and of node caches
+ *     (`slab_cache_create_node()`) come from a buddy arena of the node (one
+ *     per node, shared by its caches, created with the first cache and
+ *     destroyed with the last one). Arenas are SLAB_ARENA_SIZE of huge pages
+ *     (`buddy_init_node()` with BUDDY_HUGEPAGE), so slabs of a cache share
+ *     TLB entries and are allocated on the node of the cache.
+ *   - Arena blocks are aligned to their size (arenas are huge page aligned),
+ *     as slabs must be.
+ *   - When its arena is exhausted, a cache takes slabs from posix_memalign
+ *     again (no placement), instead of failing.
  */
 
 /*****************************************************************************/
@@ -85,13 +194,13 @@
 //
 // Print macros
 //
-#if DBG_ENABLE
+#if SLAB_DBG_ENABLE
     #define SLAB_DBG(fmt, ...)	printf("DBG: %s: " fmt, __func__, ##__VA_ARGS__)
 #else
     #define SLAB_DBG(fmt, ...)
 #endif
 
-#if ERR_ENABLE
+#if SLAB_ERR_ENABLE
     #define SLAB_ERR(fmt, ...)	printf("ERR: %s: " fmt, __func__, ##__VA_ARGS__)
 #else
     #define SLAB_ERR(fmt, ...)
@@ -101,7 +210,8 @@
 /*****************************************************************************/
 
 #define SLAB_MAGIC					0xDEADBEEFCAFEBABEULL
-#define RED_ZONE_MAGIC				0xDEDEDEDEDEDEDEDEULL
+#define RED_ZONE_MAGIC				0xDE		// red zone byte
+#define SLAB_POISON_FREE			0x6B		// free object byte
 
 /*****************************************************************************/
 
@@ -110,43 +220,89 @@
 //
 #define MAX_CPUS					16
 
+// Automatic cpu selection (sched_getcpu)
+#define SLAB_CPU_ANY				(-1)
+
 //
-// Alignemnt (cache line)
+// Magazines
 //
-#define SLAB_OBJ_ALIGNMENT			64
+#define SLAB_MAG_SIZE				32		// objects per magazine
+#define SLAB_DEPOT_MAX_MAGS			16		// full magazines kept by depot
+#define SLAB_TCACHE_TABLE_MIN		32		// thread table entries (initial)
 
 //
-// Memory
+// Caches alive at the same time (cache ids)
 //
-#define RED_ZONE_SIZE				(sizeof(uint64_t))
-#define SLAB_BLK_SIZE				PAGE_SIZE
-#define SLAB_MEM_SIZE				(SLAB_BLK_SIZE - sizeof(slab_t))
+#define SLAB_MAX_CACHES				65536
 
 //
-#define SLAB_OBJ_MAX_SIZE			SLAB_MEM_SIZE
-#define SLAB_OBJ_MIN_SIZE			4
+// Reclaim
+//
+#define SLAB_FREE_SLABS_MAX			4		// free slabs kept per cpu (default)
 
 //
-#define SLAB_OBJ_MAX_CNT			SLAB_MEM_SIZE / SLAB_OBJ_MIN_SIZE
+// Creation flags (alignment, the largest one given is used)
+//
+#define SLAB_ALIGN_8				(1U << 0)
+#define SLAB_ALIGN_16				(1U << 1)
+#define SLAB_HWCACHE_ALIGN			(1U << 2)
+
+#define SLAB_ALIGN_MASK				\
+			(SLAB_ALIGN_8 | SLAB_ALIGN_16 | SLAB_HWCACHE_ALIGN)
 
 //
-// Name
+// Creation flags (debug)
 //
-#define SLAB_OBJ_MAX_NAME			64
+#define SLAB_RED_ZONE				(1U << 3)	// overrun detection
+#define SLAB_POISON					(1U << 4)	// use after free detection
+#define SLAB_CONSISTENCY_CHECKS		(1U << 5)	// free validation
 
+#define SLAB_DEBUG					\
+			(SLAB_RED_ZONE | SLAB_POISON | SLAB_CONSISTENCY_CHECKS)
 
-_Static_assert(IS_POWER_2(SLAB_OBJ_ALIGNMENT), "Obj align is not power of 2");
-_Static_assert(IS_POWER_2(SLAB_BLK_SIZE), "Block size is not power of 2");
+//
+// Creation flags (memory)
+//
+#define SLAB_HUGEPAGE				(1U << 6)	// slabs from huge pages arena
 
+#define SLAB_FLAGS_MASK				\
+			(SLAB_ALIGN_MASK | SLAB_DEBUG | SLAB_HUGEPAGE)
 
-/*****************************************************************************/
+//
+// NUMA nodes (slab arenas)
+//
+#define SLAB_NODE_ANY				BUDDY_NODE_ANY
+#define SLAB_MAX_NODES				8
+#define SLAB_ARENA_SIZE				_1GiB
+
+//
+// Alignemnt (cache line)
+//
+#define SLAB_CACHE_LINE_SIZE		64
+
+//
+// Memory
+//
+#define RED_ZONE_SIZE				(sizeof(uint64_t))
+#define SLAB_MAX_ORDER				3
+#define SLAB_MIN_BLK_SIZE			PAGE_SIZE
+#define SLAB_MAX_BLK_SIZE			(PAGE_SIZE << SLAB_MAX_ORDER)
+
+// slab waste (header, padding, tail) accepted when selecting order
+#define SLAB_WASTE_RATIO			8
+
+//
+#define SLAB_OBJ_MAX_SIZE			(2 * PAGE_SIZE)
+#define SLAB_OBJ_MIN_SIZE			4
+
+//
+// Name
+//
+#define SLAB_OBJ_MAX_NAME			64
 
-#define SLAB_METADATA_SIZE			\
-			(sizeof(uint64_t) + sizeof(uint64_t*) + sizeof(size_t) + \
-			sizeof(kdlist_node_t))
 
-#define SLAB_MEM_OFFSET				(ALIGN(SLAB_METADATA_SIZE, SLAB_OBJ_ALIGNMENT))
-#define SLAB_PAD_SIZE				(SLAB_MEM_OFFSET - SLAB_METADATA_SIZE)
+_Static_assert(IS_POWER_2(SLAB_CACHE_LINE_SIZE), "Cache line is not power of 2");
+_Static_assert(IS_POWER_2(SLAB_MIN_BLK_SIZE), "Block size is not power of 2");
 
 
 /*****************************************************************************/
@@ -155,44 +311,115 @@ _Static_assert(IS_POWER_2(SLAB_BLK_SIZE), "Block size is not power of 2");
 typedef struct slab_s {
 
 	uint64_t						magic;
-	uint64_t						*bitmap;
-	size_t							count;
+	uint32_t						count;
+	uint32_t						free_idx;	// first non full bitmap word
+	uint16_t						cpu_id;		// owner per cpu slabs
+	uint16_t						order;		// slab size is 2^order pages
+	uint32_t						cache_id;	// owner cache id
 
 	//
+	struct slab_cache_s				*slab_cache;	// owner cache
 	kdlist_node_t					node;
 
-	// padding to ensure alignment
-	uint8_t							_pad[SLAB_PAD_SIZE];
-
-	//
-	uint8_t							mem[0];
+	// objects follow at mem_offset (cache alignment)
+	uint64_t						bitmap[];
 
 } slab_t;
 
 //
 typedef struct per_cpu_slab_s {
 
+	pthread_mutex_t					lock;
+
+	//
 	kdlist_head_t					full_slabs_head;
 	kdlist_head_t					partial_slabs_head;
 	kdlist_head_t					free_slabs_head;
+	size_t							free_slabs;
+
+} __attribute__((aligned(SLAB_CACHE_LINE_SIZE))) per_cpu_slab_t;
+
+//
+typedef struct slab_magazine_s {
+
+	kdlist_node_t					node;		// depot list
+	size_t							rounds;		// objects in magazine
+	void							*objs[SLAB_MAG_SIZE];
+
+} slab_magazine_t;
+
+// per thread magazines
+typedef struct slab_tcache_s {
+
+	slab_magazine_t					*loaded;
+	slab_magazine_t					*previous;
+
+	//
+	struct slab_cache_s				*slab_cache;
+	kdlist_node_t					node;		// depot threads list
+
+} slab_tcache_t;
+
+// thread magazines of all caches (thread key), indexed by cache id
+typedef struct slab_tcache_table_s {
+
+	size_t							size;
+	struct {
+		slab_tcache_t				*tcache;
+		uint64_t					gen;		// cache generation
+	} ent[];
+
+} slab_tcache_table_t;
 
-} per_cpu_slab_t;
+//
+typedef struct slab_depot_s {
+
+	pthread_mutex_t					lock;
+
+	//
+	kdlist_head_t					full_mags_head;
+	kdlist_head_t					empty_mags_head;
+	size_t							full_mags;
+
+	//
+	kdlist_head_t					tcaches_head;
+
+} slab_depot_t;
 
 //
 typedef struct slab_cache_s {
 
 	//
-	uint8_t							full_bytes;
-	uint8_t							left_bits;
+	uint32_t						flags;
+	size_t							align;			// objects alignment
 
 	//
 	size_t							obj_size;
 	size_t							obj_per_slab;
 	size_t							obj_size_align;
 
+	//
+	size_t							slab_order;		// slab is 2^order pages
+	size_t							slab_size;
+	size_t							mem_offset;		// objects start in slab
+	size_t							bitmap_size;	// bitmap words
+
 	//
 	char							obj_name[SLAB_OBJ_MAX_NAME];
 
+	//
+	int								nid;			// NUMA node or SLAB_NODE_ANY
+	buddy_t							*arena;			// slabs memory (or heap)
+
+	//
+	atomic_size_t					free_slabs_max;	// free slabs watermark
+	kdlist_node_t					node;			// all caches list
+
+	//
+	size_t							id;				// registry and thread tables index
+	uint64_t						gen;			// id generation
+	slab_depot_t					depot;
+
 	//
 	per_cpu_slab_t					_cpu[MAX_CPUS];
 
@@ -201,8 +428,14 @@ typedef struct slab_cache_s {
 
 /*****************************************************************************/
 
-// Initialize slab cache
+// Initialize slab cache (SLAB_HWCACHE_ALIGN)
 slab_cache_t *slab_cache_create(size_t obj_size, char *obj_name);
+slab_cache_t *slab_cache_create_flags(size_t obj_size, char *obj_name,
+										uint32_t flags);
+
+// Initialize slab cache with slabs on a NUMA node (node may be SLAB_NODE_ANY)
+slab_cache_t *slab_cache_create_node(size_t obj_size, char *obj_name,
+										uint32_t flags, int node);
 
 // Destroy slab cache
 void slab_cache_destroy(slab_cache_t *slab_cache);
@@ -210,12 +443,25 @@ void slab_cache_destroy(slab_cache_t *slab_cache);
 // Shrink slab cache
 void slab_cache_shrink(slab_cache_t *slab_cache, int cpu_id);
 
-// Allocate slab cache object
+// Reclaim free slabs of all cpus (return released bytes)
+size_t slab_cache_reclaim(slab_cache_t *slab_cache);
+int slab_cache_set_watermark(slab_cache_t *slab_cache, size_t free_slabs_max);
+
+// Reclaim all slab caches (return released bytes)
+size_t slab_reclaim_all(void);
+
+// Arena memory pressure callback (arg is the arena, return bytes given back)
+size_t slab_shrinker(void *arg);
+
+// Allocate slab cache object (thread safe, cpu_id may be SLAB_CPU_ANY)
 void *slab_cache_alloc(slab_cache_t *slab_cache, int cpu_id);
 
-// Free slab cache object
+// Free slab cache object (thread safe, cpu_id may be SLAB_CPU_ANY)
 void slab_cache_free(slab_cache_t *slab_cache, void *ptr, int cpu_id);
 
+// Get cache owning an object (ptr must be a slab object)
+slab_cache_t *slab_cache_of(void *ptr);
+
 // Dump slab cache
 void slab_cache_dump(slab_cache_t *slab_cache);
 
@@ -0,0 +1,79 @@
+/**
+ * General purpose allocator (size classes) on top of slab caches.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#ifndef SLAB_MALLOC_H
+#define SLAB_MALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allocator/slab.h"
+#include "allocator/buddy.h"
+
+
+/*****************************************************************************/
+
+/**
+ * Size Classes (kmalloc style)
+ * ----------------------------
+ * `slab_malloc(size)` rounds the requested size up to a size class, each one
+ * served by its own slab cache:
+ *
+ *   8, 12, 16, 24, 32, 48, 64, 96, ..., 1024, 1536, 2048, 3072
+ *
+ * (powers of two and 1.5x powers of two, so internal fragmentation is at most
+ * 33%). The class of a size is computed in O(1) from its highest bit. Objects
+ * are 16 bytes aligned (8 for classes below 16), like malloc.
+ *
+ * Sizes above SLAB_MALLOC_MAX_SIZE are allocated from the buddy allocator
+ * given to `slab_malloc_init()` (page granularity).
+ *
+ * `slab_free(ptr)` needs no size: buddy blocks are recognized by address
+ * range, any other address must be a slab object, whose cache is found in the
+ * header of its slab (`slab_cache_of()`).
+ *
+ * Allocations are thread safe (slab caches use per-thread magazines).
+ */
+
+
+/*****************************************************************************/
+
+//
+// Size classes
+//
+#define SLAB_MALLOC_MIN_SIZE		8
+#define SLAB_MALLOC_MAX_SIZE		3072
+#define SLAB_MALLOC_CLASSES			18
+
+_Static_assert(SLAB_MALLOC_MAX_SIZE <= SLAB_OBJ_MAX_SIZE,
+				"Largest size class does not fit in a slab");
+
+
+/****************************** DATA STRUCTURE *******************************/
+
+typedef struct slab_malloc_s {
+
+	//
+	slab_cache_t				*caches[SLAB_MALLOC_CLASSES];	// size classes
+	//
+	buddy_t						*buddy;			// large sizes allocator
+
+} slab_malloc_t;
+
+
+/******************************** PUBLIC API *********************************/
+
+// Create size class caches (buddy may be NULL, large sizes fail then)
+int slab_malloc_init(buddy_t *buddy);
+void slab_malloc_destroy(void);
+
+//
+void *slab_malloc(size_t size);
+void slab_free(void *ptr);
+
+// Size class used for a given size (0 if served by buddy)
+size_t slab_malloc_class_size(size_t size);
+
+#endif	// SLAB_MALLOC_H
@@ -0,0 +1,103 @@
+/**
+ * Concurrent (sharded) hash table implementation.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#ifndef CHTABLE_H
+#define CHTABLE_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "htable/htable.h"
+#include "synchronization/drwlock.h"
+
+
+/*****************************************************************************/
+
+/**
+ * Concurrent Hash Table (Sharded)
+ * -------------------------------
+ * The table is split into a power of 2 number of shards. Each shard is an
+ * independent `htable_t` guarded by its own `drwlock_t`, so threads accessing
+ * different shards never contend, and readers of the same shard proceed in
+ * parallel.
+ *
+ *   - The shard is selected from the high bits of a multiplicative hash of the
+ *     user hash, independent from the bits each shard uses internally.
+ *   - Each shard grows on its own (incremental rehashing), under its write
+ *     lock. Lookups never migrate entries, so they only need the read lock.
+ *   - Shards are cache line aligned to prevent false sharing.
+ *
+ * Reads are not lock-free: a lookup takes the shard read lock. The lock is a
+ * distributed reader indicator, so a read lock only writes the per-thread
+ * slot of the reader (no cache line shared by all readers of a hot shard)
+ * and reads scale with the number of readers. The cost moves to writers,
+ * which scan DRWLOCK_SLOTS slots per update, and to memory (DRWLOCK_SLOTS
+ * cache lines per shard). For read-mostly data where readers must never
+ * wait for a writer, use `rcu_htable_t` (lock-free RCU reads).
+ *
+ * Since an entry may be deleted as soon as the shard lock is released,
+ * lookups do not return the value; instead, a callback is invoked with the
+ * entry while the read lock is held.
+ */
+
+
+/*****************************************************************************/
+
+//
+#define CHTABLE_MAX_SHARDS			1024
+
+
+/********************************* CALLBACKS *********************************/
+
+//
+typedef void (*chtable_read_cb)(void *key, void *value, void *arg);
+
+
+/****************************** DATA STRUCTURE *******************************/
+
+typedef struct chtable_shard_s {
+
+	drwlock_t		*lock;			// shard lock
+	htable_t		*htable;		// shard hash table
+
+} __attribute__((aligned(CACHE_LINE_SIZE))) chtable_shard_t;
+
+
+typedef struct chtable_s {
+
+	//
+	uint32_t		shards_no;		// number of shards (power of 2)
+	uint32_t		shards_shift;	// shift to select shard from hash
+	//
+	chtable_shard_t	*shards;		// shards
+	//
+	hash_cb			__hash;			// hash callback
+
+} chtable_t;
+
+
+/******************************** PUBLIC API *********************************/
+
+//
+chtable_t *chtable_create(uint32_t shards_no, htable_type_e type,
+						uint32_t capacity, hash_cb hash, cmp_cb cmp,
+						alloc_key_cb alloc_key, free_key_cb free_key,
+						alloc_value_cb alloc_value, free_value_cb free_value);
+void chtable_destroy(chtable_t *chtable);
+
+//
+int chtable_insert(chtable_t *chtable, void *key, void *value);
+int chtable_delete(chtable_t *chtable, void *key);
+
+//
+int chtable_lookup(chtable_t *chtable, void *key, chtable_read_cb fn,
+				void *arg);
+bool chtable_contains(chtable_t *chtable, void *key);
+
+//
+uint64_t chtable_size(chtable_t *chtable);
+
+#endif	// CHTABLE_H
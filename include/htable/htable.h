@@ -10,9 +10,96 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "allocator/slab.h"
 #include "list/kdoubly_linked_list.h"
 
 
+/*****************************************************************************/
+
+/**
+ * Hash Table Storage Modes
+ * ------------------------
+ *   - HTABLE_CHAINED: Separate chaining. Each bucket is a doubly linked list
+ *                     of heap allocated nodes.
+ *
+ *   - HTABLE_OPEN   : Open addressing (Swiss table style). Keys and values are
+ *                     kept in flat arrays, next to a control byte array that
+ *                     holds a 7-bit fingerprint (tag) of each used slot. Slots
+ *                     are probed in groups of HTABLE_GROUP_WIDTH control bytes
+ *                     (compared at once using SIMD instructions) and the
+ *                     compare callback is only invoked on tag matches.
+ *                     At most 7/8 of the slots are used.
+ *
+ * The hash callback returns a full 32-bit hash. The table mixes it and does
+ * the reduction to a bucket (slot) index itself. Capacity is rounded up to a
+ * power of 2.
+ *
+ * Inline Entries
+ * --------------
+ * Tables created with `htable_create_inline()` store fixed-size keys and
+ * values by copy, inside the slot arrays (open) or in the same allocation as
+ * the node (chained). No alloc/free callbacks are invoked, so an insert costs
+ * at most one allocation (chained) or none at all (open), and lookups do not
+ * chase a pointer to reach the key. Values returned by lookups point inside the
+ * table and stay valid only until the next insert/delete.
+ *
+ * Node Cache
+ * ----------
+ * Nodes of an empty HTABLE_CHAINED table can be allocated from a slab cache
+ * (`htable_set_node_cache()`) instead of malloc. The cache object size must be
+ * at least `htable_node_size()`.
+ *
+ * Growth (Incremental Rehashing)
+ * ------------------------------
+ * Once a table reaches its load limit, a second table of double capacity is
+ * allocated and entries are migrated HTABLE_REHASH_STEP buckets (groups) at a
+ * time on each insert/delete, so a resize never stalls a single operation.
+ * While rehashing, both tables are live: new entries go to the new table and
+ * lookups/deletes check both. Lookups never migrate entries, so they do not
+ * modify the table.
+ */
+
+
+/*****************************************************************************/
+
+//
+// CONFIG
+//
+// Group probing implementation is selected at build time (see Makefile,
+// HTABLE_GROUP=scalar|sse2|avx2):
+//   - HTABLE_GROUP_AVX2: 32 control bytes compared with one AVX2 instruction
+//   - HTABLE_GROUP_SSE2: 16 control bytes compared with one SSE2 instruction
+//   - otherwise        : 16 control bytes compared as two 64-bit words (SWAR)
+//
+#if defined(HTABLE_GROUP_AVX2)
+	#if !defined(__AVX2__)
+		#error "HTABLE_GROUP_AVX2 requires AVX2 support (-mavx2)!"
+	#endif
+	#define HTABLE_GROUP_WIDTH		32
+#elif defined(HTABLE_GROUP_SSE2)
+	#if !defined(__SSE2__)
+		#error "HTABLE_GROUP_SSE2 requires SSE2 support (-msse2)!"
+	#endif
+	#define HTABLE_GROUP_WIDTH		16
+#else
+	#define HTABLE_GROUP_SCALAR
+	#define HTABLE_GROUP_WIDTH		16
+#endif
+
+
+/*****************************************************************************/
+
+//
+#define HTABLE_MIN_CAPACITY			HTABLE_GROUP_WIDTH
+#define HTABLE_MAX_CAPACITY			(1U << 31)
+
+// buckets (groups) migrated per insert/delete while rehashing
+#define HTABLE_REHASH_STEP			1
+
+// keys hashed and prefetched ahead by batch operations
+#define HTABLE_BATCH_CHUNK			16
+
+
 /********************************* CALLBACKS *********************************/
 
 //
@@ -31,13 +118,47 @@ typedef void (*print_value_cb)(void *);
 
 /****************************** DATA STRUCTURE *******************************/
 
+typedef enum htable_type_s {
+
+	HTABLE_CHAINED = 0,
+	HTABLE_OPEN,
+
+} htable_type_e;
+
+
+typedef struct htable_tbl_s {
+
+	//
+	uint32_t		capacity;		// buckets (slots) number
+	uint32_t		size;			// entries in table
+	uint32_t		growth_left;	// empty slots left before rehash (open)
+	//
+	kdlist_head_t	*buckets;		// hash table buckets (chained)
+	//
+	uint8_t			*ctrl;			// slots control bytes (open)
+	uint8_t			*keys;			// slots keys, key_stride each (open)
+	uint8_t			*values;		// slots values, value_stride each (open)
+
+} htable_tbl_t;
+
+
 typedef struct htable_s {
 
 	//
-	uint32_t		capacity;		// total hash table capacity
+	htable_type_e	type;			// storage mode
+	//
 	uint32_t		size;			// current size of hash table
 	//
-	kdlist_head_t	*buckets;		// hash table buckets
+	htable_tbl_t	tbl[2];			// tables (tbl[1] used while rehashing)
+	int64_t			rehash_idx;		// next bucket (group) to migrate or -1
+	//
+	uint32_t		key_size;		// inline key size (0 if allocated)
+	uint32_t		key_stride;		// key slot size (open)
+	uint32_t		value_size;		// inline value size (0 if allocated)
+	uint32_t		value_stride;	// value slot size (open)
+	//
+	slab_cache_t	*node_cache;	// node cache (chained, NULL for malloc)
+	int				cpu_id;			// node cache core id
 	//
 	hash_cb			__hash;			// hash callback
 	//
@@ -58,12 +179,34 @@ typedef struct htable_s {
 htable_t *htable_create(uint32_t capacity, hash_cb hash, cmp_cb cmp,
 						alloc_key_cb alloc_key, free_key_cb free_key,
 						alloc_value_cb alloc_value, free_value_cb free_value);
+htable_t *htable_create_type(htable_type_e type, uint32_t capacity,
+						hash_cb hash, cmp_cb cmp,
+						alloc_key_cb alloc_key, free_key_cb free_key,
+						alloc_value_cb alloc_value, free_value_cb free_value);
+htable_t *htable_create_inline(htable_type_e type, uint32_t capacity,
+						uint32_t key_size, uint32_t value_size,
+						hash_cb hash, cmp_cb cmp);
 void htable_destroy(htable_t *htable);
 
+//
+int htable_set_node_cache(htable_t *htable, slab_cache_t *cache, int cpu_id);
+size_t htable_node_size(htable_t *htable);
+
 //
 int htable_insert(htable_t *htable, void *key, void *value);
 int htable_delete(htable_t *htable, void *key);
 
+//
+int htable_lookup(htable_t *htable, void *key, void **value);
+void *htable_find_ptr(htable_t *htable, void *key);
+
+// Batch operations (return number of inserted/found entries, per key status
+// in rv)
+int htable_insert_batch(htable_t *htable, void **keys, void **values, int *rv,
+						uint32_t n);
+int htable_lookup_batch(htable_t *htable, void **keys, void **values, int *rv,
+						uint32_t n);
+
 //
 void htable_print(htable_t *htable, print_key_cb pkey, print_key_cb pval);
 
@@ -0,0 +1,99 @@
+/**
+ * RCU protected hash table implementation.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#ifndef RCU_HTABLE_H
+#define RCU_HTABLE_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "htable/htable.h"
+#include "synchronization/rcu.h"
+
+
+/*****************************************************************************/
+
+/**
+ * RCU Hash Table
+ * --------------
+ * A chained hash table for read-mostly data, where readers never take a lock:
+ *
+ *   - Readers run inside `rcu_read_lock()/rcu_read_unlock()` of the table RCU
+ *     context and traverse buckets using `rcu_dereference()` only. A returned
+ *     value stays valid until the reader leaves its critical section.
+ *   - Writers are serialized by a mutex. New nodes are fully initialized and
+ *     then published with `rcu_assign_pointer()`. Unlinked nodes are freed
+ *     after a grace period, through `rcu_call()`.
+ *   - Entries are never modified in place: `rcu_htable_update()` publishes a
+ *     new node replacing the old one (copy-update).
+ *
+ * Deferred frees are executed by the reclaimer thread of the RCU context (if
+ * created with RCU_RECLAIM_THREAD), or flushed by `rcu_htable_reclaim()`
+ * (`rcu_barrier()` on the RCU context).
+ *
+ * The number of buckets is fixed at creation time (no rehashing).
+ */
+
+
+/****************************** DATA STRUCTURE *******************************/
+
+typedef struct rcu_htable_node_s {
+
+	_Atomic(void *)				next;		// next node in bucket
+	void						*key;		// entry key
+	void						*value;		// entry value
+	struct rcu_htable_s			*table;		// owner (for deferred free)
+
+} rcu_htable_node_t;
+
+
+typedef struct rcu_htable_s {
+
+	//
+	uint32_t					capacity;	// buckets number (power of 2)
+	uint32_t					shift;		// shift to select bucket from hash
+	atomic_uint					size;		// current number of entries
+	//
+	_Atomic(void *)				*buckets;	// buckets (rcu_htable_node_t)
+	//
+	rcu_ctx_t					*rcu;		// readers rcu context
+	pthread_mutex_t				lock;		// writers lock
+	//
+	hash_cb						__hash;		// hash callback
+	cmp_cb						__cmp;		// compare callback
+	//
+	alloc_key_cb				__alloc_key;	// key allocation callback
+	free_key_cb					__free_key;		// key free callback
+	//
+	alloc_value_cb				__alloc_value;	// value allocation callback
+	free_value_cb				__free_value;	// value free callback
+
+} rcu_htable_t;
+
+
+/******************************** PUBLIC API *********************************/
+
+//
+rcu_htable_t *rcu_htable_create(rcu_ctx_t *rcu, uint32_t capacity,
+						hash_cb hash, cmp_cb cmp,
+						alloc_key_cb alloc_key, free_key_cb free_key,
+						alloc_value_cb alloc_value, free_value_cb free_value);
+void rcu_htable_destroy(rcu_htable_t *table);
+
+// Writers
+int rcu_htable_insert(rcu_htable_t *table, void *key, void *value);
+int rcu_htable_update(rcu_htable_t *table, void *key, void *value);
+int rcu_htable_delete(rcu_htable_t *table, void *key);
+
+// Readers (inside rcu_read_lock()/rcu_read_unlock())
+void *rcu_htable_lookup(rcu_htable_t *table, void *key);
+
+// Run deferred frees
+void rcu_htable_reclaim(rcu_htable_t *table);
+
+#endif	// RCU_HTABLE_H
@@ -64,7 +64,7 @@ typedef struct kdlist_node_s {
 /********************************* CALLBACKS *********************************/
 
 //
-typedef void (*print_cb)(kdlist_node_t *);
+typedef void (*kdlist_print_cb)(kdlist_node_t *);
 
 
 /******************************** PUBLIC API *********************************/
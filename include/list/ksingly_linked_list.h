@@ -55,7 +55,7 @@ typedef struct kslist_node_s {
 /********************************* CALLBACKS *********************************/
 
 //
-typedef void (*print_cb)(kslist_node_t *);
+typedef void (*kslist_print_cb)(kslist_node_t *);
 
 
 /******************************** PUBLIC API *********************************/
@@ -85,6 +85,6 @@ void kslist_push_after(kslist_node_t *base, kslist_node_t *node);
 void kslist_replace(kslist_head_t *head, kslist_node_t *old, kslist_node_t *new);
 
 //
-void kslist_print(kslist_head_t *head, print_cb);
+void kslist_print(kslist_head_t *head, kslist_print_cb);
 
 #endif	// KSINGLY_LINKED_LIST_H
@@ -0,0 +1,107 @@
+/**
+ * POC implementation of distributed (reader scalable) read-write lock.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#ifndef DRWLOCK_H
+#define DRWLOCK_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "utils.h"
+#include "synchronization/rwlock.h"
+
+
+/*****************************************************************************/
+
+/**
+ * Distributed Read-Write Lock (DRWLock)
+ * -------------------------------------
+ * With `rwlock_t`, every reader updates the shared `cnt` word, so the cache
+ * line bounces between cpus and read throughput stops scaling. Here readers
+ * are counted in DRWLOCK_SLOTS reader slots instead (distributed reader
+ * indicator, as percpu-rwsem and BRAVO):
+ *
+ *   slots [0] [1] [2] ... [DRWLOCK_SLOTS-1]   one cache line each
+ *          |   |
+ *          thread 0, thread 1, ...            slot given per thread
+ *
+ *   - Each thread is given a slot the first time it reads (round robin), so
+ *     threads of different slots never write the same cache line. A read
+ *     lock increments the slot of the thread and checks `writer`, a read
+ *     unlock decrements it: no shared write at all.
+ *   - A writer takes the underlying `rwlock_t` for writing (writers are
+ *     serialized, waiting is adaptive), sets `writer`, then waits for every
+ *     slot to drain. A write lock costs O(DRWLOCK_SLOTS), so the lock suits
+ *     read mostly data.
+ *   - Waiting for a slot is adaptive too: the writer spins DRWLOCK_SPIN_MAX
+ *     attempts with backoff, then sleeps on the `seq` futex. The reader
+ *     leaving a slot empty while `writer` is set increments `seq` and wakes
+ *     the writer, with a system call only when `sleepers` is not zero (as
+ *     `rwlock_t`), so long read sections do not burn the writer cpu.
+ *   - A reader seeing `writer` set gives its slot back and waits on the
+ *     underlying lock (read lock/unlock, sleeping on its futex while the
+ *     writer holds it), then tries again. New readers are blocked once a
+ *     writer is waiting (no writer starvation).
+ *
+ * The slot increment and the `writer` check (and the `writer` store and the
+ * slots scan) are sequentially consistent, so either the reader sees the
+ * writer, or the writer sees the reader.
+ */
+
+
+/*****************************************************************************/
+
+//
+// Reader slots (power of 2)
+//
+#define DRWLOCK_SLOTS				MAX_THREADS
+
+_Static_assert(IS_POWER_2(DRWLOCK_SLOTS), "Reader slots not power of 2");
+
+//
+// Writer spin attempts per slot before sleeping
+//
+#define DRWLOCK_SPIN_MAX			RWLOCK_SPIN_MAX
+
+
+/*****************************************************************************/
+
+//
+typedef struct drwlock_slot_s {
+
+	atomic_int				readers;
+
+} __attribute__((aligned(CACHE_LINE_SIZE))) drwlock_slot_t;
+
+//
+typedef struct drwlock_s {
+
+	atomic_int				writer;			// write lock held or waited
+	atomic_int				seq;			// slot drained (writer futex)
+	atomic_int				sleepers;		// writer sleeping on seq
+	rwlock_t				lock;			// writers, blocked readers
+
+	//
+	drwlock_slot_t			slots[DRWLOCK_SLOTS];
+
+} __attribute__((aligned(CACHE_LINE_SIZE))) drwlock_t;
+
+
+/*****************************************************************************/
+
+// Create/Destroy
+drwlock_t *drwlock_create(void);
+void drwlock_destroy(drwlock_t *drwlock);
+
+// Reader lock/unlock (unlock from the locking thread)
+void drwlock_read_lock(drwlock_t *drwlock);
+int drwlock_read_trylock(drwlock_t *drwlock);
+void drwlock_read_unlock(drwlock_t *drwlock);
+
+// Writer lock/unlock
+void drwlock_write_lock(drwlock_t *drwlock);
+void drwlock_write_unlock(drwlock_t *drwlock);
+
+#endif	// DRWLOCK_H
@@ -7,6 +7,7 @@
 #define RCU_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <pthread.h>
 #include <stdatomic.h>
 
@@ -33,13 +34,41 @@
  *   - `rcu_read_lock()/rcu_read_unlock()`: Marks the read-side critical section
  *   - `rcu_call()`: Schedules a callback to be called after all readers finish
  *   - `rcu_synchronize()`: Waits for an RCU grace period to complete
+ *   - `rcu_barrier()`: Waits for all callbacks scheduled so far to be called
  *   - `rcu_assign_pointer()` / `rcu_dereference()`: Safe publish/consume APIs
  *
- * Internals:
- *   - Readers are tracked via per-thread atomic counters aligned to cache lines
- *   - Writer waits for all counters to reach 0 before invoking deferred callbacks
- *   - Cache line alignment prevents false sharing between threads updating counters
- *   - A lock protects the callback list for scheduled deferred operations
+ * Internals (epoch based grace periods):
+ *   - A global epoch `gp` starts at 1 and is only incremented
+ *   - On its outermost `rcu_read_lock()`, a reader publishes a snapshot of the
+ *   epoch in its per-thread slot; `rcu_read_unlock()` stores 0 back (nested
+ *   sections only update a nesting count owned by the thread)
+ *   - `rcu_synchronize()` advances the epoch to E and waits, slot by slot,
+ *   while the slot holds a snapshot older than E. Readers entering after the
+ *   increment snapshot E or newer and are not waited for, so a steady stream
+ *   of new readers cannot starve the writer: the grace period ends once all
+ *   pre-existing readers have left their section
+ *   - Snapshot store and epoch increment are both followed by a sequentially
+ *   consistent access to the other side (slot scan / pointer load), so either
+ *   the writer sees the reader, or the reader sees the updated pointer
+ *   - The writer spins RCU_SPIN_MAX attempts on a slot, then sleeps on the
+ *   `seq` futex. An outermost `rcu_read_unlock()` checks `sleepers` after its
+ *   store and only then increments `seq` and wakes the writers, so long read
+ *   sections do not burn the writer cpu and the read side makes no system
+ *   call unless a writer sleeps
+ *   - Slots are aligned to cache lines to prevent false sharing
+ *
+ * Deferred callbacks:
+ *   - `rcu_call()` pushes the callback on the queue of the calling thread (a
+ *   lockless stack, one per registered thread plus one shared by unregistered
+ *   threads), so writers do not contend on a global lock
+ *   - Created with RCU_RECLAIM_THREAD, the context runs a reclaimer thread. It
+ *   sleeps without timeout while all queues are empty; the first callback
+ *   pushed on an empty queue wakes it. It then waits RCU_RECLAIM_DELAY_MS
+ *   (CLOCK_MONOTONIC, or less once a queue holds RCU_BATCH_MAX callbacks),
+ *   detaches all queues as one batch, waits a single grace period for the
+ *   whole batch and then calls the callbacks
+ *   - Otherwise callbacks are called by `rcu_cleanup()` (after a
+ *   `rcu_synchronize()`) or by `rcu_barrier()`
  *
  * Requirements:
  *   - Requires C11 or equivalent atomic operations support
@@ -68,10 +97,37 @@
 //
 #define CACHE_LINE_SIZE				64
 
+//
+// Writer spin attempts per slot before sleeping
+//
+#define RCU_SPIN_MAX				128
+
+//
+// Creation flags
+//
+#define RCU_RECLAIM_THREAD			(1U << 0)	// background reclaimer
+
+#define RCU_FLAGS_MASK				(RCU_RECLAIM_THREAD)
+
+//
+// Reclaimer batching period and queue length that wakes it early
+//
+#define RCU_RECLAIM_DELAY_MS		10
+#define RCU_BATCH_MAX				4096
+
+//
+// Callback queues (registered threads and a shared one)
+//
+#define RCU_QUEUES					(MAX_THREADS + 1)
+
 
 /*****************************************************************************/
 
-#define RCU_THREAD_PADDING			(CACHE_LINE_SIZE - (sizeof(int32_t)))
+#define RCU_QUEUE_PADDING			(CACHE_LINE_SIZE - sizeof(void *) - \
+										sizeof(long))
+
+#define RCU_THREAD_PADDING			(CACHE_LINE_SIZE - sizeof(uint64_t) - \
+										sizeof(int32_t))
 
 //
 typedef void (*rcu_callback_t)(void *ptr);
@@ -89,21 +145,48 @@ typedef struct rcu_node_s {
 //
 typedef struct thread_counter_s {
 
-	atomic_int				cnt;
+	_Atomic(uint64_t)		ctr;			// epoch snapshot, 0 if quiescent
+	int32_t					nest;			// nesting (owner thread only)
 	char					_pad[RCU_THREAD_PADDING];
 
 } __attribute__((aligned(CACHE_LINE_SIZE))) thread_counter_t;
 
 
+//
+typedef struct rcu_queue_s {
+
+	_Atomic(kslist_node_t *)	head;		// pushed callbacks (lifo)
+	atomic_long				len;
+	char					_pad[RCU_QUEUE_PADDING];
+
+} __attribute__((aligned(CACHE_LINE_SIZE))) rcu_queue_t;
+
+
 //
 typedef struct rcu_ctx_s {
 
 	//
-	int						size;
+	atomic_int				size;
 	pthread_mutex_t			lock;
 
 	//
-	kslist_head_t			cbs;
+	_Atomic(uint64_t)		gp;				// grace period epoch
+	atomic_int				seq;			// reader left (writer futex)
+	atomic_int				sleepers;		// writers sleeping on seq
+
+	//
+	rcu_queue_t				queues[RCU_QUEUES];
+
+	// reclaimer thread
+	uint32_t				flags;
+	pthread_t				reclaimer;
+	pthread_mutex_t			reclaim_lock;
+	pthread_cond_t			reclaim_cond;	// reclaimer wake up
+	pthread_cond_t			barrier_cond;	// batch done
+	bool					wake;
+	bool					stop;
+	uint64_t				barrier_req;	// barriers requested
+	uint64_t				barrier_done;	// barriers served
 
 	//
 	pthread_t				threads_idx[MAX_THREADS];
@@ -116,9 +199,10 @@ typedef struct rcu_ctx_s {
 
 // Create/Destroy
 rcu_ctx_t *rcu_create(void);
+rcu_ctx_t *rcu_create_flags(uint32_t flags);
 void rcu_destroy(rcu_ctx_t *rcu);
 
-// Register thread
+// Register thread (<0 if MAX_THREADS are registered)
 int rcu_register_thread(rcu_ctx_t *rcu);
 
 // Reader enter/exit
@@ -132,11 +216,14 @@ void *rcu_dereference(_Atomic(void *) *ptr);
 // Synchronize writer
 void rcu_synchronize(rcu_ctx_t *rcu);
 
-// Collect free objects
+// Collect free objects (called inline after a grace period if out of memory)
 void rcu_call(rcu_ctx_t *rcu, rcu_callback_t fn, void *ptr);
 
-// Cleanup free objects
+// Cleanup free objects (after rcu_synchronize)
 void rcu_cleanup(rcu_ctx_t *rcu);
 
+// Wait for all scheduled callbacks to be called
+void rcu_barrier(rcu_ctx_t *rcu);
+
 
 #endif	// RCU_H
@@ -18,8 +18,9 @@
  * Read-Write Lock (RWLock) Implementation
  * ---------------------------------------
  * This lightweight read-write lock allows multiple readers to hold the lock
- * concurrently, while writers are granted exclusive access. It is implemented
- * using two atomic integers:
+ * concurrently, while writers are granted exclusive access. By default the
+ * state is two atomic integers (upgrade, phase fair mode and sleeping use
+ * the other fields, see below):
  *
  *   - `cnt`: Represents the lock state. A positive value indicates the number
  *            of active readers; -1 indicates an active writer.
@@ -27,12 +28,58 @@
  *                This prevents writer starvation by blocking new readers when
  *                writers are pending.
  *
- * The implementation uses atomic operations and spin-waiting with `sched_yield()`
- * for thread coordination. The structure is aligned to cache line size to
- * prevent false sharing.
+ * The structure is aligned to cache line size to prevent false sharing.
  *
- * Suitable for low-latency scenarios where critical sections are short and
- * spinning is acceptable. Does not use blocking or OS-level synchronization.
+ * Writers are preferred: a waiting writer blocks new readers, but writers are
+ * not ordered among themselves, and a steady flow of writers starves readers.
+ *
+ * Phase Fair Mode (RWLOCK_FAIR):
+ * ------------------------------
+ * Ticket based phase fair lock (PF-T, Brandenburg and Anderson). Reader and
+ * writer phases alternate, so both sides wait a bounded time:
+ *
+ *   - `win`/`wout`: Writer tickets taken/served. Writers are served in
+ *            arrival order (FIFO).
+ *   - `rin`/`rout`: Readers entered/left, counted by RWLOCK_PF_RINC. The low
+ *            bits of `rin` (RWLOCK_PF_WBITS) are set by the writer being
+ *            served: present bit and phase id (lowest bit of its ticket).
+ *
+ *   - A reader adds itself to `rin` and waits only while the writer bits it
+ *     read stay unchanged: at most one writer phase.
+ *   - A writer waits for its ticket, sets the writer bits (blocking new
+ *     readers) and waits for the readers entered before it (`rout` reaching
+ *     the `rin` it read): at most one reader phase and the writers queued
+ *     before it.
+ *   - On write unlock, writer bits are cleared (blocked readers proceed
+ *     together) and the next writer ticket is served.
+ *
+ * Upgrade/Downgrade:
+ * ------------------
+ *   - `rwlock_upgrade()` turns a read lock into a write lock, waiting for the
+ *     other readers only, so read-modify-write paths never drop the lock.
+ *     Only one reader can upgrade at a time (two would wait for each other),
+ *     and with RWLOCK_FAIR only when no writer is queued (it would wait for
+ *     the upgrading reader). On failure the caller still holds its read lock.
+ *   - `rwlock_downgrade()` turns a write lock into a read lock and lets the
+ *     waiting readers in.
+ *
+ * Adaptive Waiting:
+ * -----------------
+ * A thread that cannot take the lock first spins, up to RWLOCK_SPIN_MAX
+ * attempts, with exponential backoff between attempts (1, 2, 4, ... up to
+ * RWLOCK_BACKOFF_MAX `pause` instructions), so short critical sections are
+ * waited for without a system call. It then sleeps in the kernel (futex):
+ *
+ *   - `seq`: Release sequence, incremented whenever the lock may have become
+ *            available (last reader or writer unlock). Sleepers wait on it,
+ *            so a release between their last attempt and the futex wait
+ *            makes the wait return immediately (no lost wake up).
+ *   - `sleepers`: Threads sleeping (or about to) on `seq`. Unlock only makes
+ *            the FUTEX_WAKE system call when it is not zero, so uncontended
+ *            lock/unlock never enter the kernel.
+ *
+ * All sleepers are woken on release (readers may all proceed, writers race
+ * for the lock and the losers sleep again).
  */
 
 /*****************************************************************************/
@@ -52,24 +99,80 @@
 //
 #define CACHE_LINE_SIZE				64
 
+//
+// Creation flags
+//
+#define RWLOCK_FAIR					(1U << 0)	// phase fair (ticket) mode
+
+#define RWLOCK_FLAGS_MASK			(RWLOCK_FAIR)
+
+//
+// Phase fair lock (reader increment, writer present bit and phase id)
+//
+#define RWLOCK_PF_RINC				0x100
+#define RWLOCK_PF_WBITS				0x3
+#define RWLOCK_PF_PRES				0x2
+#define RWLOCK_PF_PHID				0x1
+
+//
+// Adaptive waiting (attempts before sleeping, max pause per attempt)
+//
+#define RWLOCK_SPIN_MAX				16
+#define RWLOCK_BACKOFF_MAX			64
+
 
 /*****************************************************************************/
 
 //
 typedef struct rwlock_s {
 
+	uint32_t				flags;
+
+	// writer preferring (default)
 	atomic_int				cnt;
 	atomic_int				writers;
+	atomic_int				upgrading;		// reader upgrading
+
+	// phase fair (RWLOCK_FAIR)
+	atomic_uint				rin;
+	atomic_uint				rout;
+	atomic_uint				win;
+	atomic_uint				wout;
+
+	// futex wait
+	atomic_int				seq;
+	atomic_int				sleepers;
 
 } __attribute__((aligned(CACHE_LINE_SIZE))) rwlock_t;
 
 
+/*****************************************************************************/
+
+// Spin wait hint (backoff), n times
+static inline void rwlock_pause(int n)
+{
+	for (int i = 0; i < n; i++) {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		__asm__ __volatile__("yield");
+#else
+		atomic_signal_fence(memory_order_seq_cst);
+#endif
+	}
+}
+
 /*****************************************************************************/
 
 // Create/Destroy
 rwlock_t *rwlock_create(void);
+rwlock_t *rwlock_create_flags(uint32_t flags);
 void rwlock_destroy(rwlock_t *rwlock);
 
+// Initialize embedded lock
+void rwlock_init(rwlock_t *rwlock);
+void rwlock_init_flags(rwlock_t *rwlock, uint32_t flags);
+
 // Reader lock/unlock
 void rwlock_read_lock(rwlock_t *rwlock);
 int rwlock_read_trylock(rwlock_t *rwlock);
@@ -80,4 +183,8 @@ void rwlock_write_lock(rwlock_t *rwlock);
 int rwlock_write_trylock(rwlock_t *rwlock);
 void rwlock_write_unlock(rwlock_t *rwlock);
 
+// Upgrade read lock to write lock (<0 if not possible)/downgrade write lock
+int rwlock_upgrade(rwlock_t *rwlock);
+void rwlock_downgrade(rwlock_t *rwlock);
+
 #endif	// RWLOCK_H
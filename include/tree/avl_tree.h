@@ -9,6 +9,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "allocator/slab.h"
+
 /*****************************************************************************/
 
 // avl tree function operations
@@ -38,6 +40,9 @@ typedef struct avl_tree_entry_s {
 	free_fn						_free;		// data free function
 	cmp_fn						_cmp;		// data compare function
 	print_fn					_print;		// data print function
+	//
+	slab_cache_t				*node_cache;	// node cache (NULL for malloc)
+	int							cpu_id;			// node cache core id
 
 } avl_tree_entry;
 
@@ -47,6 +52,9 @@ typedef struct avl_tree_entry_s {
 //
 avl_tree_entry *avl_tree_create(alloc_fn _alloc, free_fn _free, cmp_fn _cmp,
 								print_fn _print);
+avl_tree_entry *avl_tree_create_slab(alloc_fn _alloc, free_fn _free,
+									cmp_fn _cmp, print_fn _print,
+									slab_cache_t *node_cache, int cpu_id);
 void avl_tree_destroy(avl_tree_entry *entry);
 
 
@@ -13,6 +13,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "allocator/slab.h"
+
 
 /*****************************************************************************/
 
@@ -46,6 +48,9 @@ typedef struct radix_tree {
 	alloc_fn				_alloc;					// data allocation
 	print_fn				_print;					// data print
 	free_fn					_free;					// data free
+	//
+	slab_cache_t			*node_cache;			// node cache (or NULL)
+	int						cpu_id;					// node cache core id
 
 } radix_tree_t;
 
@@ -55,6 +60,9 @@ typedef struct radix_tree {
 //
 radix_tree_t *radix_tree_init(alloc_fn _alloc, print_fn _print,
 							free_fn _free);
+radix_tree_t *radix_tree_init_slab(alloc_fn _alloc, print_fn _print,
+								free_fn _free, slab_cache_t *node_cache,
+								int cpu_id);
 void radix_tree_destroy(radix_tree_t *tree);
 
 //
@@ -35,6 +35,7 @@
 //
 #define IS_POWER_2(x)		(((x) & ((x) - 1)) == 0)
 #define ARRAY_SIZE(x)		(sizeof(x) / sizeof((x)[0]))
+#define MIN(X, Y)			(((X) < (Y)) ? (X) : (Y))
 
 
 /*****************************************************************************/
@@ -3,15 +3,36 @@
  * Copyright (C) 2024 Lazar Razvan.
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 
 #include "allocator/buddy.h"
 
 
+/*****************************************************************************/
+
+#define BITS_OF(type)		(sizeof(type) * 8)
+
+
+/*****************************************************************************/
+
+// per thread operations, one of every BUDDY_STATS_SAMPLE is timed
+static __thread unsigned int __alloc_samples;
+static __thread unsigned int __free_samples;
+
+
 /*****************************************************************************/
 
 /**
@@ -23,81 +44,93 @@
 static inline void *
 __blk_2_buddy(void *addr, void *start, int order)
 {
-#if 0
-	return (addr ^ ((1ULL << order) * PAGE_SIZE))
-#else
-	return ((addr - start) ^ ((1ULL << order) * PAGE_SIZE)) + start;
-#endif
+	return ((addr - start) ^ ORDER_2_SIZE(order)) + start;
 }
 
 /*****************************************************************************/
 
-static inline uint8_t
-__blk_in_lvl_2_index(void *blk, void *start, uint8_t lvl)
+static inline size_t
+__blk_2_page(buddy_t *bud, void *blk)
 {
-	return (blk - start) / SIZE_OF_LEVEL(lvl);
+	return (blk - bud->mem) / PAGE_SIZE;
 }
 
-static inline uint8_t
-__blk_in_lvl_2_bit(void *blk, void *start, uint8_t lvl)
+static inline size_t
+__blk_in_order_2_index(buddy_t *bud, void *blk, int order)
 {
-	return (1 << lvl) - 1 + __blk_in_lvl_2_index(blk, start, lvl);
+	return __blk_2_page(bud, blk) >> order;
 }
 
-
-/*****************************************************************************/
-
-static inline int
-__blk_in_lvl_aligned(void *blk, void *start, uint8_t lvl)
+/**
+ * Bits of order bitmap (blocks of order, plus the buddy of the last one which
+ * may be past the end of the arena).
+ */
+static inline size_t
+__order_bits(size_t pages, int order)
 {
-	uintptr_t r = blk - start;
-
-	//
-	return (r == ALIGN((uintptr_t)r, (1 << LEVEL_2_ORDER(lvl)) * PAGE_SIZE));
+	return (pages >> order) + 1;
 }
 
 
 /*****************************************************************************/
 
-static inline uint64_t
-__blk_is_split(uint64_t mask, uint8_t bit, uint8_t lvl)
+static inline bool
+__blk_is_free(buddy_t *bud, void *blk, int order)
 {
-	if (lvl == BUDDY_ORDERS)
-		return (mask & (1ULL << bit));
-
-	return ((mask & (1ULL << bit)) ||
-			(__blk_is_split(mask, 2 * bit + 1, lvl + 1)) ||
-			(__blk_is_split(mask, 2 * bit + 2, lvl + 1)));
-}
+	size_t idx = __blk_in_order_2_index(bud, blk, order);
 
-static inline uint64_t
-__blk_is_allocated(uint64_t mask, void *blk, void *start, uint8_t lvl)
-{
-	return (mask & (1ULL << __blk_in_lvl_2_bit(blk, start, lvl)));
+	return bud->free_map[order][idx / BITS_OF(uint64_t)] &
+			(1ULL << (idx % BITS_OF(uint64_t)));
 }
 
 static inline void
-__blk_set_allocated(uint64_t *mask, void *blk, void *start, uint8_t lvl)
+__blk_push(buddy_t *bud, void *blk, int order)
 {
-	*mask |= (1ULL << __blk_in_lvl_2_bit(blk, start, lvl));
+	size_t idx = __blk_in_order_2_index(bud, blk, order);
+
+	bud->free_map[order][idx / BITS_OF(uint64_t)] |=
+			(1ULL << (idx % BITS_OF(uint64_t)));
+	kdlist_push_tail(&bud->free_list[order], (kdlist_node_t *)blk);
+
+	bud->free_orders |= (1U << order);
+	bud->free_blocks[order]++;
 }
 
 static inline void
-__blk_clr_allocated(uint64_t *mask, void *blk, void *start, uint8_t lvl)
+__blk_delete(buddy_t *bud, void *blk, int order)
 {
-	*mask &= ~(1ULL << __blk_in_lvl_2_bit(blk, start, lvl));
+	size_t idx = __blk_in_order_2_index(bud, blk, order);
+
+	bud->free_map[order][idx / BITS_OF(uint64_t)] &=
+			~(1ULL << (idx % BITS_OF(uint64_t)));
+	kdlist_delete((kdlist_node_t *)blk);
+
+	if (kdlist_is_empty(&bud->free_list[order]))
+		bud->free_orders &= ~(1U << order);
+
+	bud->free_blocks[order]--;
 }
 
-static inline blk_status_e
-__blk_get_status(uint64_t mask, void *blk, void *start, uint8_t lvl)
+static inline void *
+__blk_pop(buddy_t *bud, int order)
 {
-	if (__blk_is_allocated(mask, blk, start, lvl))
-		return BLK_ALLOCATED;
+	size_t idx;
+	kdlist_node_t *blk;
+
+	blk = kdlist_pop_head(&bud->free_list[order]);
+	if (!blk)
+		return NULL;
 
-	if (__blk_is_split(mask, __blk_in_lvl_2_bit(blk, start, lvl), lvl))
-		return BLK_SPLIT;
+	idx = __blk_in_order_2_index(bud, blk, order);
+	bud->free_map[order][idx / BITS_OF(uint64_t)] &=
+			~(1ULL << (idx % BITS_OF(uint64_t)));
 
-	return BLK_FREE;
+	if (kdlist_is_empty(&bud->free_list[order]))
+		bud->free_orders &= ~(1U << order);
+
+	bud->free_blocks[order]--;
+
+	return blk;
 }
 
 
@@ -109,169 +142,416 @@ __blk_get_status(uint64_t mask, void *blk, void *start, uint8_t lvl)
  * @bud		: Buddy data structure.
  * @order	: Block order to be allocated.
  *
- * Allocate a memory block by querying the free list for the required order.
- * If the free list is empty, attempt to split larger blocks (higher orders)
- * until two blocks of the required order are created.
+ * Find the smallest order, at least the required one, with a free block in
+ * a single step (lowest bit of the non-empty orders mask above the required
+ * order). If it is larger than the required order, split it down in one pass:
+ * the upper half of each split goes to the free list of the lower order and
+ * the lower half is split again, until the required order is reached.
  *
- * Once a suitable memory block is found, remove it from the free list and mark
- * the corresponding bit as allocated.
+ * Once a suitable memory block is found, remove it from the free list and
+ * record its order in the page orders.
  *
  * Return block memory address on success and NULL otherwise.
  */
-static void *__blk_alloc(buddy_t *bud, uint8_t order)
+static void *__blk_alloc(buddy_t *bud, int order)
 {
-	bool splitted;
-	kdlist_node_t *it;
-	void *r_addr, *bud1_addr, *bud2_addr, *s_aligned;
+	int found;
+	uint32_t orders;
+	void *r_addr, *bud2_addr;
+
+	/******************************************************
+	 * Smallest non-empty order fitting the request
+	 ******************************************************/
+	orders = bud->free_orders & ~((1U << order) - 1);
+	if (!orders) {
+		BUDDY_DBG("No memory left for order %d!\n", order);
+		return NULL;
+	}
+
+	found = __builtin_ctz(orders);
+	r_addr = __blk_pop(bud, found);
+
+	/******************************************************
+	 * Split down to the required order
+	 ******************************************************/
+	for (int i = found; i > order; i--) {
+		bud2_addr = __blk_2_buddy(r_addr, bud->mem, i - 1);
+		__blk_push(bud, bud2_addr, i - 1);
+
+		//
+		BUDDY_DBG("Split |%p(%u)| -> |%p(%u)|%p(%u)|\n", r_addr, i,
+				r_addr, i-1, bud2_addr, i-1);
+	}
+
+	bud->splits += found - order;
+
+	/******************************************************
+	 * Record block order (first page of the block)
+	 ******************************************************/
+	bud->blk_order[__blk_2_page(bud, r_addr)] = order + 1;
+
+	BUDDY_DBG("Found address %p for order %d!\n", r_addr, order);
+	return r_addr;
+}
+
+/**
+ * Free a memory block.
+ *
+ * @bud		: Buddy data structure.
+ * @blk		: Block address to be freed.
+ * @order	: Block order.
+ *
+ * Loop through the orders to attempt merging buddies. For each order, compute
+ * the address of the block buddy. If the buddy is not in the free list of the
+ * order (split, allocated or past the end of the arena), stop and add the
+ * block to the free list of the current order. If the buddy is free, remove
+ * it from the free list and merge the two blocks into a block of the next
+ * higher order.
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+static int __blk_free(buddy_t *bud, void *blk, int order)
+{
+	void *bud2_addr;
 
 	/******************************************************
-	 * Returned block address and aligned starting address
+	 * Clear block order
 	 ******************************************************/
-	r_addr = NULL;
-	s_aligned = PAGE_PTR_ALIGN(bud->mem);
+	bud->blk_order[__blk_2_page(bud, blk)] = 0;
 
 	/******************************************************
-	 * Loop until find a block of given order and try to
-	 * split larger blocks
+	 * Loop trying to merge free blocks
 	 ******************************************************/
-	splitted = true;
+	while (order < bud->orders) {
+		// stop if buddy is not free
+		bud2_addr = __blk_2_buddy(blk, bud->mem, order);
+		if (!__blk_is_free(bud, bud2_addr, order))
+			break;
+
+		// remove buddy from free list
+		__blk_delete(bud, bud2_addr, order);
+
+		//
+		BUDDY_DBG("Merge |%p(%u)|%p(%u)| -> |%p(%u)|\n", blk, order,
+				bud2_addr, order, MIN(blk, bud2_addr), order+1);
+
+		// move to next order
+		blk = MIN(blk, bud2_addr);
+		order++;
+
+		bud->merges++;
+	}
 
 	//
-	while (splitted) {
-		// check if our order is fulfilled
-		it = kdlist_pop_head(&bud->free_list[order]);
-		if (it) {
-			r_addr = (void *)it;
-			goto finish;
-		}
+	__blk_push(bud, blk, order);
+
+	return 0;
+}
 
-		// reset flag
-		splitted = false;
 
-		// split larger blocks
-		for (int i = order + 1; i < BUDDY_ORDERS+1; i++) {
-			// no empty block of given order to be splitted
-			if (kdlist_is_empty(&bud->free_list[i]))
-				continue;
+/*****************************************************************************/
 
-			// empty block
-			it = kdlist_pop_head(&bud->free_list[i]);
+/**
+ * Current cpu list of the thread.
+ */
+static inline buddy_pcp_t *__pcp_get(buddy_t *bud)
+{
+	int cpu_id = sched_getcpu();
 
-			// compute starting address for splitted blocks
-			bud1_addr = (void *)it;
-			bud2_addr = __blk_2_buddy(bud1_addr, s_aligned, i - 1);
+	return &bud->pcp[cpu_id < 0 ? 0 : cpu_id % BUDDY_MAX_CPUS];
+}
 
-			// split in two smaller blocks
-			kdlist_push_tail(&bud->free_list[i-1], (kdlist_node_t *)bud1_addr);
-			kdlist_push_tail(&bud->free_list[i-1], (kdlist_node_t *)bud2_addr);
+/**
+ * Give the oldest pages of a cpu list back to buddy (single buddy lock).
+ * Called with the cpu list lock held.
+ */
+static void __pcp_drain(buddy_t *bud, buddy_pcp_t *pcp, size_t count)
+{
+	kdlist_node_t *blk;
 
-			//
-			BUDDY_DBG("Split |%p(%u)| -> |%p(%u)|%p(%u)|\n", bud1_addr, i,
-					bud1_addr, i-1, bud2_addr, i-1);
+	pthread_mutex_lock(&bud->lock);
 
-			// mark as spliited
-			splitted = true;
+	while (count--) {
+		blk = kdlist_pop_tail(&pcp->pages);
+		if (!blk)
 			break;
-		}
+
+		pcp->count--;
+		__blk_free(bud, blk, 0);
 	}
 
-//out_of_memory:
-	BUDDY_DBG("No memory left for order %d!\n", order);
-	return NULL;
+	pthread_mutex_unlock(&bud->lock);
+}
+
+/**
+ * Allocate a page from the list of the current cpu, refilled by a batch of
+ * pages from buddy (single buddy lock) when empty.
+ *
+ * Return page address on success and NULL otherwise.
+ */
+static void *__pcp_alloc(buddy_t *bud)
+{
+	void *blk;
+	buddy_pcp_t *pcp = __pcp_get(bud);
+
+	pthread_mutex_lock(&pcp->lock);
 
-finish:
 	/******************************************************
-	 * Mark block as allocated in tree
+	 * Refill, pages of cpu lists are free (no order)
 	 ******************************************************/
-	assert(r_addr);
-	__blk_set_allocated(&bud->tree_mask, r_addr, s_aligned,
-						ORDER_2_LEVEL(order));
+	if (!pcp->count) {
+		pthread_mutex_lock(&bud->lock);
 
-	BUDDY_DBG("Found address %p for order %d!\n", r_addr, order);
-	return r_addr;
+		for (int i = 0; i < BUDDY_PCP_BATCH; i++) {
+			blk = __blk_alloc(bud, 0);
+			if (!blk)
+				break;
+
+			bud->blk_order[__blk_2_page(bud, blk)] = 0;
+
+			kdlist_push_tail(&pcp->pages, (kdlist_node_t *)blk);
+			pcp->count++;
+		}
+
+		pthread_mutex_unlock(&bud->lock);
+	}
+
+	/******************************************************
+	 * Most recently freed page (cache hot)
+	 ******************************************************/
+	blk = kdlist_pop_head(&pcp->pages);
+	if (blk) {
+		pcp->count--;
+		bud->blk_order[__blk_2_page(bud, blk)] = 1;
+	}
+
+	pthread_mutex_unlock(&pcp->lock);
+
+	return blk;
 }
 
 /**
- * Free a memory block.
- *
- * @bud	: Buddy data structure.
- * @blk	: Block address to be freed.
- * @lvl	: Block level in bit mask tree.
- *
- * Loop through the addresses to attempt merging buddies. For each address,
- * compute the address of its corresponding buddy. If the buddy is either split
- * or allocated, stop the iteration and add the free address to the free list
- * for the current order. If the buddy is free, remove it from the free list
- * and merge the two blocks into a block of the next higher order.
+ * Free a page to the list of the current cpu, draining a batch of pages to
+ * buddy when the list holds more than BUDDY_PCP_HIGH pages.
+ */
+static void __pcp_free(buddy_t *bud, void *blk)
+{
+	buddy_pcp_t *pcp = __pcp_get(bud);
+
+	pthread_mutex_lock(&pcp->lock);
+
+	bud->blk_order[__blk_2_page(bud, blk)] = 0;
+
+	kdlist_push_head(&pcp->pages, (kdlist_node_t *)blk);
+	pcp->count++;
+
+	if (pcp->count > BUDDY_PCP_HIGH)
+		__pcp_drain(bud, pcp, BUDDY_PCP_BATCH);
+
+	pthread_mutex_unlock(&pcp->lock);
+}
+
+static inline uint64_t __stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Start time of a sampled operation (0 if operation is not sampled).
+ */
+static inline uint64_t __stats_start(unsigned int *samples)
+{
+	if (++(*samples) % BUDDY_STATS_SAMPLE)
+		return 0;
+
+	return __stats_now();
+}
+
+/**
+ * Account a sampled operation latency in its power of two bucket.
+ */
+static inline void __stats_latency(atomic_size_t *hist, uint64_t start)
+{
+	int bucket;
+	uint64_t ns;
+
+	//
+	if (!start)
+		return;
+
+	ns = __stats_now() - start;
+	bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+
+	atomic_fetch_add_explicit(&hist[MIN(bucket, BUDDY_LAT_BUCKETS - 1)], 1,
+								memory_order_relaxed);
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Allocate a block, pages from cpu lists and larger blocks under buddy lock.
+ */
+static void *__buddy_alloc(buddy_t *bud, int order)
+{
+	void *blk;
+
+	//
+	if (!order && bud->pcp_enabled)
+		return __pcp_alloc(bud);
+
+	//
+	pthread_mutex_lock(&bud->lock);
+	blk = __blk_alloc(bud, order);
+	pthread_mutex_unlock(&bud->lock);
+
+	return blk;
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Map arena memory.
  *
- * When a block is freed, clear the corresponding allocated bit.
+ * @bud	: Buddy data structure (size and flags set).
  *
  * Return 0 on success and <0 otherwise.
  */
-static int __blk_free(buddy_t *bud, void *blk, uint8_t lvl)
+static int __buddy_map(buddy_t *bud)
 {
-	uint8_t order;
-	kdlist_node_t *node;
-	void *bud1_addr, *bud2_addr, *s_aligned;
+	void *mem, *aligned;
+	size_t xtra;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
 
-	// TODO improve implementation
+	//
+	if (!(bud->flags & BUDDY_HUGEPAGE))
+		goto map;
 
 	/******************************************************
-	 * Aligned starting address
+	 * Reserved huge pages (size must be a multiple). Huge
+	 * pages are reserved on mapping, so it fails instead
+	 * of faulting (SIGBUS) when not enough are available.
 	 ******************************************************/
-	bud1_addr = blk;
-	order = LEVEL_2_ORDER(lvl);
-	s_aligned = PAGE_PTR_ALIGN(bud->mem);
+	mem = mmap(NULL, ALIGN(bud->size, BUDDY_HUGEPAGE_SIZE),
+				PROT_READ | PROT_WRITE,
+				(flags & ~MAP_NORESERVE) | MAP_HUGETLB, -1, 0);
+	if (mem != MAP_FAILED) {
+		bud->mem = mem;
+		bud->hugetlb = true;
+		return 0;
+	}
 
 	/******************************************************
-	 * Clear allocated bit in tree and add to free list
+	 * Transparent huge pages, map xtra memory to align
+	 * arena to huge page size and unmap head and tail
 	 ******************************************************/
-	__blk_clr_allocated(&bud->tree_mask, bud1_addr, s_aligned, lvl);
-	kdlist_push_tail(&bud->free_list[order], (kdlist_node_t *)bud1_addr);
+	xtra = BUDDY_HUGEPAGE_SIZE - PAGE_SIZE;
+
+	mem = mmap(NULL, bud->size + xtra, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (mem == MAP_FAILED)
+		return -1;
+
+	aligned = ALIGN_PTR(mem, BUDDY_HUGEPAGE_SIZE);
+
+	if (aligned != mem)
+		munmap(mem, aligned - mem);
+	if (aligned + bud->size != mem + bud->size + xtra)
+		munmap(aligned + bud->size, (mem + xtra) - aligned);
+
+	// advice only, arena still works without huge pages
+	madvise(aligned, bud->size, MADV_HUGEPAGE);
+
+	bud->mem = aligned;
+	return 0;
+
+map:
+	mem = mmap(NULL, bud->size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (mem == MAP_FAILED)
+		return -1;
+
+	bud->mem = mem;
+	return 0;
+}
+
+/**
+ * Place arena pages on buddy NUMA node (pages are not touched yet, so they
+ * are allocated on the node when first used).
+ */
+static int __buddy_bind(buddy_t *bud)
+{
+	unsigned long mask;
+
+	//
+	if (bud->node == BUDDY_NODE_ANY)
+		return 0;
+
+	// maxnode counts one bit past the mask
+	mask = 1UL << bud->node;
+
+	return syscall(SYS_mbind, bud->mem, bud->size, MPOL_PREFERRED, &mask,
+					BITS_OF(mask) + 1, 0);
+}
+
+static void __buddy_unmap(buddy_t *bud)
+{
+	if (bud->hugetlb)
+		munmap(bud->mem, ALIGN(bud->size, BUDDY_HUGEPAGE_SIZE));
+	else
+		munmap(bud->mem, bud->size);
+}
+
+
+/**
+ * Allocate a block, draining cpu lists and asking shrinkers to release memory
+ * on failure.
+ */
+static void *__buddy_alloc_retry(buddy_t *bud, int order)
+{
+	void *blk;
+	size_t released = 0;
+	int shrinkers_no;
+	buddy_shrinker_t shrinkers[BUDDY_MAX_SHRINKERS];
 
 	/******************************************************
-	 * Loop trying to merge free blocks
+	 * Allocation
 	 ******************************************************/
-	while (lvl) {
-		order = LEVEL_2_ORDER(lvl);
+	blk = __buddy_alloc(bud, order);
+	if (blk)
+		return blk;
 
-		// stop if buddy is not free
-		bud2_addr = __blk_2_buddy(bud1_addr, s_aligned, order);
-		switch (__blk_get_status(bud->tree_mask, bud2_addr, s_aligned, lvl)) {
-		case BLK_SPLIT:
-		case BLK_ALLOCATED:
-			goto finish;
-		case BLK_FREE:
-			break;
-		default:
-			assert(0);
-		}
-
-		//
-		order = LEVEL_2_ORDER(lvl);
+	/******************************************************
+	 * Free pages may be held by cpu lists, give them back
+	 * (merged) and retry
+	 ******************************************************/
+	buddy_drain(bud);
 
-		// remove current and body from free list
-		node = (kdlist_node_t *)bud1_addr;
-		kdlist_delete(node);
-		//
-		node = (kdlist_node_t *)bud2_addr;
-		kdlist_delete(node);
+	blk = __buddy_alloc(bud, order);
+	if (blk)
+		return blk;
 
-		// add merged block to next order free list
-		bud1_addr = bud1_addr < bud2_addr ? bud1_addr : bud2_addr;
+	/******************************************************
+	 * Memory pressure, ask shrinkers to release memory and
+	 * retry once if any memory was released. Shrinkers are
+	 * called without lock (they free memory to buddy).
+	 ******************************************************/
+	pthread_mutex_lock(&bud->lock);
+	shrinkers_no = bud->shrinkers_no;
+	memcpy(shrinkers, bud->shrinkers, sizeof(shrinkers));
+	pthread_mutex_unlock(&bud->lock);
 
-		kdlist_push_tail(&bud->free_list[order+1], (kdlist_node_t *)bud1_addr);
+	for (int i = 0; i < shrinkers_no; i++)
+		released += shrinkers[i].shrink(shrinkers[i].arg);
 
-		//
-		BUDDY_DBG("Merge |%p(%u)|%p(%u)| -> |%p(%u)|\n", bud1_addr, order,
-				bud2_addr, order, bud1_addr, order+1);
+	if (!released)
+		return NULL;
 
-		// move to next level (higher order)
-		lvl--;
-	}
+	buddy_drain(bud);
 
-finish:
-	return 0;
+	return __buddy_alloc(bud, order);
 }
 
 
@@ -279,47 +559,157 @@ finish:
 
 /**
  * Initialize the buddy allocator.
+ *
+ * @size	: Arena size in bytes (rounded up to pages).
+ *
+ * Return buddy allocator on success and NULL otherwise.
+ */
+buddy_t *buddy_init(size_t size)
+{
+	return buddy_init_flags(size, 0);
+}
+
+/**
+ * Initialize the buddy allocator.
+ *
+ * @size	: Arena size in bytes (rounded up to pages).
+ * @flags	: BUDDY_HUGEPAGE or 0.
+ *
+ * Return buddy allocator on success and NULL otherwise.
  */
-buddy_t *buddy_init(void)
+buddy_t *buddy_init_flags(size_t size, uint32_t flags)
 {
+	return buddy_init_node(size, flags, BUDDY_NODE_ANY);
+}
+
+/**
+ * Initialize the buddy allocator with arena memory on a NUMA node.
+ *
+ * @size	: Arena size in bytes (rounded up to pages).
+ * @flags	: BUDDY_HUGEPAGE or 0.
+ * @node	: NUMA node or BUDDY_NODE_ANY.
+ *
+ * Return buddy allocator on success and NULL otherwise.
+ */
+buddy_t *buddy_init_node(size_t size, uint32_t flags, int node)
+{
+	size_t page, words[BUDDY_MAX_ORDER+1], maps_size = 0;
+	uint64_t *maps;
 	buddy_t *bud = NULL;
+	int order;
+
+	/******************************************************
+	 * Validation
+	 ******************************************************/
+	if (!size || size > SIZE_MAX - BUDDY_HUGEPAGE_SIZE ||
+		(flags & ~BUDDY_FLAGS_MASK) ||
+		node < BUDDY_NODE_ANY || node >= BUDDY_MAX_NODES) {
+		BUDDY_ERR("Unable to validate %zu bytes arena!\n", size);
+		goto error;
+	}
 
 	/******************************************************
-	 * Memory allocation and initialization
-	 *
-	 * Allocate BUDDY_XTRA bytes to ensure the buddy start
-	 * address can be aligned to a page boundary without
-	 * exceeding the allocated memory.
+	 * Data structure initialization
 	 ******************************************************/
-	bud = (buddy_t *)malloc(sizeof(buddy_t));
-	if (!bud) {
+	// per cpu lists are cache line aligned
+	if (posix_memalign((void **)&bud, 64, sizeof(buddy_t))) {
 		BUDDY_ERR("Unable to allocate buddy data structure!\n");
+		bud = NULL;
 		goto error;
 	}
 
+	memset(bud, 0, sizeof(buddy_t));
+
 	//
-	bud->tree_mask = 0;
+	bud->size = PAGE_ALIGN(size);
+	bud->pages = bud->size / PAGE_SIZE;
+	bud->flags = flags;
+	bud->node = node;
+	bud->shrinkers_no = 0;
+
+	// cpu lists hold at most a quarter of the arena
+	bud->pcp_enabled = bud->pages >= BUDDY_PCP_MIN_PAGES;
+
+	// largest order fitting in the arena
+	bud->orders = MIN(63 - __builtin_clzll(bud->pages), BUDDY_MAX_ORDER);
 
 	//
-	for (int i = 0; i < BUDDY_ORDERS + 1; i++)
+	for (int i = 0; i < BUDDY_MAX_ORDER + 1; i++)
 		kdlist_head_init(&bud->free_list[i]);
 
-	//
-	bud->mem = malloc(BUDDY_TOTAL_MEM);
-	if (!bud->mem) {
-		BUDDY_ERR("Unable to allocate buddy memory!\n");
+	/******************************************************
+	 * Metadata (order bitmaps and page orders)
+	 ******************************************************/
+	for (int i = 0; i <= bud->orders; i++) {
+		words[i] = (__order_bits(bud->pages, i) + BITS_OF(uint64_t) - 1) /
+					BITS_OF(uint64_t);
+		maps_size += words[i];
+	}
+
+	maps = calloc(maps_size, sizeof(uint64_t));
+	if (!maps) {
+		BUDDY_ERR("Unable to allocate buddy bitmaps!\n");
 		goto free_bud;
 	}
 
+	for (int i = 0; i <= bud->orders; i++) {
+		bud->free_map[i] = maps;
+		maps += words[i];
+	}
+
+	bud->blk_order = calloc(bud->pages, sizeof(uint8_t));
+	if (!bud->blk_order) {
+		BUDDY_ERR("Unable to allocate buddy page orders!\n");
+		goto free_maps;
+	}
+
 	/******************************************************
-	 * Entire memory is a single block of max order
+	 * Arena memory
 	 ******************************************************/
-	kdlist_push_tail(&bud->free_list[BUDDY_ORDERS],
-					(kdlist_node_t *)PAGE_PTR_ALIGN(bud->mem));
+	if (__buddy_map(bud)) {
+		BUDDY_ERR("Unable to map buddy memory!\n");
+		goto free_orders;
+	}
+
+	if (__buddy_bind(bud)) {
+		BUDDY_ERR("Unable to bind buddy memory to node %d!\n", node);
+		goto unmap;
+	}
+
+	/******************************************************
+	 * Locks (buddy and per cpu lists)
+	 ******************************************************/
+	pthread_mutex_init(&bud->lock, NULL);
+
+	for (int i = 0; i < BUDDY_MAX_CPUS; i++) {
+		pthread_mutex_init(&bud->pcp[i].lock, NULL);
+		kdlist_head_init(&bud->pcp[i].pages);
+		bud->pcp[i].count = 0;
+	}
+
+	/******************************************************
+	 * Split memory in the largest aligned blocks fitting
+	 * in the arena
+	 ******************************************************/
+	for (page = 0; page < bud->pages; page += (1ULL << order)) {
+		order = bud->orders;
+
+		while ((page & ((1ULL << order) - 1)) ||
+				page + (1ULL << order) > bud->pages)
+			order--;
+
+		__blk_push(bud, bud->mem + page * PAGE_SIZE, order);
+	}
 
 // success
 	return bud;
 
+unmap:
+	__buddy_unmap(bud);
+free_orders:
+	free(bud->blk_order);
+free_maps:
+	free(bud->free_map[0]);
 free_bud:
 	free(bud);
 error:
@@ -334,22 +724,40 @@ error:
  *
  * Return block address on success and NULL otherwise.
  */
-void *buddy_alloc(buddy_t *bud, uint32_t bytes)
+void *buddy_alloc(buddy_t *bud, size_t bytes)
 {
-	int order = SIZE_2_ORDER(bytes);
+	void *blk;
+	int order;
+	uint64_t start;
+	buddy_pcp_t *pcp;
 
 	/******************************************************
 	 * Validation
 	 ******************************************************/
-	if (!bud || order >= BUDDY_ORDERS+1) {
-		BUDDY_ERR("Unable to validate %d bytes allocation request!\n", bytes);
+	if (!bud || !bytes || bytes > bud->size) {
+		BUDDY_ERR("Unable to validate %zu bytes allocation request!\n", bytes);
+		return NULL;
+	}
+
+	order = SIZE_2_ORDER(bytes);
+	if (order > bud->orders) {
+		BUDDY_ERR("Unable to validate %zu bytes allocation request!\n", bytes);
 		return NULL;
 	}
 
 	/******************************************************
-	 * Allocation
+	 * Allocation and statistics
 	 ******************************************************/
-	return __blk_alloc(bud, order);
+	start = __stats_start(&__alloc_samples);
+
+	blk = __buddy_alloc_retry(bud, order);
+
+	pcp = __pcp_get(bud);
+	__stats_latency(pcp->alloc_lat, start);
+	atomic_fetch_add_explicit(blk ? &pcp->allocs : &pcp->failures, 1,
+								memory_order_relaxed);
+
+	return blk;
 }
 
 /**
@@ -358,47 +766,252 @@ void *buddy_alloc(buddy_t *bud, uint32_t bytes)
  * @bud	: Buddy data structure.
  * @blk	: Block address to be freed.
  *
- * To determine the size (order) of the memory block, loop through all levels
- * of the tree, starting from the highest level (smallest orders), and check if
- * the block's address is marked as allocated at each level.
+ * The block size (order) is read from the order recorded for its first page
+ * on allocation, so only addresses of allocated blocks are accepted.
  *
  * Return 0 on success and <0 otherwise.
  */
 int buddy_free(buddy_t *bud, void *blk)
 {
-	void *s_aligned = PAGE_PTR_ALIGN(bud->mem);
+	int order;
+	uint64_t start;
+	buddy_pcp_t *pcp;
 
 	/******************************************************
 	 * Validation (address in range and page aligned)
 	 ******************************************************/
-	if (!bud || !blk || blk < s_aligned || blk > s_aligned + BUDDY_MEM ||
-		blk != PAGE_PTR_ALIGN(blk)) {
+	if (!buddy_contains(bud, blk) || blk != PAGE_PTR_ALIGN(blk)) {
 		BUDDY_ERR("Unable to validate %p addr free request!\n", blk);
 		goto error;
 	}
 
 	/******************************************************
-	 * Check block size (order/level)
+	 * Check block size (order)
 	 ******************************************************/
-	for (int8_t level = BUDDY_ORDERS; level >= 0; level--) {
-		// skip if not aligned in level
-		if (!__blk_in_lvl_aligned(blk, s_aligned, level))
-			continue;
+	order = bud->blk_order[__blk_2_page(bud, blk)];
+	if (!order) {
+		// invalid memory address
+		BUDDY_ERR("Address %p double free or corruption!\n", blk);
+		goto error;
+	}
 
-		// check if allocated in level
-		if (__blk_is_allocated(bud->tree_mask, blk, s_aligned, level))
-			return __blk_free(bud, blk, level);
+	/******************************************************
+	 * Free and statistics
+	 ******************************************************/
+	start = __stats_start(&__free_samples);
+
+	// pages go to the current cpu list
+	if (order == 1 && bud->pcp_enabled) {
+		__pcp_free(bud, blk);
+	} else {
+		pthread_mutex_lock(&bud->lock);
+		__blk_free(bud, blk, order - 1);
+		pthread_mutex_unlock(&bud->lock);
 	}
 
-	// invalid memory address
-	BUDDY_ERR("Address %p double free or corruption!\n", blk);
+	pcp = __pcp_get(bud);
+	__stats_latency(pcp->free_lat, start);
+	atomic_fetch_add_explicit(&pcp->frees, 1, memory_order_relaxed);
+
+	return 0;
 
 error:
 	return -1;
 }
 
 /**
- * Free memory used by buddy allocator.
+ * Give the pages of all cpu lists back to buddy, so they are merged again.
+ *
+ * @bud	: Buddy data structure.
+ */
+void buddy_drain(buddy_t *bud)
+{
+	buddy_pcp_t *pcp;
+
+	//
+	if (!bud)
+		return;
+
+	//
+	for (int i = 0; i < BUDDY_MAX_CPUS; i++) {
+		pcp = &bud->pcp[i];
+
+		pthread_mutex_lock(&pcp->lock);
+		__pcp_drain(bud, pcp, pcp->count);
+		pthread_mutex_unlock(&pcp->lock);
+	}
+}
+
+/**
+ * Check if an address belongs to the memory managed by buddy allocator.
+ *
+ * @bud	: Buddy data structure.
+ * @addr: Address to be checked.
+ *
+ * Return true if address is within buddy memory and false otherwise.
+ */
+bool buddy_contains(buddy_t *bud, void *addr)
+{
+	//
+	if (!bud)
+		return false;
+
+	return (addr >= bud->mem && addr < bud->mem + bud->size);
+}
+
+/**
+ * Get statistics of the buddy allocator. Free blocks are read under the buddy
+ * lock, operation counters are summed over cpus (consistent per counter).
+ *
+ * @bud		: Buddy data structure.
+ * @stats	: Statistics (output).
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+int buddy_stats(buddy_t *bud, buddy_stats_t *stats)
+{
+	size_t free_bytes;
+	buddy_pcp_t *pcp;
+
+	//
+	if (!bud || !stats)
+		return -1;
+
+	memset(stats, 0, sizeof(buddy_stats_t));
+
+	/******************************************************
+	 * Free blocks
+	 ******************************************************/
+	pthread_mutex_lock(&bud->lock);
+
+	for (int order = 0; order <= bud->orders; order++) {
+		stats->free_blocks[order] = bud->free_blocks[order];
+		stats->free_pages += bud->free_blocks[order] << order;
+	}
+
+	if (bud->free_orders)
+		stats->largest_free = ORDER_2_SIZE(31 - __builtin_clz(bud->free_orders));
+
+	stats->splits = bud->splits;
+	stats->merges = bud->merges;
+
+	pthread_mutex_unlock(&bud->lock);
+
+	/******************************************************
+	 * Per cpu lists and counters
+	 ******************************************************/
+	for (int i = 0; i < BUDDY_MAX_CPUS; i++) {
+		pcp = &bud->pcp[i];
+
+		pthread_mutex_lock(&pcp->lock);
+		stats->pcp_pages += pcp->count;
+		pthread_mutex_unlock(&pcp->lock);
+
+		//
+		stats->allocs += atomic_load_explicit(&pcp->allocs,
+											memory_order_relaxed);
+		stats->frees += atomic_load_explicit(&pcp->frees,
+											memory_order_relaxed);
+		stats->failures += atomic_load_explicit(&pcp->failures,
+											memory_order_relaxed);
+
+		for (int j = 0; j < BUDDY_LAT_BUCKETS; j++) {
+			stats->alloc_lat[j] += atomic_load_explicit(&pcp->alloc_lat[j],
+											memory_order_relaxed);
+			stats->free_lat[j] += atomic_load_explicit(&pcp->free_lat[j],
+											memory_order_relaxed);
+		}
+	}
+
+	/******************************************************
+	 * Fragmentation (free memory out of the largest block)
+	 ******************************************************/
+	stats->free_pages += stats->pcp_pages;
+
+	if (!stats->largest_free && stats->pcp_pages)
+		stats->largest_free = PAGE_SIZE;
+
+	free_bytes = stats->free_pages * PAGE_SIZE;
+	if (free_bytes)
+		stats->fragmentation = 1.0 - (double)stats->largest_free / free_bytes;
+
+	return 0;
+}
+
+/**
+ * Register a memory pressure callback.
+ *
+ * @bud		: Buddy data structure.
+ * @shrink	: Callback releasing memory (returns number of bytes released).
+ * @arg		: Callback argument.
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+int buddy_register_shrinker(buddy_t *bud, buddy_shrink_cb shrink, void *arg)
+{
+	int ret = -1;
+
+	//
+	if (!bud || !shrink)
+		goto error;
+
+	//
+	pthread_mutex_lock(&bud->lock);
+
+	if (bud->shrinkers_no < BUDDY_MAX_SHRINKERS) {
+		bud->shrinkers[bud->shrinkers_no].shrink = shrink;
+		bud->shrinkers[bud->shrinkers_no].arg = arg;
+		bud->shrinkers_no++;
+		ret = 0;
+	}
+
+	pthread_mutex_unlock(&bud->lock);
+
+	if (!ret)
+		return 0;
+
+error:
+	BUDDY_ERR("Unable to register shrinker!\n");
+	return -1;
+}
+
+/**
+ * Unregister a memory pressure callback.
+ *
+ * @bud		: Buddy data structure.
+ * @shrink	: Registered callback.
+ * @arg		: Registered callback argument.
+ *
+ * Return 0 on success and <0 if not registered.
+ */
+int buddy_unregister_shrinker(buddy_t *bud, buddy_shrink_cb shrink, void *arg)
+{
+	int ret = -1;
+
+	//
+	if (!bud)
+		return -1;
+
+	//
+	pthread_mutex_lock(&bud->lock);
+
+	for (int i = 0; i < bud->shrinkers_no; i++) {
+		if (bud->shrinkers[i].shrink != shrink || bud->shrinkers[i].arg != arg)
+			continue;
+
+		bud->shrinkers[i] = bud->shrinkers[--bud->shrinkers_no];
+		ret = 0;
+		break;
+	}
+
+	pthread_mutex_unlock(&bud->lock);
+
+	return ret;
+}
+
+/**
+ * Free memory used by buddy allocator. No other thread may use the allocator
+ * at this point.
  *
  * @bud	: Buddy data structure.
  */
@@ -409,7 +1022,15 @@ void buddy_destroy(buddy_t *bud)
 		return;
 
 	//
-	free(bud->mem);
+	for (int i = 0; i < BUDDY_MAX_CPUS; i++)
+		pthread_mutex_destroy(&bud->pcp[i].lock);
+
+	pthread_mutex_destroy(&bud->lock);
+
+	//
+	__buddy_unmap(bud);
+	free(bud->blk_order);
+	free(bud->free_map[0]);
 	free(bud);
 }
 
@@ -427,15 +1048,18 @@ void buddy_dump(buddy_t *bud)
 		return;
 
 	/******************************************************
-	 * Unaligned starting address
+	 * Arena
 	 ******************************************************/
-	printf("Memory start %p: \n", bud->mem);
+	printf("Memory start %p: %zu pages (%s)\n", bud->mem, bud->pages,
+			bud->hugetlb ? "hugetlb" : "pages");
+
+	pthread_mutex_lock(&bud->lock);
 
 	/******************************************************
 	 * Free list
 	 ******************************************************/
-	for (int order = 0; order < BUDDY_ORDERS+1; order++) {
-		printf("ORDER %d (%d page(s)): ", order, (1 << order));
+	for (int order = 0; order <= bud->orders; order++) {
+		printf("ORDER %d (%llu page(s)): ", order, (1ULL << order));
 
 		//
 		if (kdlist_is_empty(&bud->free_list[order])) {
@@ -451,27 +1075,15 @@ void buddy_dump(buddy_t *bud)
 		printf("\n");
 	}
 
+	pthread_mutex_unlock(&bud->lock);
+
 	/******************************************************
-	 * Tree
+	 * Per cpu lists
 	 ******************************************************/
-	int bit;
-
-	printf("mask: %lu\n", bud->tree_mask);
-
-	for (int level = 0; level < BUDDY_ORDERS+1; level++) {
-		printf("LEVEL %d\n", level);
-		for (int blk = 0; blk < (1 << level); blk++) {
-			bit = (1 << level) - 1 + blk;
-
-			if (bud->tree_mask & (1ULL<<bit))
-				printf("%c(%d)|", 'A', bit);
-			else
-				if (__blk_is_split(bud->tree_mask, bit, level))
-					printf("%c(%d)|", 'S', bit);
-				else
-					printf("%c(%d)|", 'F', bit);
-
-		}
-		printf("\n");
+	for (int i = 0; i < BUDDY_MAX_CPUS; i++) {
+		pthread_mutex_lock(&bud->pcp[i].lock);
+		if (bud->pcp[i].count)
+			printf("CPU %d: %zu page(s)\n", i, bud->pcp[i].count);
+		pthread_mutex_unlock(&bud->pcp[i].lock);
 	}
 }
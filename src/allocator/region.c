@@ -0,0 +1,320 @@
+/**
+ * Region (bump pointer) allocator with checkpoints and bulk reset.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "allocator/region.h"
+
+
+/*****************************************************************************/
+
+#define MAX(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+
+/*****************************************************************************/
+
+static inline uint8_t *__chunk_end(region_chunk_t *chunk)
+{
+	return (uint8_t *)chunk + chunk->size;
+}
+
+static inline size_t __chunk_room(region_chunk_t *chunk)
+{
+	return chunk->size - sizeof(region_chunk_t);
+}
+
+/**
+ * Allocate a chunk with room for at least `size` bytes, from buddy (power of
+ * two pages) or malloc.
+ */
+static region_chunk_t *__chunk_create(region_t *region, size_t size)
+{
+	region_chunk_t *chunk = NULL;
+	size_t bytes;
+
+	//
+	if (size > SIZE_MAX / 2 - sizeof(region_chunk_t))
+		return NULL;
+
+	bytes = MAX(sizeof(region_chunk_t) + size, region->chunk_size);
+
+	/******************************************************
+	 * Buddy chunks use the whole power of two block
+	 ******************************************************/
+	if (region->buddy) {
+		bytes = MAX(1ULL << (64 - __builtin_clzll(bytes - 1)), PAGE_SIZE);
+
+		chunk = buddy_alloc(region->buddy, bytes);
+		if (chunk) {
+			chunk->buddy = true;
+			goto finish;
+		}
+	}
+
+	//
+	chunk = malloc(bytes);
+	if (!chunk) {
+		REGION_ERR("Unable to allocate %zu bytes chunk!\n", bytes);
+		return NULL;
+	}
+
+	chunk->buddy = false;
+
+finish:
+	chunk->size = bytes;
+	chunk->next = NULL;
+
+	return chunk;
+}
+
+static void __chunk_destroy(region_t *region, region_chunk_t *chunk)
+{
+	if (chunk->buddy)
+		buddy_free(region->buddy, chunk);
+	else
+		free(chunk);
+}
+
+/**
+ * Move to the next chunk with room for `size` bytes: the one following the
+ * current chunk (kept from a rewind) or a new one inserted after it.
+ */
+static int __region_grow(region_t *region, size_t size)
+{
+	region_chunk_t *next, *chunk;
+
+	//
+	next = region->chunk ? region->chunk->next : region->first;
+
+	if (!next || __chunk_room(next) < size) {
+		chunk = __chunk_create(region, size);
+		if (!chunk)
+			return -1;
+
+		chunk->next = next;
+		if (region->chunk)
+			region->chunk->next = chunk;
+		else
+			region->first = chunk;
+
+		next = chunk;
+	}
+
+	//
+	region->chunk = next;
+	region->pos = next->mem;
+	region->end = __chunk_end(next);
+
+	return 0;
+}
+
+
+/******************************** PUBLIC API *********************************/
+
+/**
+ * Create a region allocator.
+ *
+ * @buddy		: Chunks allocator (NULL for malloc).
+ * @chunk_size	: Minimum chunk size in bytes (0 for REGION_CHUNK_SIZE).
+ *
+ * Return region on success and NULL otherwise.
+ */
+region_t *region_create(buddy_t *buddy, size_t chunk_size)
+{
+	region_t *region;
+
+	//
+	region = malloc(sizeof(region_t));
+	if (!region) {
+		REGION_ERR("Unable to allocate region!\n");
+		return NULL;
+	}
+
+	region->buddy = buddy;
+	region->chunk_size = chunk_size ? chunk_size : REGION_CHUNK_SIZE;
+
+	// first chunk is allocated on first use
+	region->first = NULL;
+	region->chunk = NULL;
+	region->pos = NULL;
+	region->end = NULL;
+
+	return region;
+}
+
+/**
+ * Destroy a region, freeing all of its objects and chunks.
+ *
+ * @region	: Region allocator.
+ */
+void region_destroy(region_t *region)
+{
+	region_chunk_t *chunk, *next;
+
+	//
+	if (!region)
+		return;
+
+	for (chunk = region->first; chunk; chunk = next) {
+		next = chunk->next;
+		__chunk_destroy(region, chunk);
+	}
+
+	free(region);
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Allocate memory with a given alignment.
+ *
+ * @region	: Region allocator.
+ * @size	: Size in bytes.
+ * @align	: Power of two alignment, up to PAGE_SIZE.
+ *
+ * Return memory address on success and NULL otherwise.
+ */
+void *region_alloc_align(region_t *region, size_t size, size_t align)
+{
+	uint8_t *ptr;
+
+	//
+	if (!region || !size || !align || !IS_POWER_2(align) || align > PAGE_SIZE)
+		return NULL;
+
+	/******************************************************
+	 * Bump pointer in current chunk
+	 ******************************************************/
+	ptr = ALIGN_PTR(region->pos, align);
+
+	if (region->chunk && ptr <= region->end &&
+		size <= (size_t)(region->end - ptr)) {
+		region->pos = ptr + size;
+		return ptr;
+	}
+
+	/******************************************************
+	 * Next chunk, with room for alignment padding
+	 ******************************************************/
+	if (size > SIZE_MAX - align || __region_grow(region, size + align - 1))
+		return NULL;
+
+	ptr = ALIGN_PTR(region->pos, align);
+	region->pos = ptr + size;
+
+	return ptr;
+}
+
+/**
+ * Allocate memory (REGION_ALIGN aligned).
+ *
+ * @region	: Region allocator.
+ * @size	: Size in bytes.
+ *
+ * Return memory address on success and NULL otherwise.
+ */
+void *region_alloc(region_t *region, size_t size)
+{
+	return region_alloc_align(region, size, REGION_ALIGN);
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Get the current position of a region (checkpoint).
+ *
+ * @region	: Region allocator.
+ */
+region_mark_t region_mark(region_t *region)
+{
+	region_mark_t mark = { .chunk = region->chunk, .pos = region->pos };
+
+	return mark;
+}
+
+/**
+ * Free all objects allocated after a checkpoint, in O(1). Checkpoints taken
+ * after it are no longer valid.
+ *
+ * @region	: Region allocator.
+ * @mark	: Checkpoint of this region.
+ */
+void region_rewind(region_t *region, region_mark_t mark)
+{
+	// checkpoint of an empty region
+	if (!mark.chunk) {
+		region_reset(region);
+		return;
+	}
+
+	region->chunk = mark.chunk;
+	region->pos = mark.pos;
+	region->end = __chunk_end(mark.chunk);
+}
+
+/**
+ * Free all objects, in O(1). Chunks are kept for reuse.
+ *
+ * @region	: Region allocator.
+ */
+void region_reset(region_t *region)
+{
+	//
+	if (!region->first)
+		return;
+
+	region->chunk = region->first;
+	region->pos = region->first->mem;
+	region->end = __chunk_end(region->first);
+}
+
+/**
+ * Give back the chunks past the current position (kept by rewind/reset).
+ *
+ * @region	: Region allocator.
+ */
+void region_trim(region_t *region)
+{
+	region_chunk_t *chunk, *next;
+
+	//
+	if (!region->chunk) {
+		chunk = region->first;
+		region->first = NULL;
+	} else {
+		chunk = region->chunk->next;
+		region->chunk->next = NULL;
+	}
+
+	for (; chunk; chunk = next) {
+		next = chunk->next;
+		__chunk_destroy(region, chunk);
+	}
+}
+
+/**
+ * Get the size of all chunks of a region.
+ *
+ * @region	: Region allocator.
+ *
+ * Return size in bytes (chunk headers included).
+ */
+size_t region_size(region_t *region)
+{
+	region_chunk_t *chunk;
+	size_t size = 0;
+
+	//
+	for (chunk = region->first; chunk; chunk = chunk->next)
+		size += chunk->size;
+
+	return size;
+}
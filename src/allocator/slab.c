@@ -3,12 +3,15 @@
  * Copyright (C) 2025 Lazar Razvan.
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <sched.h>
 
 #include "allocator/slab.h"
 
@@ -16,64 +19,179 @@
 /*****************************************************************************/
 
 #define BITS_OF(type)				(sizeof(type) * 8)
-#define BITMAPS_FULL(o)				((o) / BITS_OF(uint64_t))
-#define BITMAPS_BITS_LEFT(o)		((o) % BITS_OF(uint64_t))
+#define BITMAP_FULL					(~0ULL)
+
+
+/*****************************************************************************/
+
+// all slab caches (reclaim)
+static KDLIST_HEAD(__slab_caches);
+static pthread_mutex_t __slab_caches_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// slabs memory per node (node + 1, 0 is any node), under caches lock
+static buddy_t *__slab_arenas[SLAB_MAX_NODES + 1];
+static int __slab_arenas_refs[SLAB_MAX_NODES + 1];
+
+// bytes given back to each arena (shrinker accounting)
+static atomic_size_t __slab_arenas_freed[SLAB_MAX_NODES + 1];
+
+// registered caches by id (read without lock), ids used so far and last
+// generation, under caches lock
+static _Atomic(slab_cache_t *) __slab_cache_tab[SLAB_MAX_CACHES];
+static size_t __slab_cache_ids;
+static uint64_t __slab_cache_gen;
+
+// thread magazines of all caches (slab_tcache_table_t)
+static pthread_key_t __slab_tcache_key;
+static pthread_once_t __slab_tcache_once = PTHREAD_ONCE_INIT;
+static int __slab_tcache_key_err;
 
 
 /*****************************************************************************/
 
-static inline void *__addr_2_slab(void *ptr)
+static inline void *__addr_2_slab(void *ptr, size_t slab_size)
+{
+	return (void *)((uintptr_t)ptr & ~(slab_size - 1));
+}
+
+static inline void *__slab_mem(slab_t *slab)
 {
-	return (void *)((uintptr_t)ptr & ~(SLAB_BLK_SIZE - 1));
+	return (void *)slab + slab->slab_cache->mem_offset;
 }
 
 static inline bool __slab_is_addr_in_range(slab_t *slab, void *ptr)
 {
-	void *s_addr = (void *)&slab->mem;
+	void *s_addr = __slab_mem(slab);
 
-	return ((ptr >= s_addr) && (ptr < s_addr + SLAB_MEM_SIZE));
+	return ((ptr >= s_addr) && (ptr < s_addr +
+		slab->slab_cache->obj_per_slab * slab->slab_cache->obj_size_align));
 }
 
 static inline bool __slab_is_addr_aligned(slab_t *slab, void *ptr, size_t size)
 {
-	void *s_addr = (void *)&slab->mem;
+	void *s_addr = __slab_mem(slab);
 
-	return (!((uintptr_t)ptr % SLAB_OBJ_ALIGNMENT)) && !((ptr - s_addr) % size);
+	// objects start is aligned and size is a multiple of alignment
+	return !((ptr - s_addr) % size);
 }
 
 static inline void *__slab_obj_addr(slab_t *slab, size_t bitmap_idx,
 									size_t bit_idx, size_t obj_size_align)
 {
-	void *s_addr = (void *)&slab->mem;
+	void *s_addr = __slab_mem(slab);
 
 	return (s_addr + (((bitmap_idx * BITS_OF(uint64_t)) + bit_idx) *
 		obj_size_align));
 }
 
+static inline size_t __slab_red_zone_end(size_t obj_size)
+{
+	// red zone word is aligned, bytes before it belong to the red zone too
+	return ALIGN(obj_size, RED_ZONE_SIZE) + RED_ZONE_SIZE;
+}
+
+static inline bool __slab_check_bytes(void *ptr, uint8_t pattern, size_t size)
+{
+	uint8_t *p = ptr;
+
+	for (size_t i = 0; i < size; i++) {
+		if (p[i] != pattern)
+			return false;
+	}
+
+	return true;
+}
+
 
 /*****************************************************************************/
 
-static void __slab_dump(slab_t *slab, uint8_t _full, uint8_t _bits)
+/**
+ * Fill red zones and poison all objects of a new slab (debug caches).
+ */
+static void __slab_debug_init(slab_t *slab)
 {
-	int i, j;
-	uint64_t *bitmap = slab->bitmap;
+	void *obj;
+	slab_cache_t *slab_cache = slab->slab_cache;
 
+	for (size_t i = 0; i < slab_cache->obj_per_slab; i++) {
+		obj = __slab_mem(slab) + i * slab_cache->obj_size_align;
+
+		if (slab_cache->flags & SLAB_POISON)
+			memset(obj, SLAB_POISON_FREE, slab_cache->obj_size);
+
+		if (slab_cache->flags & SLAB_RED_ZONE)
+			memset(obj + slab_cache->obj_size, RED_ZONE_MAGIC,
+				__slab_red_zone_end(slab_cache->obj_size) - slab_cache->obj_size);
+	}
+}
+
+/**
+ * Validate an allocated object of a debug cache.
+ */
+static void __slab_debug_alloc(slab_cache_t *slab_cache, void *ptr, int cpu_id)
+{
 	//
-	printf("    SLAB [%p] count: %ld\n", slab, slab->count);
+	if (slab_cache->flags & SLAB_CONSISTENCY_CHECKS)
+		assert(cpu_id == SLAB_CPU_ANY || (cpu_id >= 0 && cpu_id < MAX_CPUS));
+
+	// free objects are poisoned, any other byte was written after free
+	if (slab_cache->flags & SLAB_POISON &&
+		!__slab_check_bytes(ptr, SLAB_POISON_FREE, slab_cache->obj_size)) {
+		SLAB_ERR("Use after free of address %p\n", ptr);
+		assert(0);
+	}
+}
+
+/**
+ * Validate an object being freed to a debug cache and poison it.
+ */
+static void __slab_debug_free(slab_cache_t *slab_cache, void *ptr)
+{
+	slab_t *slab;
 
 	//
-	for (i = 0; i < _full; i++) {
-		for (j = 0; j < 64; j++) {
-			printf("        obj %ld : %s\n",
-					(i * BITS_OF(uint64_t)) + j,
-					bitmap[i] & (1ULL << j) ? "USED" : "FREE");
+	if (slab_cache->flags & SLAB_CONSISTENCY_CHECKS) {
+		slab = __addr_2_slab(ptr, slab_cache->slab_size);
+
+		if (slab->magic != SLAB_MAGIC || slab->slab_cache != slab_cache ||
+			!__slab_is_addr_in_range(slab, ptr) ||
+			!__slab_is_addr_aligned(slab, ptr, slab_cache->obj_size_align)) {
+			SLAB_ERR("Invalid %p free address!\n", ptr);
+			assert(0);
 		}
 	}
 
 	//
-	for (j = 0; j < _bits; j++) {
-		printf("        obj %ld : %s\n",
-				(i * BITS_OF(uint64_t)) + j,
+	if (slab_cache->flags & SLAB_RED_ZONE &&
+		!__slab_check_bytes(ptr + slab_cache->obj_size, RED_ZONE_MAGIC,
+			__slab_red_zone_end(slab_cache->obj_size) - slab_cache->obj_size)) {
+		SLAB_ERR("Red zone corruption for address %p\n", ptr);
+		assert(0);
+	}
+
+	//
+	if (slab_cache->flags & SLAB_POISON)
+		memset(ptr, SLAB_POISON_FREE, slab_cache->obj_size);
+}
+
+
+/*****************************************************************************/
+
+static void __slab_dump(slab_t *slab, size_t obj_per_slab)
+{
+	size_t i, j;
+	uint64_t *bitmap = slab->bitmap;
+
+	//
+	printf("    SLAB [%p] count: %u free_idx: %u\n", slab, slab->count,
+			slab->free_idx);
+
+	//
+	for (size_t obj = 0; obj < obj_per_slab; obj++) {
+		i = obj / BITS_OF(uint64_t);
+		j = obj % BITS_OF(uint64_t);
+
+		printf("        obj %ld : %s\n", obj,
 				bitmap[i] & (1ULL << j) ? "USED" : "FREE");
 	}
 }
@@ -99,35 +217,127 @@ static inline bool __slab_is_partial(slab_t *slab, size_t obj_per_slab)
 
 /*****************************************************************************/
 
-static slab_t * __slab_create(size_t bitmap_size)
+/**
+ * Get the slabs arena of a node, created by its first cache (caches lock must
+ * be held).
+ */
+static buddy_t *__slab_arena_get(int node)
+{
+	buddy_t *arena;
+
+	//
+	arena = __slab_arenas[node + 1];
+	if (!arena) {
+		arena = buddy_init_node(SLAB_ARENA_SIZE, BUDDY_HUGEPAGE, node);
+		if (!arena)
+			return NULL;
+
+		assert((uintptr_t)arena->mem % SLAB_MAX_BLK_SIZE == 0);
+
+		// arena pressure reclaims the caches of the arena
+		if (buddy_register_shrinker(arena, slab_shrinker, arena)) {
+			buddy_destroy(arena);
+			return NULL;
+		}
+
+		__slab_arenas[node + 1] = arena;
+	}
+
+	__slab_arenas_refs[node + 1]++;
+
+	return arena;
+}
+
+/**
+ * Release the slabs arena of a node, destroyed with its last cache (caches
+ * lock must be held).
+ */
+static void __slab_arena_put(int node)
+{
+	if (--__slab_arenas_refs[node + 1])
+		return;
+
+	buddy_destroy(__slab_arenas[node + 1]);
+	__slab_arenas[node + 1] = NULL;
+}
+
+/**
+ * Allocate slab memory aligned to its size (slab of an object found by
+ * masking), from the cache arena if any.
+ */
+static void *__slab_mem_alloc(slab_cache_t *slab_cache)
+{
+	void *mem;
+
+	// arena blocks are aligned to their size
+	if (slab_cache->arena) {
+		mem = buddy_alloc(slab_cache->arena, slab_cache->slab_size);
+		if (mem)
+			return mem;
+	}
+
+	//
+	if (posix_memalign(&mem, slab_cache->slab_size, slab_cache->slab_size))
+		return NULL;
+
+	return mem;
+}
+
+static void __slab_mem_free(slab_cache_t *slab_cache, void *mem)
+{
+	if (buddy_contains(slab_cache->arena, mem)) {
+		buddy_free(slab_cache->arena, mem);
+		atomic_fetch_add_explicit(&__slab_arenas_freed[slab_cache->nid + 1],
+								slab_cache->slab_size, memory_order_relaxed);
+	} else {
+		free(mem);
+	}
+}
+
+
+/*****************************************************************************/
+
+static slab_t * __slab_create(slab_cache_t *slab_cache, int cpu_id)
 {
+	size_t i, obj_per_slab;
 	slab_t *slab = NULL;
 
-	// ensure page aligned slabs
-	if (posix_memalign((void **)&slab, PAGE_SIZE, SLAB_BLK_SIZE)) {
+	//
+	obj_per_slab = slab_cache->obj_per_slab;
+
+	//
+	slab = __slab_mem_alloc(slab_cache);
+	if (!slab) {
 		SLAB_ERR("Unable to create new slab entry!\n");
 		goto finish;
 	}
 
-#if DBG_ENABLE
-	assert((uintptr_t)((void *)&slab->mem) % SLAB_MEM_OFFSET == 0);
-#endif
-
-	slab->bitmap = calloc(bitmap_size, sizeof(uint64_t));
-	if (!slab->bitmap) {
-		SLAB_ERR("Unable to create new slab metadata!\n");
-		goto free_slab;
+	/**
+	 * Bits past the last object are marked as used, so they are never
+	 * allocated and a word is full only when all its bits are set.
+	 */
+	for (i = 0; i < slab_cache->bitmap_size; i++) {
+		if (obj_per_slab >= (i + 1) * BITS_OF(uint64_t))
+			slab->bitmap[i] = 0;
+		else if (obj_per_slab <= i * BITS_OF(uint64_t))
+			slab->bitmap[i] = BITMAP_FULL;
+		else
+			slab->bitmap[i] = BITMAP_FULL <<
+								(obj_per_slab % BITS_OF(uint64_t));
 	}
 
 	slab->count = 0;
+	slab->free_idx = 0;
+	slab->cpu_id = cpu_id;
+	slab->order = slab_cache->slab_order;
+	slab->cache_id = slab_cache->id;
+	slab->slab_cache = slab_cache;
 	slab->magic = SLAB_MAGIC;
 
-//success
-	return slab;
+	//
+	if (slab_cache->flags & (SLAB_RED_ZONE | SLAB_POISON))
+		__slab_debug_init(slab);
 
-free_slab:
-	free(slab);
-	slab = NULL;
 finish:
 	return slab;
 }
@@ -135,72 +345,47 @@ finish:
 
 static void __slab_destroy(slab_t *slab)
 {
-	free(slab->bitmap);
-	free(slab);
+	/**
+	 * Memory may be reused as objects of a larger slab, clear the header for
+	 * slab_cache_of (volatile, a store before free is dropped otherwise).
+	 */
+	*(volatile uint64_t *)&slab->magic = 0;
+	__slab_mem_free(slab->slab_cache, slab);
 }
 
 
 /*****************************************************************************/
 
-static void * __slab_alloc(slab_t *slab, size_t obj_size, size_t obj_size_align,
-						uint8_t _full, uint8_t _bits)
+static void * __slab_alloc(slab_t *slab, size_t obj_size, size_t obj_size_align)
 {
-	int i;
+	size_t i;
 	void *ptr = NULL;
-	uint64_t _bit, _bitmap, _masked, mask;
-
-#if DBG_ENABLE
-	size_t obj_per_slab = _full * BITS_OF(uint64_t) + _bits;
-
-	assert(__slab_is_free(slab) || __slab_is_partial(slab, obj_per_slab));
-#endif
-
-	/**
-	 * Lookup into fully specified bitmaps for a free object.
-	 */
-	for (i = 0; i < _full; i++) {
-		_bitmap = slab->bitmap[i];
-
-		if (_bitmap == 0xFF)
-			continue;
-
-		_bit = __builtin_ctzll(~_bitmap);
-		slab->bitmap[i] = _bitmap | (1ULL << _bit);
-
-		goto finish;
-	}
+	uint64_t _bit, _bitmap;
 
 	/**
-	 * Lookup into remaining bits. Since a free an object was not found above,
-	 * it is mandatory to have remaining bits and a free object within.
+	 * First bitmap word with a free bit is given by the hint. Since the slab
+	 * is not full, such a word always exists.
 	 */
-#if DBG_ENABLE
-	assert(_bits);
-#endif
+	i = slab->free_idx;
 
 	_bitmap = slab->bitmap[i];
-	_masked = (1ULL << _bits) - 1;
-	mask = _bitmap & _masked;
-
-#if DBG_ENABLE
-	assert(mask != _masked);
-#endif
+	_bit = __builtin_ctzll(~_bitmap);
+	_bitmap |= (1ULL << _bit);
+	slab->bitmap[i] = _bitmap;
 
-	_bit = __builtin_ctzll(~mask);
-	slab->bitmap[i] = _bitmap | (1ULL << _bit);
-
-finish:
 	slab->count++;
 
 	ptr = __slab_obj_addr(slab, i, _bit, obj_size_align);
-#if DBG_ENABLE
-	assert((uintptr_t)ptr % SLAB_OBJ_ALIGNMENT == 0);
-#endif
 
-#if RED_ZONE
-	uint64_t *red_zone = ptr + obj_size;
-	*red_zone = RED_ZONE_MAGIC;
-#endif
+	// word became full, move hint to the next non full word
+	if (_bitmap == BITMAP_FULL) {
+		do {
+			i++;
+		} while (i < slab->slab_cache->bitmap_size &&
+				slab->bitmap[i] == BITMAP_FULL);
+
+		slab->free_idx = i;
+	}
 
 	return ptr;
 }
@@ -212,7 +397,7 @@ static void __slab_free(slab_t *slab, void *ptr, size_t obj_size,
 	uint64_t _bitmap, _masked, obj_idx, bitmap_idx, bit_idx;
 
 	//
-	slab_mem = (void *)&slab->mem;
+	slab_mem = __slab_mem(slab);
 
 	//
 	if (!__slab_is_addr_aligned(slab, ptr, obj_size_align)) {
@@ -225,6 +410,12 @@ static void __slab_free(slab_t *slab, void *ptr, size_t obj_size,
 	bitmap_idx	= obj_idx / BITS_OF(uint64_t);
 	bit_idx		= obj_idx % BITS_OF(uint64_t);
 
+	// bits past the last object are always set
+	if (obj_idx >= slab->slab_cache->obj_per_slab) {
+		SLAB_ERR("Invalid %p free address!\n", ptr);
+		assert(0);
+	}
+
 	//
 	_bitmap = slab->bitmap[bitmap_idx];
 	_masked = (1ULL << bit_idx);
@@ -235,177 +426,30 @@ static void __slab_free(slab_t *slab, void *ptr, size_t obj_size,
 		assert(0);
 	}
 
-#if RED_ZONE
-	uint64_t *red_zone = ptr + obj_size;
-
-	if (*red_zone != RED_ZONE_MAGIC) {
-		SLAB_ERR("Red zone corruption for address %p\n", ptr);
-		assert(0);
-	}
-
-#endif
-
 	slab->bitmap[bitmap_idx] = _bitmap & ~_masked;
 	slab->count--;
-}
-
-
-/******************************************************************************
- * Public API
- *****************************************************************************/
-
-/**
- * Initialize slab cache.
- *
- * @obj_size	: Slab cache object size.
- * @obj_name	: Slab object name.
- *
- * Return slab cache on success or NULL otherwise.
- */
-slab_cache_t * slab_cache_create(size_t obj_size, char *obj_name)
-{
-	slab_cache_t *slab_cache = NULL;
-
-	//
-	if ((obj_size > SLAB_OBJ_MAX_SIZE) || (obj_size < SLAB_OBJ_MIN_SIZE)) {
-		SLAB_ERR("Invalid object size!\n");
-		goto finish;
-	}
-
-	if (!obj_name || strlen(obj_name) >= SLAB_OBJ_MAX_NAME) {
-		SLAB_ERR("Invalid object name!\n");
-		goto finish;
-	}
-
-	//
-	slab_cache = malloc(sizeof(slab_cache_t));
-	if (!slab_cache) {
-		SLAB_ERR("Unable to create slab_cache!\n");
-		goto finish;
-	}
-
-	//
-	slab_cache->obj_size 		= obj_size;
-#if RED_ZONE
-	obj_size += RED_ZONE_SIZE;
-#endif
-	slab_cache->obj_size_align	= ALIGN(obj_size, SLAB_OBJ_ALIGNMENT);
-	slab_cache->obj_per_slab	= SLAB_MEM_SIZE / slab_cache->obj_size_align;
-
-	slab_cache->full_bytes		= BITMAPS_FULL(slab_cache->obj_per_slab);
-	slab_cache->left_bits		= BITMAPS_BITS_LEFT(slab_cache->obj_per_slab);
-
-	//
-	memcpy(slab_cache->obj_name, obj_name, strlen(obj_name));
-
-	//
-	for (int i = 0; i < MAX_CPUS; i++) {
-		kdlist_head_init(&slab_cache->_cpu[i].full_slabs_head);
-		kdlist_head_init(&slab_cache->_cpu[i].partial_slabs_head);
-		kdlist_head_init(&slab_cache->_cpu[i].free_slabs_head);
-	}
-
-
-finish:
-	return slab_cache;
-}
-
-
-/**
- * Destroy slab cache.
- *
- * @slab_cache	: Slab cache to be destroyed.
- */
-void slab_cache_destroy(slab_cache_t *slab_cache)
-{
-	slab_t *slab;
-	kdlist_node_t *it, *aux;
-
-	//
-	if (!slab_cache)
-		goto finish;
-
-	//
-	for (int i = 0; i < MAX_CPUS; i++) {
-		kdlist_for_each_safe(it, aux, &slab_cache->_cpu[i].full_slabs_head) {
-			slab = kdlist_entry(it, slab_t, node);
-			__slab_destroy(slab);
-		}
-
-		kdlist_for_each_safe(it, aux, &slab_cache->_cpu[i].partial_slabs_head) {
-			slab = kdlist_entry(it, slab_t, node);
-			__slab_destroy(slab);
-		}
-
-		kdlist_for_each_safe(it, aux, &slab_cache->_cpu[i].free_slabs_head) {
-			slab = kdlist_entry(it, slab_t, node);
-			__slab_destroy(slab);
-		}
-	}
-
-	//
-	free(slab_cache);
-
-finish:
-	return;
-}
-
-/**
- * Shrink slab cache.
- *
- * @slab_cache	: Slab cache to be destroyed.
- * @cpu_id		: Core id.
- */
-void slab_cache_shrink(slab_cache_t *slab_cache, int cpu_id)
-{
-	slab_t *slab;
-	kdlist_node_t *it, *aux;
-
-	//
-	if (!slab_cache)
-		goto finish;
 
 	//
-	kdlist_for_each_safe(it, aux, &slab_cache->_cpu[cpu_id].free_slabs_head) {
-		slab = kdlist_entry(it, slab_t, node);
-		__slab_destroy(slab);
-	}
-
-finish:
-	return;
+	if (bitmap_idx < slab->free_idx)
+		slab->free_idx = bitmap_idx;
 }
 
 
 /*****************************************************************************/
 
 /**
- * Allocate slab cache object.
- *
- * @slab_cache	: slab cache to be used for allocation.
- * @cpu_id		: Core id.
- *
- * Return object address on success and NULL otherwise.
+ * Allocate an object from the slabs of a cpu. Called with cpu lock held (the
+ * lock is dropped while the memory of a new slab is allocated).
  */
-void * slab_cache_alloc(slab_cache_t *slab_cache, int cpu_id)
+static void *__slab_cpu_alloc(slab_cache_t *slab_cache, int cpu_id)
 {
 	slab_t *slab;
 	void *obj = NULL;
 	kdlist_node_t *it;
-	uint8_t _full, _bits;
 	kdlist_head_t *partial_slabs, *full_slabs, *free_slabs;
-	size_t obj_size, obj_per_slab, obj_size_align, bitmap_size;
-
-	//
-	if (!slab_cache)
-		goto finish;
-
-#if DBG_ENABLE
-	assert(cpu_id >= 0 && cpu_id < MAX_CPUS);
-#endif
+	size_t obj_size, obj_per_slab, obj_size_align;
 
 	//
-	_full			= slab_cache->full_bytes;
-	_bits			= slab_cache->left_bits;
 	obj_size		= slab_cache->obj_size;
 	obj_per_slab	= slab_cache->obj_per_slab;
 	obj_size_align	= slab_cache->obj_size_align;
@@ -423,7 +467,7 @@ void * slab_cache_alloc(slab_cache_t *slab_cache, int cpu_id)
 	kdlist_for_each(it, partial_slabs) {
 		slab = kdlist_entry(it, slab_t, node);
 
-		obj = __slab_alloc(slab, obj_size, obj_size_align, _full, _bits);
+		obj = __slab_alloc(slab, obj_size, obj_size_align);
 		if (!obj)
 			goto free_slabs_lookup;
 
@@ -444,12 +488,13 @@ free_slabs_lookup:
 	kdlist_for_each(it, free_slabs) {
 		slab = kdlist_entry(it, slab_t, node);
 
-		obj = __slab_alloc(slab, obj_size, obj_size_align, _full, _bits);
+		obj = __slab_alloc(slab, obj_size, obj_size_align);
 		if (!obj)
 			goto new_slab;
 
 		//
 		kdlist_delete(it);
+		slab_cache->_cpu[cpu_id].free_slabs--;
 
 		if (__slab_is_full(slab, obj_per_slab))
 			kdlist_push_tail(full_slabs, it);
@@ -464,98 +509,1140 @@ free_slabs_lookup:
 	 * and move the slab either to partial or full list.
 	 */
 new_slab:
-	bitmap_size = (obj_per_slab + BITS_OF(uint64_t) - 1) / BITS_OF(uint64_t);
-	slab = __slab_create(bitmap_size);
-	if (!slab) {
-		goto finish;
+	/**
+	 * Arena allocation may call the arena shrinker, which reclaims the
+	 * slabs of this cpu too (under its lock). The new slab is not on any
+	 * list until the lock is taken again.
+	 */
+	pthread_mutex_unlock(&slab_cache->_cpu[cpu_id].lock);
+	slab = __slab_create(slab_cache, cpu_id);
+	pthread_mutex_lock(&slab_cache->_cpu[cpu_id].lock);
+
+	if (!slab) {
+		goto finish;
+	}
+
+	//
+	obj = __slab_alloc(slab, obj_size, obj_size_align);
+	if (!obj) {
+		SLAB_ERR("Unable to allocate new object!\n");
+		__slab_destroy(slab);
+		goto finish;
+	}
+
+	if (__slab_is_full(slab, obj_per_slab))
+		kdlist_push_tail(full_slabs, &slab->node);
+	else
+		kdlist_push_tail(partial_slabs, &slab->node);
+
+finish:
+	return obj;
+}
+
+/**
+ * Free an object to its slab. Called with the lock of the slab cpu held.
+ */
+static void __slab_cpu_free(slab_cache_t *slab_cache, slab_t *slab, void *ptr)
+{
+	bool full_slab;
+	per_cpu_slab_t *cpu;
+	size_t obj_size, obj_size_align, obj_per_slab;
+
+	//
+	obj_size		= slab_cache->obj_size;
+	obj_per_slab	= slab_cache->obj_per_slab;
+	obj_size_align	= slab_cache->obj_size_align;
+
+	//
+	cpu = &slab_cache->_cpu[slab->cpu_id];
+
+	/**
+	 * After validation and mark object as free check if moving slab to partial
+	 * or free list is required.
+	 */
+	full_slab = __slab_is_full(slab, obj_per_slab);
+
+	//
+	__slab_free(slab, ptr, obj_size, obj_size_align);
+
+	//
+	if (__slab_is_free(slab)) {
+		kdlist_delete(&slab->node);
+
+		// above watermark, give the slab back (amortized reclaim)
+		if (cpu->free_slabs >= atomic_load_explicit(&slab_cache->free_slabs_max,
+													memory_order_relaxed)) {
+			__slab_destroy(slab);
+			return;
+		}
+
+		kdlist_push_tail(&cpu->free_slabs_head, &slab->node);
+		cpu->free_slabs++;
+	} else if (full_slab) {
+		kdlist_delete(&slab->node);
+		kdlist_push_tail(&cpu->partial_slabs_head, &slab->node);
+	}
+}
+
+/**
+ * Destroy free slabs of a cpu, keeping at most `keep` of them.
+ *
+ * Return number of destroyed slabs.
+ */
+static size_t __slab_cpu_reclaim(slab_cache_t *slab_cache, int cpu_id,
+								size_t keep)
+{
+	slab_t *slab;
+	size_t slabs = 0;
+	kdlist_node_t *it, *aux;
+	per_cpu_slab_t *cpu = &slab_cache->_cpu[cpu_id];
+
+	pthread_mutex_lock(&cpu->lock);
+
+	kdlist_for_each_safe(it, aux, &cpu->free_slabs_head) {
+		if (cpu->free_slabs <= keep)
+			break;
+
+		slab = kdlist_entry(it, slab_t, node);
+
+		kdlist_delete(it);
+		__slab_destroy(slab);
+
+		cpu->free_slabs--;
+		slabs++;
+	}
+
+	pthread_mutex_unlock(&cpu->lock);
+
+	return slabs;
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Resolve cpu id (SLAB_CPU_ANY selects the current cpu of the thread).
+ *
+ * Return cpu id or <0 if cpu_id is out of range.
+ */
+static inline int __slab_cpu(int cpu_id)
+{
+	if (cpu_id != SLAB_CPU_ANY)
+		return cpu_id >= 0 && cpu_id < MAX_CPUS ? cpu_id : -1;
+
+	cpu_id = sched_getcpu();
+
+	return cpu_id < 0 ? 0 : cpu_id % MAX_CPUS;
+}
+
+/**
+ * Fill a magazine with objects from the slabs of a cpu (single lock).
+ */
+static void __slab_mag_fill(slab_cache_t *slab_cache, slab_magazine_t *mag,
+							int cpu_id)
+{
+	void *obj;
+	per_cpu_slab_t *cpu = &slab_cache->_cpu[cpu_id];
+
+	pthread_mutex_lock(&cpu->lock);
+
+	while (mag->rounds < SLAB_MAG_SIZE) {
+		obj = __slab_cpu_alloc(slab_cache, cpu_id);
+		if (!obj)
+			break;
+
+		mag->objs[mag->rounds++] = obj;
+	}
+
+	pthread_mutex_unlock(&cpu->lock);
+}
+
+/**
+ * Return all objects of a magazine to their slabs. Consecutive objects of the
+ * same cpu are freed under a single lock.
+ */
+static void __slab_mag_drain(slab_cache_t *slab_cache, slab_magazine_t *mag)
+{
+	slab_t *slab;
+	per_cpu_slab_t *cpu = NULL;
+
+	for (size_t i = 0; i < mag->rounds; i++) {
+		slab = __addr_2_slab(mag->objs[i], slab_cache->slab_size);
+
+		if (slab->magic != SLAB_MAGIC) {
+			SLAB_ERR("Invalid %p free address!\n", mag->objs[i]);
+			assert(0);
+		}
+
+		if (cpu != &slab_cache->_cpu[slab->cpu_id]) {
+			if (cpu)
+				pthread_mutex_unlock(&cpu->lock);
+
+			cpu = &slab_cache->_cpu[slab->cpu_id];
+			pthread_mutex_lock(&cpu->lock);
+		}
+
+		__slab_cpu_free(slab_cache, slab, mag->objs[i]);
+	}
+
+	if (cpu)
+		pthread_mutex_unlock(&cpu->lock);
+
+	mag->rounds = 0;
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Exchange an empty magazine for a full one from depot.
+ *
+ * Return full magazine or NULL if depot has none.
+ */
+static slab_magazine_t *__slab_depot_get_full(slab_depot_t *depot,
+											slab_magazine_t *empty)
+{
+	kdlist_node_t *it;
+
+	pthread_mutex_lock(&depot->lock);
+
+	it = kdlist_pop_head(&depot->full_mags_head);
+	if (it) {
+		depot->full_mags--;
+		kdlist_push_tail(&depot->empty_mags_head, &empty->node);
+	}
+
+	pthread_mutex_unlock(&depot->lock);
+
+	return it ? kdlist_entry(it, slab_magazine_t, node) : NULL;
+}
+
+/**
+ * Exchange a full magazine for an empty one from depot. If depot already
+ * holds SLAB_DEPOT_MAX_MAGS full magazines, the given one is drained to the
+ * slabs and reused instead.
+ *
+ * Return empty magazine or NULL on error.
+ */
+static slab_magazine_t *__slab_depot_get_empty(slab_cache_t *slab_cache,
+											slab_magazine_t *full)
+{
+	kdlist_node_t *it = NULL;
+	slab_depot_t *depot = &slab_cache->depot;
+
+	pthread_mutex_lock(&depot->lock);
+
+	if (depot->full_mags < SLAB_DEPOT_MAX_MAGS) {
+		kdlist_push_tail(&depot->full_mags_head, &full->node);
+		depot->full_mags++;
+
+		it = kdlist_pop_head(&depot->empty_mags_head);
+		full = NULL;
+	}
+
+	pthread_mutex_unlock(&depot->lock);
+
+	// depot is full, give the objects back to the slabs
+	if (full) {
+		__slab_mag_drain(slab_cache, full);
+		return full;
+	}
+
+	if (it)
+		return kdlist_entry(it, slab_magazine_t, node);
+
+	return calloc(1, sizeof(slab_magazine_t));
+}
+
+/**
+ * Give the objects of all depot full magazines back to the slabs.
+ */
+static void __slab_depot_drain(slab_cache_t *slab_cache)
+{
+	slab_magazine_t *mag;
+	kdlist_node_t *it, *aux;
+	slab_depot_t *depot = &slab_cache->depot;
+
+	pthread_mutex_lock(&depot->lock);
+
+	kdlist_for_each_safe(it, aux, &depot->full_mags_head) {
+		mag = kdlist_entry(it, slab_magazine_t, node);
+
+		__slab_mag_drain(slab_cache, mag);
+
+		kdlist_delete(it);
+		kdlist_push_tail(&depot->empty_mags_head, it);
+	}
+
+	depot->full_mags = 0;
+
+	pthread_mutex_unlock(&depot->lock);
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Give thread magazines back to depot (thread exit or cache destroyed).
+ */
+static void __slab_tcache_destroy(slab_tcache_t *tcache)
+{
+	slab_magazine_t *mags[2];
+	slab_depot_t *depot = &tcache->slab_cache->depot;
+
+	//
+	mags[0] = tcache->loaded;
+	mags[1] = tcache->previous;
+
+	pthread_mutex_lock(&depot->lock);
+
+	for (int i = 0; i < ARRAY_SIZE(mags); i++) {
+		if (mags[i]->rounds) {
+			kdlist_push_tail(&depot->full_mags_head, &mags[i]->node);
+			depot->full_mags++;
+		} else {
+			kdlist_push_tail(&depot->empty_mags_head, &mags[i]->node);
+		}
+	}
+
+	kdlist_delete(&tcache->node);
+
+	pthread_mutex_unlock(&depot->lock);
+
+	free(tcache);
+}
+
+/**
+ * Give thread magazines of all alive caches back to their depot (thread exit).
+ */
+static void __slab_tcache_table_destroy(void *arg)
+{
+	slab_cache_t *slab_cache;
+	slab_tcache_table_t *table = arg;
+
+	// caches are not destroyed meanwhile
+	pthread_mutex_lock(&__slab_caches_lock);
+
+	for (size_t i = 0; i < table->size && i < __slab_cache_ids; i++) {
+		slab_cache = atomic_load_explicit(&__slab_cache_tab[i],
+										memory_order_relaxed);
+
+		if (table->ent[i].tcache && slab_cache &&
+			table->ent[i].gen == slab_cache->gen)
+			__slab_tcache_destroy(table->ent[i].tcache);
+	}
+
+	pthread_mutex_unlock(&__slab_caches_lock);
+
+	free(table);
+}
+
+static void __slab_tcache_key_init(void)
+{
+	__slab_tcache_key_err = pthread_key_create(&__slab_tcache_key,
+											__slab_tcache_table_destroy);
+}
+
+/**
+ * Register a new cache under a free id (under caches lock).
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+static int __slab_cache_id_get(slab_cache_t *slab_cache)
+{
+	size_t id;
+
+	//
+	for (id = 0; id < __slab_cache_ids; id++) {
+		if (!atomic_load_explicit(&__slab_cache_tab[id], memory_order_relaxed))
+			goto finish;
+	}
+
+	if (id == SLAB_MAX_CACHES)
+		return -1;
+
+	__slab_cache_ids++;
+
+finish:
+	slab_cache->id = id;
+	slab_cache->gen = ++__slab_cache_gen;
+
+	// cache is initialized before it is seen by slab_cache_of
+	atomic_store_explicit(&__slab_cache_tab[id], slab_cache,
+						memory_order_release);
+
+	return 0;
+}
+
+static void __slab_cache_id_put(slab_cache_t *slab_cache)
+{
+	atomic_store_explicit(&__slab_cache_tab[slab_cache->id], NULL,
+						memory_order_relaxed);
+}
+
+/**
+ * Get magazines of current thread (created on first use).
+ */
+static inline slab_tcache_t *__slab_tcache(slab_cache_t *slab_cache)
+{
+	size_t size, old_size;
+	slab_tcache_t *tcache;
+	slab_tcache_table_t *table;
+	slab_depot_t *depot = &slab_cache->depot;
+
+	//
+	table = pthread_getspecific(__slab_tcache_key);
+	if (table && slab_cache->id < table->size &&
+		table->ent[slab_cache->id].gen == slab_cache->gen)
+		return table->ent[slab_cache->id].tcache;
+
+	/******************************************************
+	 * Grow thread table up to cache id (entries of
+	 * destroyed caches are stale, their gen is old)
+	 ******************************************************/
+	old_size = size = table ? table->size : 0;
+
+	if (slab_cache->id >= size) {
+		while (slab_cache->id >= size)
+			size = size ? 2 * size : SLAB_TCACHE_TABLE_MIN;
+
+		table = realloc(table, sizeof(slab_tcache_table_t) +
+						size * sizeof(table->ent[0]));
+		if (!table)
+			goto error;
+
+		memset(&table->ent[old_size], 0,
+			(size - old_size) * sizeof(table->ent[0]));
+		table->size = size;
+
+		// only fails on the first table (no key storage yet)
+		if (pthread_setspecific(__slab_tcache_key, table)) {
+			free(table);
+			goto error;
+		}
+	}
+
+	//
+	tcache = calloc(1, sizeof(slab_tcache_t));
+	if (!tcache)
+		goto error;
+
+	tcache->loaded = calloc(1, sizeof(slab_magazine_t));
+	if (!tcache->loaded)
+		goto free_tcache;
+
+	tcache->previous = calloc(1, sizeof(slab_magazine_t));
+	if (!tcache->previous)
+		goto free_loaded;
+
+	tcache->slab_cache = slab_cache;
+
+	table->ent[slab_cache->id].tcache = tcache;
+	table->ent[slab_cache->id].gen = slab_cache->gen;
+
+	//
+	pthread_mutex_lock(&depot->lock);
+	kdlist_push_tail(&depot->tcaches_head, &tcache->node);
+	pthread_mutex_unlock(&depot->lock);
+
+	return tcache;
+
+free_loaded:
+	free(tcache->loaded);
+free_tcache:
+	free(tcache);
+error:
+	SLAB_ERR("Unable to create thread magazines!\n");
+	return NULL;
+}
+
+
+/**
+ * Objects fitting in a slab, after a header with their bitmap.
+ *
+ * @slab_size		: Slab size.
+ * @obj_size_align	: Aligned object size.
+ * @align			: Objects alignment.
+ * @mem_offset		: Objects start in slab (output).
+ *
+ * Return number of objects (0 if none fits).
+ */
+static size_t __slab_objs(size_t slab_size, size_t obj_size_align,
+						size_t align, size_t *mem_offset)
+{
+	size_t objs, offset;
+
+	//
+	objs = (slab_size - sizeof(slab_t)) / obj_size_align;
+
+	for (; objs; objs--) {
+		offset = sizeof(slab_t) +
+			((objs + BITS_OF(uint64_t) - 1) / BITS_OF(uint64_t)) *
+			sizeof(uint64_t);
+		offset = ALIGN(offset, align);
+
+		if (offset + objs * obj_size_align <= slab_size) {
+			*mem_offset = offset;
+			break;
+		}
+	}
+
+	return objs;
+}
+
+/**
+ * Select slab order of a cache: the smallest order wasting at most
+ * 1/SLAB_WASTE_RATIO of the slab, otherwise the order wasting the least.
+ *
+ * Return 0 on success and <0 if object does not fit in any slab.
+ */
+static int __slab_cache_order(slab_cache_t *slab_cache)
+{
+	int best = -1;
+	size_t slab_size, objs, offset, waste, best_waste = 0, best_size = 1;
+
+	//
+	for (int order = 0; order <= SLAB_MAX_ORDER; order++) {
+		slab_size = SLAB_MIN_BLK_SIZE << order;
+
+		objs = __slab_objs(slab_size, slab_cache->obj_size_align,
+							slab_cache->align, &offset);
+		if (!objs)
+			continue;
+
+		// compare waste ratios (waste / slab_size)
+		waste = slab_size - objs * slab_cache->obj_size_align;
+		if (best < 0 || waste * best_size < best_waste * slab_size) {
+			best = order;
+			best_waste = waste;
+			best_size = slab_size;
+		}
+
+		if (waste * SLAB_WASTE_RATIO <= slab_size)
+			break;
+	}
+
+	if (best < 0)
+		return -1;
+
+	//
+	slab_cache->slab_order	= best;
+	slab_cache->slab_size	= SLAB_MIN_BLK_SIZE << best;
+	slab_cache->obj_per_slab	= __slab_objs(slab_cache->slab_size,
+									slab_cache->obj_size_align,
+									slab_cache->align,
+									&slab_cache->mem_offset);
+	slab_cache->bitmap_size	=
+		(slab_cache->obj_per_slab + BITS_OF(uint64_t) - 1) / BITS_OF(uint64_t);
+
+	return 0;
+}
+
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+
+/**
+ * Initialize slab cache (objects aligned to cache line).
+ *
+ * @obj_size	: Slab cache object size.
+ * @obj_name	: Slab object name.
+ *
+ * Return slab cache on success or NULL otherwise.
+ */
+slab_cache_t * slab_cache_create(size_t obj_size, char *obj_name)
+{
+	return slab_cache_create_flags(obj_size, obj_name, SLAB_HWCACHE_ALIGN);
+}
+
+/**
+ * Initialize slab cache.
+ *
+ * @obj_size	: Slab cache object size.
+ * @obj_name	: Slab object name.
+ * @flags		: SLAB_ALIGN_8, SLAB_ALIGN_16 or SLAB_HWCACHE_ALIGN (default),
+ *				  with SLAB_RED_ZONE, SLAB_POISON, SLAB_CONSISTENCY_CHECKS
+ *				  or SLAB_DEBUG.
+ *
+ * Return slab cache on success or NULL otherwise.
+ */
+slab_cache_t * slab_cache_create_flags(size_t obj_size, char *obj_name,
+										uint32_t flags)
+{
+	return slab_cache_create_node(obj_size, obj_name, flags, SLAB_NODE_ANY);
+}
+
+/**
+ * Initialize slab cache with slabs allocated on a NUMA node.
+ *
+ * @obj_size	: Slab cache object size.
+ * @obj_name	: Slab object name.
+ * @flags		: Same as slab_cache_create_flags, SLAB_HUGEPAGE is implied
+ *				  when a node is given.
+ * @node		: NUMA node or SLAB_NODE_ANY.
+ *
+ * Return slab cache on success or NULL otherwise.
+ */
+slab_cache_t * slab_cache_create_node(size_t obj_size, char *obj_name,
+										uint32_t flags, int node)
+{
+	slab_cache_t *slab_cache = NULL;
+
+	//
+	if ((obj_size > SLAB_OBJ_MAX_SIZE) || (obj_size < SLAB_OBJ_MIN_SIZE)) {
+		SLAB_ERR("Invalid object size!\n");
+		goto finish;
+	}
+
+	if (flags & ~SLAB_FLAGS_MASK) {
+		SLAB_ERR("Invalid flags!\n");
+		goto finish;
+	}
+
+	if (!obj_name || strlen(obj_name) >= SLAB_OBJ_MAX_NAME) {
+		SLAB_ERR("Invalid object name!\n");
+		goto finish;
+	}
+
+	if (node < SLAB_NODE_ANY || node >= SLAB_MAX_NODES) {
+		SLAB_ERR("Invalid node %d!\n", node);
+		goto finish;
+	}
+
+	// node slabs come from the node arena
+	if (node != SLAB_NODE_ANY)
+		flags |= SLAB_HUGEPAGE;
+
+	// per cpu slabs are cache line aligned
+	if (posix_memalign((void **)&slab_cache, SLAB_CACHE_LINE_SIZE,
+						sizeof(slab_cache_t))) {
+		SLAB_ERR("Unable to create slab_cache!\n");
+		slab_cache = NULL;
+		goto finish;
+	}
+
+	// thread magazines are returned to depot on thread exit
+	pthread_once(&__slab_tcache_once, __slab_tcache_key_init);
+	if (__slab_tcache_key_err) {
+		SLAB_ERR("Unable to create slab thread key!\n");
+		free(slab_cache);
+		slab_cache = NULL;
+		goto finish;
 	}
 
+	// largest alignment given
+	if (flags & SLAB_HWCACHE_ALIGN || !(flags & SLAB_ALIGN_MASK))
+		slab_cache->align = SLAB_CACHE_LINE_SIZE;
+	else if (flags & SLAB_ALIGN_16)
+		slab_cache->align = 16;
+	else
+		slab_cache->align = 8;
+
 	//
-	obj = __slab_alloc(slab, obj_size, obj_size_align, _full, _bits);
-	if (!obj) {
-		SLAB_ERR("Unable to allocate new object!\n");
+	slab_cache->flags			= flags;
+	slab_cache->obj_size 		= obj_size;
+	if (flags & SLAB_RED_ZONE)
+		obj_size = __slab_red_zone_end(obj_size);
+	slab_cache->obj_size_align	= ALIGN(obj_size, slab_cache->align);
+
+	// slab size
+	if (__slab_cache_order(slab_cache)) {
+		SLAB_ERR("Object does not fit in a slab!\n");
+		free(slab_cache);
+		slab_cache = NULL;
 		goto finish;
 	}
 
-	if (__slab_is_full(slab, obj_per_slab))
-		kdlist_push_tail(full_slabs, &slab->node);
-	else
-		kdlist_push_tail(partial_slabs, &slab->node);
+	//
+	memset(slab_cache->obj_name, 0, SLAB_OBJ_MAX_NAME);
+	memcpy(slab_cache->obj_name, obj_name, strlen(obj_name));
+
+	//
+	pthread_mutex_init(&slab_cache->depot.lock, NULL);
+	kdlist_head_init(&slab_cache->depot.full_mags_head);
+	kdlist_head_init(&slab_cache->depot.empty_mags_head);
+	kdlist_head_init(&slab_cache->depot.tcaches_head);
+	slab_cache->depot.full_mags = 0;
+
+	//
+	for (int i = 0; i < MAX_CPUS; i++) {
+		pthread_mutex_init(&slab_cache->_cpu[i].lock, NULL);
+		kdlist_head_init(&slab_cache->_cpu[i].full_slabs_head);
+		kdlist_head_init(&slab_cache->_cpu[i].partial_slabs_head);
+		kdlist_head_init(&slab_cache->_cpu[i].free_slabs_head);
+		slab_cache->_cpu[i].free_slabs = 0;
+	}
+
+	atomic_init(&slab_cache->free_slabs_max, SLAB_FREE_SLABS_MAX);
+
+	// register cache (reclaim all) and get its arena
+	pthread_mutex_lock(&__slab_caches_lock);
+
+	slab_cache->nid = node;
+	slab_cache->arena = NULL;
+
+	if (__slab_cache_id_get(slab_cache)) {
+		pthread_mutex_unlock(&__slab_caches_lock);
+		SLAB_ERR("Unable to get slab_cache id!\n");
+		free(slab_cache);
+		slab_cache = NULL;
+		goto finish;
+	}
+
+	if (flags & SLAB_HUGEPAGE) {
+		slab_cache->arena = __slab_arena_get(node);
+		if (!slab_cache->arena) {
+			__slab_cache_id_put(slab_cache);
+			pthread_mutex_unlock(&__slab_caches_lock);
+			SLAB_ERR("Unable to create slabs arena of node %d!\n", node);
+			free(slab_cache);
+			slab_cache = NULL;
+			goto finish;
+		}
+	}
+
+	kdlist_push_tail(&__slab_caches, &slab_cache->node);
+	pthread_mutex_unlock(&__slab_caches_lock);
 
 finish:
-	return obj;
+	return slab_cache;
 }
 
 
 /**
- * Free object from slab cache.
+ * Destroy slab cache. No other thread may use the cache at this point.
  *
- * @slab_cache	: Slab cache to be used for free.
- * @ptr			: Object address to be free.
- * @cpu_id		: Core id.
+ * @slab_cache	: Slab cache to be destroyed.
  */
-void slab_cache_free(slab_cache_t *slab_cache, void *ptr, int cpu_id)
+void slab_cache_destroy(slab_cache_t *slab_cache)
 {
 	slab_t *slab;
-	bool full_slab;
-	kdlist_head_t *partial_slabs, *free_slabs;
-	size_t obj_size, obj_size_align, obj_per_slab;
+	slab_tcache_t *tcache;
+	slab_magazine_t *mag;
+	kdlist_node_t *it, *aux;
+	slab_depot_t *depot;
 
 	//
-	if (!slab_cache || !ptr)
+	if (!slab_cache)
 		goto finish;
 
+	// unregister cache, thread magazines of alive threads become stale
+	pthread_mutex_lock(&__slab_caches_lock);
+	kdlist_delete(&slab_cache->node);
+	__slab_cache_id_put(slab_cache);
+	pthread_mutex_unlock(&__slab_caches_lock);
+
 	//
-	obj_size		= slab_cache->obj_size;
-	obj_per_slab	= slab_cache->obj_per_slab;
-	obj_size_align	= slab_cache->obj_size_align;
+	depot = &slab_cache->depot;
+
+	kdlist_for_each_safe(it, aux, &depot->tcaches_head) {
+		tcache = kdlist_entry(it, slab_tcache_t, node);
+		free(tcache->loaded);
+		free(tcache->previous);
+		free(tcache);
+	}
+
+	kdlist_for_each_safe(it, aux, &depot->full_mags_head) {
+		mag = kdlist_entry(it, slab_magazine_t, node);
+		free(mag);
+	}
+
+	kdlist_for_each_safe(it, aux, &depot->empty_mags_head) {
+		mag = kdlist_entry(it, slab_magazine_t, node);
+		free(mag);
+	}
+
+	pthread_mutex_destroy(&depot->lock);
 
 	//
-	free_slabs		= &slab_cache->_cpu[cpu_id].free_slabs_head;
-	partial_slabs	= &slab_cache->_cpu[cpu_id].partial_slabs_head;
+	for (int i = 0; i < MAX_CPUS; i++) {
+		kdlist_for_each_safe(it, aux, &slab_cache->_cpu[i].full_slabs_head) {
+			slab = kdlist_entry(it, slab_t, node);
+			__slab_destroy(slab);
+		}
+
+		kdlist_for_each_safe(it, aux, &slab_cache->_cpu[i].partial_slabs_head) {
+			slab = kdlist_entry(it, slab_t, node);
+			__slab_destroy(slab);
+		}
+
+		kdlist_for_each_safe(it, aux, &slab_cache->_cpu[i].free_slabs_head) {
+			slab = kdlist_entry(it, slab_t, node);
+			__slab_destroy(slab);
+		}
+
+		pthread_mutex_destroy(&slab_cache->_cpu[i].lock);
+	}
+
+	// arena is destroyed with its last cache
+	if (slab_cache->arena) {
+		pthread_mutex_lock(&__slab_caches_lock);
+		__slab_arena_put(slab_cache->nid);
+		pthread_mutex_unlock(&__slab_caches_lock);
+	}
+
+	//
+	free(slab_cache);
+
+finish:
+	return;
+}
+
+/**
+ * Shrink slab cache. Full magazines of the depot are given back to the slabs
+ * first, then free slabs of the cpu are released.
+ *
+ * @slab_cache	: Slab cache to be destroyed.
+ * @cpu_id		: Core id.
+ */
+void slab_cache_shrink(slab_cache_t *slab_cache, int cpu_id)
+{
+	//
+	if (!slab_cache)
+		goto finish;
+
+	if (cpu_id != SLAB_CPU_ANY && (cpu_id < 0 || cpu_id >= MAX_CPUS))
+		goto finish;
+
+	//
+	__slab_depot_drain(slab_cache);
+	__slab_cpu_reclaim(slab_cache, __slab_cpu(cpu_id), 0);
+
+finish:
+	return;
+}
+
+/**
+ * Reclaim slab cache. Full magazines of the depot are given back to the slabs
+ * and free slabs of all cpus are released. Objects cached by threads
+ * magazines are not reclaimed.
+ *
+ * @slab_cache	: Slab cache to be reclaimed.
+ *
+ * Return number of bytes released.
+ */
+size_t slab_cache_reclaim(slab_cache_t *slab_cache)
+{
+	size_t slabs = 0;
+
+	//
+	if (!slab_cache)
+		return 0;
+
+	//
+	__slab_depot_drain(slab_cache);
+
+	for (int i = 0; i < MAX_CPUS; i++)
+		slabs += __slab_cpu_reclaim(slab_cache, i, 0);
+
+	return slabs * slab_cache->slab_size;
+}
+
+/**
+ * Set the free slabs watermark of a slab cache. A slab becoming free is
+ * released instead of being kept, once its cpu holds `free_slabs_max` free
+ * slabs. Extra free slabs are released right away.
+ *
+ * @slab_cache		: Slab cache.
+ * @free_slabs_max	: Free slabs kept per cpu.
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+int slab_cache_set_watermark(slab_cache_t *slab_cache, size_t free_slabs_max)
+{
+	//
+	if (!slab_cache)
+		return -1;
+
+	//
+	atomic_store_explicit(&slab_cache->free_slabs_max, free_slabs_max,
+						memory_order_relaxed);
+
+	for (int i = 0; i < MAX_CPUS; i++)
+		__slab_cpu_reclaim(slab_cache, i, free_slabs_max);
+
+	return 0;
+}
+
+/**
+ * Reclaim all slab caches (see slab_cache_reclaim).
+ *
+ * Return number of bytes released.
+ */
+size_t slab_reclaim_all(void)
+{
+	size_t bytes = 0;
+	kdlist_node_t *it;
+
+	pthread_mutex_lock(&__slab_caches_lock);
+
+	kdlist_for_each(it, &__slab_caches)
+		bytes += slab_cache_reclaim(kdlist_entry(it, slab_cache_t, node));
+
+	pthread_mutex_unlock(&__slab_caches_lock);
+
+	return bytes;
+}
+
+/**
+ * Memory pressure callback of a slabs arena (buddy_register_shrinker, done
+ * for every arena on creation). Reclaims the caches whose slabs come from
+ * the arena.
+ *
+ * @arg			: Arena (buddy_t) under pressure.
+ *
+ * Return number of bytes given back to the arena.
+ */
+size_t slab_shrinker(void *arg)
+{
+	buddy_t *arena = arg;
+	slab_cache_t *slab_cache;
+	kdlist_node_t *it;
+	size_t freed;
+	int idx = -1;
+
+	//
+	if (!arena)
+		return 0;
+
+	pthread_mutex_lock(&__slab_caches_lock);
+
+	for (int i = 0; i <= SLAB_MAX_NODES; i++) {
+		if (__slab_arenas[i] == arena)
+			idx = i;
+	}
+
+	// not a slabs arena, no slab comes from it
+	if (idx < 0) {
+		pthread_mutex_unlock(&__slab_caches_lock);
+		return 0;
+	}
 
 	/**
-	 * Compute slab address from the given pointer and validate it. It is
-	 * certain that each each slab is page aligned.
-	 *
-	 * After validation and mark object as free check if moving slab to partial
-	 * or free list is required.
+	 * Slabs freed to the arena meanwhile (here or by other threads) are
+	 * counted, a free slab of a cache may come from posix_memalign.
 	 */
-	slab = __addr_2_slab(ptr);
+	freed = atomic_load(&__slab_arenas_freed[idx]);
+
+	kdlist_for_each(it, &__slab_caches) {
+		slab_cache = kdlist_entry(it, slab_cache_t, node);
+
+		if (slab_cache->arena == arena)
+			slab_cache_reclaim(slab_cache);
+	}
+
+	freed = atomic_load(&__slab_arenas_freed[idx]) - freed;
+
+	pthread_mutex_unlock(&__slab_caches_lock);
+
+	return freed;
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Allocate an object from the magazines of the calling thread.
+ */
+static inline void *__slab_cache_alloc(slab_cache_t *slab_cache, int cpu_id)
+{
+	slab_tcache_t *tcache;
+	slab_magazine_t *mag;
+	int cpu;
 
 	//
-	if (slab->magic != SLAB_MAGIC) {
-		SLAB_ERR("Invalid %p free address!\n", ptr);
-		assert(0);
+	tcache = __slab_tcache(slab_cache);
+	if (!tcache)
+		return NULL;
+
+	// fast path
+	if (tcache->loaded->rounds)
+		return tcache->loaded->objs[--tcache->loaded->rounds];
+
+	// previous magazine is full, swap
+	if (tcache->previous->rounds) {
+		mag = tcache->loaded;
+		tcache->loaded = tcache->previous;
+		tcache->previous = mag;
+
+		return tcache->loaded->objs[--tcache->loaded->rounds];
 	}
 
-#if DBG_ENABLE
-	assert(__slab_is_addr_in_range(slab, ptr));
-#endif
+	// both are empty, exchange one for a full magazine of depot
+	mag = __slab_depot_get_full(&slab_cache->depot, tcache->previous);
+	if (mag) {
+		tcache->previous = tcache->loaded;
+		tcache->loaded = mag;
 
-	full_slab = __slab_is_full(slab, obj_per_slab);
+		return tcache->loaded->objs[--tcache->loaded->rounds];
+	}
+
+	// depot is empty, refill from slabs of a valid cpu
+	cpu = __slab_cpu(cpu_id);
+	if (cpu < 0) {
+		SLAB_ERR("Invalid cpu id %d\n", cpu_id);
+		return NULL;
+	}
+
+	__slab_mag_fill(slab_cache, tcache->loaded, cpu);
+	if (!tcache->loaded->rounds)
+		return NULL;
+
+	return tcache->loaded->objs[--tcache->loaded->rounds];
+}
+
+/**
+ * Allocate slab cache object. Objects are taken from the magazines of the
+ * calling thread (no lock); the depot and the slabs are only visited once
+ * every SLAB_MAG_SIZE allocations.
+ *
+ * @slab_cache	: slab cache to be used for allocation.
+ * @cpu_id		: Core id used to refill magazines or SLAB_CPU_ANY.
+ *
+ * Return object address on success and NULL otherwise (no memory, or the
+ * magazines need a refill and cpu_id is out of range).
+ */
+void * slab_cache_alloc(slab_cache_t *slab_cache, int cpu_id)
+{
+	void *ptr;
 
 	//
-	__slab_free(slab, ptr, obj_size, obj_size_align);
+	if (!slab_cache)
+		return NULL;
 
 	//
-	if (full_slab) {
-		kdlist_delete(&slab->node);
-		if (__slab_is_free(slab))
-			kdlist_push_tail(free_slabs, &slab->node);
+	ptr = __slab_cache_alloc(slab_cache, cpu_id);
+
+	if (slab_cache->flags & SLAB_DEBUG && ptr)
+		__slab_debug_alloc(slab_cache, ptr, cpu_id);
+
+	return ptr;
+}
+
+
+/**
+ * Free object from slab cache. Objects are put into the magazines of the
+ * calling thread (no lock), whatever thread allocated them.
+ *
+ * @slab_cache	: Slab cache to be used for free.
+ * @ptr			: Object address to be free.
+ * @cpu_id		: Core id (objects always go back to the cpu owning the slab).
+ *				  An out of range cpu_id is rejected, the object is not freed.
+ */
+void slab_cache_free(slab_cache_t *slab_cache, void *ptr, int cpu_id)
+{
+	slab_tcache_t *tcache;
+	slab_magazine_t *mag;
+
+	//
+	if (!slab_cache || !ptr)
+		goto finish;
+
+	if (cpu_id != SLAB_CPU_ANY && (cpu_id < 0 || cpu_id >= MAX_CPUS)) {
+		SLAB_ERR("Invalid cpu id %d\n", cpu_id);
+		goto finish;
+	}
+
+	/**
+	 * Slab header is not touched here, objects are validated when they go
+	 * back to their slab (or right away by debug caches).
+	 */
+	if (slab_cache->flags & SLAB_DEBUG) {
+		__slab_debug_free(slab_cache, ptr);
+
+		// skip magazines, double free is caught by the slab bitmap
+		if (slab_cache->flags & SLAB_CONSISTENCY_CHECKS)
+			tcache = NULL;
 		else
-			kdlist_push_tail(partial_slabs, &slab->node);
+			tcache = __slab_tcache(slab_cache);
 	} else {
-		if (__slab_is_free(slab)) {
-			kdlist_delete(&slab->node);
-			kdlist_push_tail(free_slabs, &slab->node);
-		}
+		tcache = __slab_tcache(slab_cache);
+	}
+
+	//
+	if (!tcache) {
+		mag = &(slab_magazine_t){ .rounds = 1, .objs = { ptr } };
+		__slab_mag_drain(slab_cache, mag);
+		goto finish;
+	}
+
+	// fast path
+	if (tcache->loaded->rounds < SLAB_MAG_SIZE) {
+		tcache->loaded->objs[tcache->loaded->rounds++] = ptr;
+		goto finish;
+	}
+
+	// previous magazine is empty, swap
+	if (!tcache->previous->rounds) {
+		mag = tcache->loaded;
+		tcache->loaded = tcache->previous;
+		tcache->previous = mag;
+
+		tcache->loaded->objs[tcache->loaded->rounds++] = ptr;
+		goto finish;
+	}
+
+	// both are full, exchange one for an empty magazine of depot
+	mag = __slab_depot_get_empty(slab_cache, tcache->previous);
+	if (!mag) {
+		__slab_mag_drain(slab_cache, tcache->previous);
+		mag = tcache->previous;
 	}
+
+	tcache->previous = tcache->loaded;
+	tcache->loaded = mag;
+
+	tcache->loaded->objs[tcache->loaded->rounds++] = ptr;
+
 finish:
 	return;
 }
 
 
+/**
+ * Get the slab cache owning an object, from the header of its slab. Other
+ * addresses are only safe if memory is mapped down to their SLAB_MAX_BLK_SIZE
+ * boundary.
+ *
+ * @ptr			: Object address.
+ *
+ * Return slab cache or NULL if no slab header is found.
+ */
+slab_cache_t *slab_cache_of(void *ptr)
+{
+	slab_t *slab;
+	slab_cache_t *slab_cache;
+
+	//
+	if (!ptr)
+		return NULL;
+
+	/**
+	 * Probe slab aligned addresses from the smallest slab size up. Lower
+	 * orders fall inside the slab of the object, so are always mapped, but
+	 * hold object bytes: the owner is taken from the registry (by id), never
+	 * from the probed header, and must have the probed slab order.
+	 */
+	for (int order = 0; order <= SLAB_MAX_ORDER; order++) {
+		slab = __addr_2_slab(ptr, SLAB_MIN_BLK_SIZE << order);
+
+		if (slab->magic != SLAB_MAGIC || slab->order != order ||
+			slab->cache_id >= SLAB_MAX_CACHES)
+			continue;
+
+		slab_cache = atomic_load_explicit(&__slab_cache_tab[slab->cache_id],
+										memory_order_acquire);
+
+		if (slab_cache && slab_cache == slab->slab_cache &&
+			slab_cache->slab_order == order)
+			return slab_cache;
+	}
+
+	return NULL;
+}
+
+
 /*****************************************************************************/
 
 /**
@@ -576,25 +1663,42 @@ void slab_cache_dump(slab_cache_t *slab_cache)
 	printf("object name       : %s\n", slab_cache->obj_name);
 	printf("object size       : %lu\n", slab_cache->obj_size);
 	printf("objects per slab  : %lu\n", slab_cache->obj_per_slab);
+	printf("object alignment  : %lu\n", slab_cache->align);
+	printf("debug flags       : %s%s%s\n",
+			slab_cache->flags & SLAB_RED_ZONE ? "red_zone " : "",
+			slab_cache->flags & SLAB_POISON ? "poison " : "",
+			slab_cache->flags & SLAB_CONSISTENCY_CHECKS ? "checks" : "");
+	printf("slab size         : %lu (order %lu)\n", slab_cache->slab_size,
+			slab_cache->slab_order);
+	printf("slab memory       : %s (node %d)\n",
+			slab_cache->arena ? "huge pages arena" : "heap", slab_cache->nid);
+
+	pthread_mutex_lock(&slab_cache->depot.lock);
+	printf("depot full mags   : %lu\n", slab_cache->depot.full_mags);
+	pthread_mutex_unlock(&slab_cache->depot.lock);
 
 	for (int i = 0; i < MAX_CPUS; i++) {
+		pthread_mutex_lock(&slab_cache->_cpu[i].lock);
+
 		printf("[cpu %d] full slabs:\n", i);
 		kdlist_for_each(it, &slab_cache->_cpu[i].full_slabs_head) {
 			slab = kdlist_entry(it, slab_t, node);
-			__slab_dump(slab, slab_cache->full_bytes, slab_cache->left_bits);
+			__slab_dump(slab, slab_cache->obj_per_slab);
 		}
 
 		printf("[cpu %d] partial slabs:\n", i);
 		kdlist_for_each(it, &slab_cache->_cpu[i].partial_slabs_head) {
 			slab = kdlist_entry(it, slab_t, node);
-			__slab_dump(slab, slab_cache->full_bytes, slab_cache->left_bits);
+			__slab_dump(slab, slab_cache->obj_per_slab);
 		}
 
 		printf("[cpu %d] free slabs:\n", i);
 		kdlist_for_each(it, &slab_cache->_cpu[i].free_slabs_head) {
 			slab = kdlist_entry(it, slab_t, node);
-			__slab_dump(slab, slab_cache->full_bytes, slab_cache->left_bits);
+			__slab_dump(slab, slab_cache->obj_per_slab);
 		}
+
+		pthread_mutex_unlock(&slab_cache->_cpu[i].lock);
 	}
 
 	printf("=========================================\n");
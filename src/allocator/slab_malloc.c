@@ -0,0 +1,202 @@
+/**
+ * General purpose allocator (size classes) on top of slab caches.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "allocator/slab_malloc.h"
+
+
+/*****************************************************************************/
+
+static slab_malloc_t __slab_malloc;
+static bool __slab_malloc_ready;
+
+
+/*****************************************************************************/
+
+/**
+ * Size class index of a size (SLAB_MALLOC_MIN_SIZE < size).
+ *
+ * For 2^(order-1) < size <= 2^order, the size fits either the 1.5x class
+ * 3 * 2^(order-2) or the power of two class 2^order:
+ *
+ *   idx : 0  1   2   3   4   5   6   7   ...  16    17
+ *   size: 8  12  16  24  32  48  64  96  ...  2048  3072
+ */
+static inline int __slab_malloc_class(size_t size)
+{
+	int order;
+
+	//
+	if (size <= SLAB_MALLOC_MIN_SIZE)
+		return 0;
+
+	order = 64 - __builtin_clzll(size - 1);
+
+	if (size <= (3ULL << (order - 2)))
+		return 2 * (order - 3) - 1;
+
+	return 2 * (order - 3);
+}
+
+static inline size_t __slab_malloc_class_2_size(int idx)
+{
+	if (idx & 1)
+		return 3ULL << ((idx + 1) / 2 + 1);
+
+	return 1ULL << (idx / 2 + 3);
+}
+
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+
+/**
+ * Create a slab cache for each size class.
+ *
+ * @buddy	: Allocator used for sizes above SLAB_MALLOC_MAX_SIZE (may be NULL).
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+int slab_malloc_init(buddy_t *buddy)
+{
+	char name[SLAB_OBJ_MAX_NAME];
+
+	//
+	if (__slab_malloc_ready) {
+		SLAB_ERR("Size classes already initialized!\n");
+		return -1;
+	}
+
+	//
+	for (int i = 0; i < SLAB_MALLOC_CLASSES; i++) {
+		snprintf(name, sizeof(name), "slab-malloc-%zu",
+				__slab_malloc_class_2_size(i));
+
+		// malloc alignment (no cache line padding for small classes)
+		__slab_malloc.caches[i] =
+			slab_cache_create_flags(__slab_malloc_class_2_size(i), name,
+				__slab_malloc_class_2_size(i) < 16 ? SLAB_ALIGN_8 :
+													SLAB_ALIGN_16);
+		if (!__slab_malloc.caches[i])
+			goto error;
+	}
+
+	//
+	__slab_malloc.buddy = buddy;
+
+	__slab_malloc_ready = true;
+
+	return 0;
+
+error:
+	for (int i = 0; i < SLAB_MALLOC_CLASSES; i++) {
+		slab_cache_destroy(__slab_malloc.caches[i]);
+		__slab_malloc.caches[i] = NULL;
+	}
+
+	return -1;
+}
+
+/**
+ * Destroy size class caches (buddy allocator is owned by the caller). All
+ * objects must be freed and no other thread may use the allocator.
+ */
+void slab_malloc_destroy(void)
+{
+	//
+	if (!__slab_malloc_ready)
+		return;
+
+	//
+	for (int i = 0; i < SLAB_MALLOC_CLASSES; i++) {
+		slab_cache_destroy(__slab_malloc.caches[i]);
+		__slab_malloc.caches[i] = NULL;
+	}
+
+	__slab_malloc.buddy = NULL;
+
+	__slab_malloc_ready = false;
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Allocate memory.
+ *
+ * @size	: Size in bytes.
+ *
+ * Return memory address on success and NULL otherwise.
+ */
+void *slab_malloc(size_t size)
+{
+	//
+	if (!size || !__slab_malloc_ready)
+		return NULL;
+
+	//
+	if (size <= SLAB_MALLOC_MAX_SIZE)
+		return slab_cache_alloc(__slab_malloc.caches[__slab_malloc_class(size)],
+								SLAB_CPU_ANY);
+
+	//
+	if (!__slab_malloc.buddy)
+		return NULL;
+
+	return buddy_alloc(__slab_malloc.buddy, size);
+}
+
+/**
+ * Free memory allocated by slab_malloc.
+ *
+ * @ptr		: Memory address.
+ */
+void slab_free(void *ptr)
+{
+	slab_cache_t *slab_cache;
+
+	//
+	if (!ptr || !__slab_malloc_ready)
+		return;
+
+	//
+	if (buddy_contains(__slab_malloc.buddy, ptr)) {
+		buddy_free(__slab_malloc.buddy, ptr);
+		return;
+	}
+
+	//
+	slab_cache = slab_cache_of(ptr);
+	if (!slab_cache) {
+		SLAB_ERR("Invalid %p free address!\n", ptr);
+		assert(0);
+	}
+
+	slab_cache_free(slab_cache, ptr, SLAB_CPU_ANY);
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Get the size class used for a given size.
+ *
+ * @size	: Size in bytes.
+ *
+ * Return size class or 0 if size is not served by a slab cache.
+ */
+size_t slab_malloc_class_size(size_t size)
+{
+	if (!size || size > SLAB_MALLOC_MAX_SIZE)
+		return 0;
+
+	return __slab_malloc_class_2_size(__slab_malloc_class(size));
+}
@@ -0,0 +1,263 @@
+/**
+ * Concurrent (sharded) hash table implementation.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "htable/chtable.h"
+
+
+/******************************************************************************/
+
+/**
+ * CHTABLE
+ *
+ *  hash(key) * GOLDEN >> shards_shift
+ *               |
+ *               v
+ *  | shard 0 | shard 1 | shard 2 | ... | shard N-1 |   (cache line aligned)
+ *  | drwlock | drwlock | drwlock |     | drwlock   |
+ *  | htable  | htable  | htable  |     | htable    |
+ *
+ */
+
+/******************************************************************************/
+
+#define GOLDEN_RATIO_32				0x9E3779B9U
+
+
+/******************************************************************************/
+
+static inline chtable_shard_t *__chtable_shard(chtable_t *chtable, void *key)
+{
+	uint32_t hash = chtable->__hash(key) * GOLDEN_RATIO_32;
+
+	// shards_shift is 32 for a single shard
+	return &chtable->shards[(uint64_t)hash >> chtable->shards_shift];
+}
+
+
+/******************************** PUBLIC API **********************************/
+
+/**
+ * Create a concurrent hash table.
+ *
+ * @shards_no	: Number of shards (rounded up to a power of 2).
+ * @type		: Shards storage mode.
+ * @capacity	: Initial capacity (split among shards).
+ * @hash		: Hash function.
+ *
+ * Return new allocated hash table on success and NULL otherwise.
+ */
+chtable_t *chtable_create(uint32_t shards_no, htable_type_e type,
+						uint32_t capacity, hash_cb hash, cmp_cb cmp,
+						alloc_key_cb alloc_key, free_key_cb free_key,
+						alloc_value_cb alloc_value, free_value_cb free_value)
+{
+	uint32_t i;
+	chtable_t *chtable;
+	chtable_shard_t *shard;
+
+	//
+	if (!hash || !shards_no || shards_no > CHTABLE_MAX_SHARDS)
+		goto error;
+
+	if (!IS_POWER_2(shards_no))
+		shards_no = 1U << (32 - __builtin_clz(shards_no));
+
+	//
+	chtable = malloc(sizeof(chtable_t));
+	if (!chtable)
+		goto error;
+
+	// ensure CACHE_LINE_SIZE align to prevent false sharing
+	if (posix_memalign((void **)&chtable->shards, CACHE_LINE_SIZE,
+						shards_no * sizeof(chtable_shard_t)))
+		goto free_chtable;
+
+	//
+	for (i = 0; i < shards_no; i++) {
+		shard = &chtable->shards[i];
+
+		shard->lock = drwlock_create();
+		if (!shard->lock)
+			goto free_shards;
+
+		shard->htable = htable_create_type(type, capacity / shards_no, hash,
+										cmp, alloc_key, free_key,
+										alloc_value, free_value);
+		if (!shard->htable) {
+			drwlock_destroy(shard->lock);
+			goto free_shards;
+		}
+	}
+
+	//
+	chtable->shards_no = shards_no;
+	chtable->shards_shift = 32 - __builtin_ctz(shards_no);
+	chtable->__hash = hash;
+
+	return chtable;
+
+free_shards:
+	while (i--) {
+		htable_destroy(chtable->shards[i].htable);
+		drwlock_destroy(chtable->shards[i].lock);
+	}
+
+	free(chtable->shards);
+free_chtable:
+	free(chtable);
+error:
+	return NULL;
+}
+
+/**
+ * Destroy (free) a concurrent hash table. No other thread may access the
+ * table at this point.
+ */
+void chtable_destroy(chtable_t *chtable)
+{
+	//
+	if (!chtable)
+		return;
+
+	for (uint32_t i = 0; i < chtable->shards_no; i++) {
+		htable_destroy(chtable->shards[i].htable);
+		drwlock_destroy(chtable->shards[i].lock);
+	}
+
+	//
+	free(chtable->shards);
+	free(chtable);
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Insert an entry into concurrent hash table.
+ *
+ * @chtable	: Concurrent hash table.
+ * @key		: Entry key.
+ * @value	: Entry value.
+ *
+ * Return 0 on success and <0 otherwise (see htable_insert).
+ */
+int chtable_insert(chtable_t *chtable, void *key, void *value)
+{
+	int rv;
+	chtable_shard_t *shard;
+
+	// validate input
+	if (!chtable || !key || !value)
+		return -1;
+
+	//
+	shard = __chtable_shard(chtable, key);
+
+	drwlock_write_lock(shard->lock);
+	rv = htable_insert(shard->htable, key, value);
+	drwlock_write_unlock(shard->lock);
+
+	return rv;
+}
+
+/**
+ * Delete an entry from concurrent hash table.
+ *
+ * @chtable	: Concurrent hash table.
+ * @key		: Entry key.
+ *
+ * Return 0 on success and <0 otherwise (see htable_delete).
+ */
+int chtable_delete(chtable_t *chtable, void *key)
+{
+	int rv;
+	chtable_shard_t *shard;
+
+	// validate input
+	if (!chtable || !key)
+		return -1;
+
+	//
+	shard = __chtable_shard(chtable, key);
+
+	drwlock_write_lock(shard->lock);
+	rv = htable_delete(shard->htable, key);
+	drwlock_write_unlock(shard->lock);
+
+	return rv;
+}
+
+/**
+ * Lookup an entry in concurrent hash table.
+ *
+ * @chtable	: Concurrent hash table.
+ * @key		: Entry key.
+ * @fn		: Callback invoked (under shard read lock) if entry is found.
+ * @arg		: Callback argument.
+ *
+ * Return 0 on success and <0 otherwise (see htable_lookup).
+ */
+int chtable_lookup(chtable_t *chtable, void *key, chtable_read_cb fn,
+				void *arg)
+{
+	int rv;
+	void *value;
+	chtable_shard_t *shard;
+
+	// validate input
+	if (!chtable || !key)
+		return -1;
+
+	//
+	shard = __chtable_shard(chtable, key);
+
+	drwlock_read_lock(shard->lock);
+
+	rv = htable_lookup(shard->htable, key, &value);
+	if (!rv && fn)
+		fn(key, value, arg);
+
+	drwlock_read_unlock(shard->lock);
+
+	return rv;
+}
+
+/**
+ * Check if a key is in concurrent hash table.
+ */
+bool chtable_contains(chtable_t *chtable, void *key)
+{
+	return chtable_lookup(chtable, key, NULL, NULL) == 0;
+}
+
+/**
+ * Number of entries in concurrent hash table. Shards are visited one by one,
+ * so the result is only a snapshot when updates are in progress.
+ */
+uint64_t chtable_size(chtable_t *chtable)
+{
+	uint64_t size = 0;
+	chtable_shard_t *shard;
+
+	//
+	if (!chtable)
+		return 0;
+
+	for (uint32_t i = 0; i < chtable->shards_no; i++) {
+		shard = &chtable->shards[i];
+
+		drwlock_read_lock(shard->lock);
+		size += shard->htable->size;
+		drwlock_read_unlock(shard->lock);
+	}
+
+	return size;
+}
@@ -6,14 +6,20 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "utils.h"
 #include "htable/htable.h"
 
+#if defined(HTABLE_GROUP_AVX2) || defined(HTABLE_GROUP_SSE2)
+#include <immintrin.h>
+#endif
+
 
 /******************************************************************************/
 
 /**
- * HTABLE
+ * HTABLE (HTABLE_CHAINED)
  *
  * kdlist_head_t         htable_node_t
  *
@@ -28,106 +34,1079 @@
  *
  */
 
-/******************************************************************************/
+/**
+ * HTABLE (HTABLE_OPEN)
+ *
+ *          group 0                   group 1
+ *  ctrl  |t|t|E|t|D|E|...|t|      |E|t|E|E|t|...|E|     ...
+ *  keys  |k|k| |k| | |...|k|      | |k| | |k|...| |     ...
+ *  values|v|v| |v| | |...|v|      | |v| | |v|...| |     ...
+ *
+ *  t: 7-bit tag of a used slot (high bit clear)
+ *  E: empty slot
+ *  D: deleted slot (tombstone)
+ *
+ * The mixed hash is split in H1 (low bits), selecting the first group to
+ * probe, and H2 (high 7 bits), the tag stored in the control byte. Groups are
+ * probed using triangular steps, which visits every group once for a power of
+ * 2 number of groups. A lookup stops at the first group having an empty slot.
+ *
+ * Keys (values) slots are key_stride (value_stride) bytes each. They hold a
+ * pointer to the allocated key (value) or, for inline entries, the key (value)
+ * itself.
+ */
+
+/**
+ * REHASH
+ *
+ *  tbl[0] |x|x|x|x|x|x|x|x|          tbl[0] is migrated unit by unit (bucket
+ *                 ^                  or group) starting from rehash_idx.
+ *             rehash_idx             Migrated open slots are marked deleted,
+ *                                    so probe sequences in tbl[0] stay valid.
+ *  tbl[1] |x| | |x| | | | | | |x| | | | | | |
+ *
+ * Once every unit is migrated, tbl[0] is released and replaced by tbl[1].
+ */
+
+/******************************************************************************/
+
+#define CTRL_EMPTY					0x80
+#define CTRL_DELETED				0xFE
+
+#define CTRL_IS_FULL(c)				(!((c) & 0x80))
+
+// max used slots (7/8 load factor)
+#define OPEN_MAX_LOAD(c)			((c) - ((c) >> 3))
+
+//
+#define HASH_H1(h)					(h)
+#define HASH_H2(h)					((uint8_t)((h) >> 57))
+
+//
+#define HTABLE_IS_REHASHING(h)		((h)->rehash_idx >= 0)
+
+//
+#define KEY_IS_INLINE(h)			((h)->key_size != 0)
+#define VALUE_IS_INLINE(h)			((h)->value_size != 0)
+
+// bytes copied into a slot (entry itself or pointer to it)
+#define KEY_COPY_SIZE(h)			(KEY_IS_INLINE(h) ? (h)->key_size : sizeof(void *))
+#define VALUE_COPY_SIZE(h)			(VALUE_IS_INLINE(h) ? (h)->value_size : sizeof(void *))
+
+// empty units visited per migrated unit while rehashing
+#define REHASH_EMPTY_VISITS			10
+
+
+/******************************************************************************/
+
+typedef struct htable_node_s {
+
+	void			*key;		// htable entry key
+	void			*value;		// htable entry value
+	kdlist_node_t	node;		// htable linked list node
+	//
+	uint8_t			data[];		// inline key and value
+
+} htable_node_t;
+
+
+#define NODE_VALUE_OFFSET(h)		ALIGN((h)->key_size, sizeof(void *))
+#define NODE_SIZE(h)				\
+			(sizeof(htable_node_t) + NODE_VALUE_OFFSET(h) + (h)->value_size)
+
+
+/**
+ * Alloc (free) memory for a node, from the node cache if any.
+ */
+static inline htable_node_t *__htable_node_alloc(htable_t *htable)
+{
+	if (htable->node_cache)
+		return slab_cache_alloc(htable->node_cache, htable->cpu_id);
+
+	return malloc(NODE_SIZE(htable));
+}
+
+static inline void __htable_node_free(htable_t *htable, htable_node_t *node)
+{
+	if (htable->node_cache)
+		slab_cache_free(htable->node_cache, node, htable->cpu_id);
+	else
+		free(node);
+}
+
+/**
+ * Alloc memory for a new node in hash table. Inline key and value are copied
+ * at the end of the node (single allocation).
+ */
+static htable_node_t *__htable_node_create(htable_t *htable, void *key,
+										void *value)
+{
+	htable_node_t *node;
+	uint32_t value_offset = NODE_VALUE_OFFSET(htable);
+
+	//
+	node = __htable_node_alloc(htable);
+	if (!node)
+		goto error;
+
+	//
+	if (KEY_IS_INLINE(htable)) {
+		node->key = memcpy(node->data, key, htable->key_size);
+	} else {
+		node->key = htable->__alloc_key(key);
+		if (!node->key)
+			goto free_node;
+	}
+
+	//
+	if (VALUE_IS_INLINE(htable)) {
+		node->value = memcpy(&node->data[value_offset], value,
+							htable->value_size);
+	} else {
+		node->value = htable->__alloc_value(value);
+		if (!node->value)
+			goto free_key;
+	}
+
+	return node;
+
+free_key:
+	if (!KEY_IS_INLINE(htable))
+		htable->__free_key(node->key);
+free_node:
+	__htable_node_free(htable, node);
+error:
+	return NULL;
+}
+
+/**
+ * Destroy memory for a node in hash table.
+ */
+static void __htable_node_destroy(htable_t *htable, htable_node_t *node)
+{
+	if (!node)
+		return;
+
+	//
+	if (!KEY_IS_INLINE(htable))
+		htable->__free_key(node->key);
+	if (!VALUE_IS_INLINE(htable))
+		htable->__free_value(node->value);
+
+	//
+	__htable_node_free(htable, node);
+}
+
+
+/******************************************************************************/
+
+/**
+ * Mix user hash (murmur3 finalizer) so that both the slot index and the tag
+ * are well distributed even for weak hash functions.
+ */
+static inline uint64_t __htable_hash_mix(uint32_t hash)
+{
+	uint64_t h = hash;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+static inline uint64_t __htable_hash(htable_t *htable, void *key)
+{
+	return __htable_hash_mix(htable->__hash(key));
+}
+
+/**
+ * Group helpers. Each helper returns a bitmask where bit i is set if the
+ * i-th control byte of the group matches. Groups are HTABLE_GROUP_WIDTH
+ * aligned.
+ */
+#if defined(HTABLE_GROUP_AVX2)
+
+static inline uint32_t __group_match(const uint8_t *ctrl, uint8_t tag)
+{
+	__m256i group = _mm256_load_si256((const __m256i *)ctrl);
+
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(tag), group));
+}
+
+static inline uint32_t __group_match_empty(const uint8_t *ctrl)
+{
+	return __group_match(ctrl, CTRL_EMPTY);
+}
+
+static inline uint32_t __group_match_free(const uint8_t *ctrl)
+{
+	// both empty and deleted control bytes have the high bit set
+	return _mm256_movemask_epi8(_mm256_load_si256((const __m256i *)ctrl));
+}
+
+#elif defined(HTABLE_GROUP_SSE2)
+
+static inline uint32_t __group_match(const uint8_t *ctrl, uint8_t tag)
+{
+	__m128i group = _mm_load_si128((const __m128i *)ctrl);
+
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), group));
+}
+
+static inline uint32_t __group_match_empty(const uint8_t *ctrl)
+{
+	return __group_match(ctrl, CTRL_EMPTY);
+}
+
+static inline uint32_t __group_match_free(const uint8_t *ctrl)
+{
+	// both empty and deleted control bytes have the high bit set
+	return _mm_movemask_epi8(_mm_load_si128((const __m128i *)ctrl));
+}
+
+#else	// HTABLE_GROUP_SCALAR
+
+#define SWAR_LSB					0x0101010101010101ULL
+#define SWAR_MSB					0x8080808080808080ULL
+#define SWAR_LOW7					0x7F7F7F7F7F7F7F7FULL
+
+/**
+ * Compress the high bit of each byte into an 8-bit mask.
+ */
+static inline uint32_t __swar_movemask(uint64_t x)
+{
+	return (((x >> 7) & SWAR_LSB) * 0x0102040810204080ULL) >> 56;
+}
+
+/**
+ * Set the high bit of each zero byte (exact, no false positives).
+ */
+static inline uint64_t __swar_zero_bytes(uint64_t x)
+{
+	return ~(((x & SWAR_LOW7) + SWAR_LOW7) | x | SWAR_LOW7);
+}
+
+static inline uint32_t __group_match(const uint8_t *ctrl, uint8_t tag)
+{
+	uint64_t lo, hi;
+
+	memcpy(&lo, ctrl, sizeof(uint64_t));
+	memcpy(&hi, ctrl + sizeof(uint64_t), sizeof(uint64_t));
+
+	return __swar_movemask(__swar_zero_bytes(lo ^ (SWAR_LSB * tag))) |
+		(__swar_movemask(__swar_zero_bytes(hi ^ (SWAR_LSB * tag))) << 8);
+}
+
+static inline uint32_t __group_match_empty(const uint8_t *ctrl)
+{
+	uint64_t lo, hi;
+
+	memcpy(&lo, ctrl, sizeof(uint64_t));
+	memcpy(&hi, ctrl + sizeof(uint64_t), sizeof(uint64_t));
+
+	// high bit set and bit 1 clear (empty: 0x80, deleted: 0xFE)
+	return __swar_movemask(lo & ~(lo << 6) & SWAR_MSB) |
+		(__swar_movemask(hi & ~(hi << 6) & SWAR_MSB) << 8);
+}
+
+static inline uint32_t __group_match_free(const uint8_t *ctrl)
+{
+	uint64_t lo, hi;
+
+	memcpy(&lo, ctrl, sizeof(uint64_t));
+	memcpy(&hi, ctrl + sizeof(uint64_t), sizeof(uint64_t));
+
+	// both empty and deleted control bytes have the high bit set
+	return __swar_movemask(lo & SWAR_MSB) |
+		(__swar_movemask(hi & SWAR_MSB) << 8);
+}
+
+#endif	// HTABLE_GROUP_*
+
+
+/******************************************************************************/
+
+/**
+ * Slot key (value) of a table (open addressing): the inline entry or the
+ * allocated one it points to.
+ */
+static inline void *__htable_slot_key(htable_t *htable, htable_tbl_t *tbl,
+									uint32_t slot)
+{
+	uint8_t *key = &tbl->keys[(size_t)slot * htable->key_stride];
+
+	return KEY_IS_INLINE(htable) ? key : *(void **)key;
+}
+
+static inline void *__htable_slot_value(htable_t *htable, htable_tbl_t *tbl,
+										uint32_t slot)
+{
+	uint8_t *value = &tbl->values[(size_t)slot * htable->value_stride];
+
+	return VALUE_IS_INLINE(htable) ? value : *(void **)value;
+}
+
+/**
+ * Lookup slot for a given key in a table (open addressing).
+ *
+ * Return slot index on success and <0 otherwise.
+ */
+static int64_t __htable_open_find(htable_t *htable, htable_tbl_t *tbl,
+								void *key, uint64_t hash)
+{
+	uint8_t tag, *ctrl;
+	uint32_t mask, slot, groups_mask, group;
+
+	//
+	tag = HASH_H2(hash);
+	groups_mask = (tbl->capacity / HTABLE_GROUP_WIDTH) - 1;
+	group = HASH_H1(hash) & groups_mask;
+
+	for (uint32_t step = 1; step <= groups_mask + 1; step++) {
+		ctrl = &tbl->ctrl[group * HTABLE_GROUP_WIDTH];
+
+		// compare keys only on tag match
+		mask = __group_match(ctrl, tag);
+		while (mask) {
+			slot = group * HTABLE_GROUP_WIDTH + __builtin_ctz(mask);
+			if (htable->__cmp(key, __htable_slot_key(htable, tbl, slot)) == 0)
+				return slot;
+
+			mask &= mask - 1;
+		}
+
+		// key would have been placed in this group
+		if (__group_match_empty(ctrl))
+			break;
+
+		group = (group + step) & groups_mask;
+	}
+
+	return -1;
+}
+
+/**
+ * Lookup first free (empty or deleted) slot for a given hash in a table (open
+ * addressing). Load factor ensures there is always a free slot.
+ *
+ * Return slot index.
+ */
+static uint32_t __htable_open_find_free(htable_tbl_t *tbl, uint64_t hash)
+{
+	uint32_t mask, groups_mask, group;
+
+	//
+	groups_mask = (tbl->capacity / HTABLE_GROUP_WIDTH) - 1;
+	group = HASH_H1(hash) & groups_mask;
+
+	for (uint32_t step = 1; ; step++) {
+		mask = __group_match_free(&tbl->ctrl[group * HTABLE_GROUP_WIDTH]);
+		if (mask)
+			break;
+
+		group = (group + step) & groups_mask;
+	}
+
+	return group * HTABLE_GROUP_WIDTH + __builtin_ctz(mask);
+}
+
+/**
+ * Fill a free slot (open addressing). Key (value) slot content is copied from
+ * @key (@value): the inline entry or the pointer to the allocated one.
+ */
+static void __htable_open_place(htable_t *htable, htable_tbl_t *tbl,
+								uint32_t slot, uint64_t hash, void *key,
+								void *value)
+{
+	if (tbl->ctrl[slot] == CTRL_EMPTY)
+		tbl->growth_left--;
+
+	tbl->ctrl[slot] = HASH_H2(hash);
+	memcpy(&tbl->keys[(size_t)slot * htable->key_stride], key,
+			KEY_COPY_SIZE(htable));
+	memcpy(&tbl->values[(size_t)slot * htable->value_stride], value,
+			VALUE_COPY_SIZE(htable));
+
+	tbl->size++;
+}
+
+/**
+ * Release a slot (open addressing). If the group has an empty slot no probe
+ * sequence continued past it, so the slot can be marked as empty. Otherwise,
+ * a tombstone is required to keep the probe sequences valid.
+ */
+static void __htable_open_release(htable_tbl_t *tbl, uint32_t slot)
+{
+	uint8_t *ctrl = &tbl->ctrl[slot & ~(HTABLE_GROUP_WIDTH - 1)];
+
+	if (__group_match_empty(ctrl)) {
+		tbl->ctrl[slot] = CTRL_EMPTY;
+		tbl->growth_left++;
+	} else {
+		tbl->ctrl[slot] = CTRL_DELETED;
+	}
+
+	tbl->size--;
+}
+
+
+/******************************************************************************/
+
+static int __htable_open_tbl_create(htable_t *htable, htable_tbl_t *tbl,
+								uint32_t capacity)
+{
+	//
+	if (posix_memalign((void **)&tbl->ctrl, HTABLE_GROUP_WIDTH, capacity))
+		goto error;
+
+	tbl->keys = malloc((size_t)capacity * htable->key_stride);
+	if (!tbl->keys)
+		goto free_ctrl;
+
+	tbl->values = malloc((size_t)capacity * htable->value_stride);
+	if (!tbl->values)
+		goto free_keys;
+
+	//
+	memset(tbl->ctrl, CTRL_EMPTY, capacity);
+	tbl->growth_left = OPEN_MAX_LOAD(capacity);
+
+	return 0;
+
+free_keys:
+	free(tbl->keys);
+free_ctrl:
+	free(tbl->ctrl);
+error:
+	return -1;
+}
+
+static void __htable_open_tbl_free(htable_tbl_t *tbl)
+{
+	free(tbl->values);
+	free(tbl->keys);
+	free(tbl->ctrl);
+}
+
+static void __htable_open_tbl_destroy(htable_t *htable, htable_tbl_t *tbl)
+{
+	for (uint32_t i = 0; i < tbl->capacity; i++) {
+		if (!CTRL_IS_FULL(tbl->ctrl[i]))
+			continue;
+
+		if (!KEY_IS_INLINE(htable))
+			htable->__free_key(__htable_slot_key(htable, tbl, i));
+		if (!VALUE_IS_INLINE(htable))
+			htable->__free_value(__htable_slot_value(htable, tbl, i));
+	}
+
+	//
+	__htable_open_tbl_free(tbl);
+}
+
+/**
+ * Migrate a group from old to new table (open addressing).
+ *
+ * Return number of migrated entries.
+ */
+static uint32_t __htable_open_migrate(htable_t *htable, uint32_t group)
+{
+	uint64_t hash;
+	uint32_t slot, moved = 0;
+	htable_tbl_t *old = &htable->tbl[0], *new = &htable->tbl[1];
+
+	for (uint32_t i = group * HTABLE_GROUP_WIDTH;
+		i < (group + 1) * HTABLE_GROUP_WIDTH; i++) {
+		if (!CTRL_IS_FULL(old->ctrl[i]))
+			continue;
+
+		//
+		hash = __htable_hash(htable, __htable_slot_key(htable, old, i));
+		slot = __htable_open_find_free(new, hash);
+		__htable_open_place(htable, new, slot, hash,
+							&old->keys[(size_t)i * htable->key_stride],
+							&old->values[(size_t)i * htable->value_stride]);
+
+		// keep old table probe sequences valid
+		old->ctrl[i] = CTRL_DELETED;
+		old->size--;
+
+		moved++;
+	}
+
+	return moved;
+}
+
+static int __htable_open_insert(htable_t *htable, void *key, void *value,
+								uint64_t hash)
+{
+	uint32_t slot;
+	void *_key = NULL, *_value = NULL;
+	htable_tbl_t *tbl;
+
+	//
+	tbl = &htable->tbl[HTABLE_IS_REHASHING(htable)];
+
+	// inline entries are copied as they are
+	if (!KEY_IS_INLINE(htable)) {
+		_key = htable->__alloc_key(key);
+		if (!_key)
+			return -4;
+
+		key = &_key;
+	}
+
+	if (!VALUE_IS_INLINE(htable)) {
+		_value = htable->__alloc_value(value);
+		if (!_value) {
+			if (_key)
+				htable->__free_key(_key);
+			return -4;
+		}
+
+		value = &_value;
+	}
+
+	//
+	slot = __htable_open_find_free(tbl, hash);
+	__htable_open_place(htable, tbl, slot, hash, key, value);
+
+	return 0;
+}
+
+static int __htable_open_delete(htable_t *htable, void *key, uint64_t hash)
+{
+	int64_t slot;
+	htable_tbl_t *tbl;
+
+	//
+	for (int i = HTABLE_IS_REHASHING(htable); i >= 0; i--) {
+		tbl = &htable->tbl[i];
+
+		slot = __htable_open_find(htable, tbl, key, hash);
+		if (slot < 0)
+			continue;
+
+		//
+		if (!KEY_IS_INLINE(htable))
+			htable->__free_key(__htable_slot_key(htable, tbl, slot));
+		if (!VALUE_IS_INLINE(htable))
+			htable->__free_value(__htable_slot_value(htable, tbl, slot));
+
+		__htable_open_release(tbl, slot);
+
+		return 0;
+	}
+
+	return -4;
+}
+
+static int __htable_open_lookup(htable_t *htable, void *key, uint64_t hash,
+								void **value)
+{
+	int64_t slot;
+	htable_tbl_t *tbl;
+
+	//
+	for (int i = HTABLE_IS_REHASHING(htable); i >= 0; i--) {
+		tbl = &htable->tbl[i];
+
+		slot = __htable_open_find(htable, tbl, key, hash);
+		if (slot < 0)
+			continue;
+
+		if (value)
+			*value = __htable_slot_value(htable, tbl, slot);
+
+		return 0;
+	}
+
+	return -3;
+}
+
+
+/******************************************************************************/
+
+/**
+ * Lookup node for a given key in a table (chained).
+ *
+ * Return node on success and NULL otherwise.
+ */
+static htable_node_t *__htable_chained_find(htable_t *htable, htable_tbl_t *tbl,
+											void *key, uint64_t hash)
+{
+	htable_node_t *node;
+	kdlist_node_t *it;
+
+	kdlist_for_each(it, &tbl->buckets[hash & (tbl->capacity - 1)]) {
+		node = container_of(it, htable_node_t, node);
+
+		if (htable->__cmp(key, node->key) == 0)
+			return node;
+	}
+
+	return NULL;
+}
+
+static int __htable_chained_tbl_create(htable_tbl_t *tbl, uint32_t capacity)
+{
+	//
+	tbl->buckets = malloc(capacity * sizeof(kdlist_head_t));
+	if (!tbl->buckets)
+		return -1;
+
+	for (uint32_t i = 0; i < capacity; i++)
+		kdlist_head_init(&tbl->buckets[i]);
+
+	return 0;
+}
+
+static void __htable_chained_tbl_free(htable_tbl_t *tbl)
+{
+	free(tbl->buckets);
+}
+
+static void __htable_chained_tbl_destroy(htable_t *htable, htable_tbl_t *tbl)
+{
+	htable_node_t *node;
+	kdlist_node_t *it, *aux;
+	kdlist_head_t *bucket_list;
+
+	for (uint32_t i = 0; i < tbl->capacity; i++) {
+		bucket_list = &tbl->buckets[i];
+
+		kdlist_for_each_safe(it, aux, bucket_list) {
+			node = container_of(it, htable_node_t, node);
+			__htable_node_destroy(htable, node);
+		}
+	}
+
+	//
+	__htable_chained_tbl_free(tbl);
+}
+
+/**
+ * Migrate a bucket from old to new table (chained).
+ *
+ * Return number of migrated entries.
+ */
+static uint32_t __htable_chained_migrate(htable_t *htable, uint32_t bucket)
+{
+	uint64_t hash;
+	uint32_t moved = 0;
+	htable_node_t *node;
+	kdlist_node_t *it, *aux;
+	htable_tbl_t *old = &htable->tbl[0], *new = &htable->tbl[1];
+
+	kdlist_for_each_safe(it, aux, &old->buckets[bucket]) {
+		node = container_of(it, htable_node_t, node);
+		hash = __htable_hash(htable, node->key);
+
+		//
+		kdlist_delete(it);
+		kdlist_push_tail(&new->buckets[hash & (new->capacity - 1)], it);
+
+		old->size--;
+		new->size++;
+
+		moved++;
+	}
+
+	// all nodes were moved
+	kdlist_head_init(&old->buckets[bucket]);
+
+	return moved;
+}
+
+static int __htable_chained_insert(htable_t *htable, void *key, void *value,
+								uint64_t hash)
+{
+	htable_node_t *node;
+	htable_tbl_t *tbl;
+
+	//
+	tbl = &htable->tbl[HTABLE_IS_REHASHING(htable)];
+
+	// create new node for bucket list
+	node = __htable_node_create(htable, key, value);
+	if (!node)
+		return -4;
+
+	// insert data to bucket (if collision, add at the end of the list)
+	kdlist_push_tail(&tbl->buckets[hash & (tbl->capacity - 1)], &node->node);
+	tbl->size++;
+
+	return 0;
+}
+
+static int __htable_chained_delete(htable_t *htable, void *key, uint64_t hash)
+{
+	htable_node_t *node;
+	htable_tbl_t *tbl;
+
+	//
+	for (int i = HTABLE_IS_REHASHING(htable); i >= 0; i--) {
+		tbl = &htable->tbl[i];
+
+		node = __htable_chained_find(htable, tbl, key, hash);
+		if (!node)
+			continue;
+
+		//
+		kdlist_delete(&node->node);
+		__htable_node_destroy(htable, node);
+		tbl->size--;
+
+		return 0;
+	}
+
+	return -4;
+}
+
+static int __htable_chained_lookup(htable_t *htable, void *key, uint64_t hash,
+								void **value)
+{
+	htable_node_t *node;
+
+	//
+	for (int i = HTABLE_IS_REHASHING(htable); i >= 0; i--) {
+		node = __htable_chained_find(htable, &htable->tbl[i], key, hash);
+		if (!node)
+			continue;
+
+		if (value)
+			*value = node->value;
+
+		return 0;
+	}
+
+	return -3;
+}
+
+
+/******************************************************************************/
+
+static int __htable_tbl_create(htable_t *htable, htable_tbl_t *tbl,
+							uint32_t capacity)
+{
+	int rv;
+
+	//
+	memset(tbl, 0, sizeof(htable_tbl_t));
+
+	//
+	if (htable->type == HTABLE_OPEN)
+		rv = __htable_open_tbl_create(htable, tbl, capacity);
+	else
+		rv = __htable_chained_tbl_create(tbl, capacity);
+
+	if (rv)
+		return rv;
+
+	tbl->capacity = capacity;
+
+	return 0;
+}
+
+static void __htable_tbl_free(htable_t *htable, htable_tbl_t *tbl)
+{
+	if (htable->type == HTABLE_OPEN)
+		__htable_open_tbl_free(tbl);
+	else
+		__htable_chained_tbl_free(tbl);
+}
+
+static void __htable_tbl_destroy(htable_t *htable, htable_tbl_t *tbl)
+{
+	if (htable->type == HTABLE_OPEN)
+		__htable_open_tbl_destroy(htable, tbl);
+	else
+		__htable_chained_tbl_destroy(htable, tbl);
+}
+
+static bool __htable_tbl_is_full(htable_t *htable, htable_tbl_t *tbl)
+{
+	if (htable->type == HTABLE_OPEN)
+		return tbl->growth_left == 0;
+
+	return tbl->size >= tbl->capacity;
+}
+
+
+/******************************************************************************/
+
+/**
+ * Migrate up to @units non-empty buckets (groups) from old to new table. Empty
+ * units visited are bounded as well, to keep the cost of a step constant.
+ * When the old table is fully migrated, it is replaced by the new one.
+ */
+static void __htable_rehash_step(htable_t *htable, uint32_t units)
+{
+	uint32_t units_max, moved, empty_visits;
+
+	//
+	if (!HTABLE_IS_REHASHING(htable))
+		return;
+
+	//
+	empty_visits = units * REHASH_EMPTY_VISITS;
+	units_max = htable->tbl[0].capacity;
+	if (htable->type == HTABLE_OPEN)
+		units_max /= HTABLE_GROUP_WIDTH;
+
+	//
+	while (units && htable->rehash_idx < units_max) {
+		if (htable->type == HTABLE_OPEN)
+			moved = __htable_open_migrate(htable, htable->rehash_idx);
+		else
+			moved = __htable_chained_migrate(htable, htable->rehash_idx);
+
+		htable->rehash_idx++;
+
+		if (moved)
+			units--;
+		else if (--empty_visits == 0)
+			break;
+	}
+
+	// not done yet
+	if (htable->rehash_idx < units_max)
+		return;
+
+	//
+	__htable_tbl_free(htable, &htable->tbl[0]);
+
+	htable->tbl[0] = htable->tbl[1];
+	memset(&htable->tbl[1], 0, sizeof(htable_tbl_t));
+	htable->rehash_idx = -1;
+}
+
+/**
+ * Ensure there is room for a new entry, starting a rehash if the table in use
+ * reached its load limit.
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+static int __htable_reserve(htable_t *htable)
+{
+	uint32_t capacity;
+	htable_tbl_t *tbl;
+
+	/**
+	 * New table reached its limit before the old one was fully migrated (only
+	 * possible for tiny tables); finish the migration now.
+	 */
+	if (HTABLE_IS_REHASHING(htable)) {
+		if (!__htable_tbl_is_full(htable, &htable->tbl[1]))
+			return 0;
+
+		while (HTABLE_IS_REHASHING(htable))
+			__htable_rehash_step(htable, HTABLE_REHASH_STEP);
+	}
+
+	//
+	tbl = &htable->tbl[0];
+	if (!__htable_tbl_is_full(htable, tbl))
+		return 0;
+
+	/**
+	 * Double the capacity. For open addressing, if less than half of the max
+	 * load is used, the table is mostly tombstones; rehash to same capacity.
+	 */
+	capacity = tbl->capacity;
+	if (htable->type != HTABLE_OPEN || tbl->size > OPEN_MAX_LOAD(capacity) / 2) {
+		if (capacity == HTABLE_MAX_CAPACITY)
+			return -1;
+
+		capacity <<= 1;
+	}
+
+	//
+	if (__htable_tbl_create(htable, &htable->tbl[1], capacity))
+		return -1;
+
+	htable->rehash_idx = 0;
+
+	return 0;
+}
+
+
+/******************************************************************************/
+
+/**
+ * Batch helpers. Keys are resolved in chunks of HTABLE_BATCH_CHUNK: all hashes
+ * of a chunk are computed first and the memory each key will touch is
+ * prefetched, so cache misses of different keys overlap instead of being paid
+ * one after another.
+ *
+ *   1. hash + prefetch bucket head / control group + keys	(all keys)
+ *   2. prefetch first entry (node / key of first tag match)	(all keys)
+ *   3. resolve											(all keys)
+ */
+static void __htable_prefetch_bucket(htable_t *htable, uint64_t hash)
+{
+	uint32_t slot;
+	htable_tbl_t *tbl;
+
+	for (int i = HTABLE_IS_REHASHING(htable); i >= 0; i--) {
+		tbl = &htable->tbl[i];
+
+		if (htable->type == HTABLE_CHAINED) {
+			__builtin_prefetch(&tbl->buckets[hash & (tbl->capacity - 1)]);
+			continue;
+		}
+
+		//
+		slot = (HASH_H1(hash) & ((tbl->capacity / HTABLE_GROUP_WIDTH) - 1)) *
+				HTABLE_GROUP_WIDTH;
+
+		__builtin_prefetch(&tbl->ctrl[slot]);
+		__builtin_prefetch(&tbl->keys[(size_t)slot * htable->key_stride]);
+	}
+}
+
+static void __htable_prefetch_entry(htable_t *htable, uint64_t hash)
+{
+	uint32_t mask, slot;
+	htable_tbl_t *tbl;
 
-typedef struct htable_node_s {
+	for (int i = HTABLE_IS_REHASHING(htable); i >= 0; i--) {
+		tbl = &htable->tbl[i];
 
-	void			*key;		// htable entry key
-	void			*value;		// htable entry value
-	kdlist_node_t	node;		// htable linked list node
+		if (htable->type == HTABLE_CHAINED) {
+			__builtin_prefetch(tbl->buckets[hash & (tbl->capacity - 1)].next);
+			continue;
+		}
 
-} htable_node_t;
+		// only the first tag match of the first group
+		slot = (HASH_H1(hash) & ((tbl->capacity / HTABLE_GROUP_WIDTH) - 1)) *
+				HTABLE_GROUP_WIDTH;
 
+		mask = __group_match(&tbl->ctrl[slot], HASH_H2(hash));
+		if (mask)
+			__builtin_prefetch(__htable_slot_key(htable, tbl,
+												slot + __builtin_ctz(mask)));
+	}
+}
 
-/**
- * Alloc memory for a new node in hash table.
- */
-static htable_node_t *__htable_node_create(void *key, void *value,
-										alloc_key_cb alloc_key,
-										free_key_cb free_key,
-										alloc_value_cb alloc_value)
+static void __htable_prefetch_batch(htable_t *htable, void **keys,
+									uint64_t *hashes, uint32_t n)
 {
-	htable_node_t *node;
+	for (uint32_t i = 0; i < n; i++) {
+		if (!keys[i])
+			continue;
 
-	//
-	node = malloc(sizeof(htable_node_t));
-	if (!node)
-		goto error;
+		hashes[i] = __htable_hash(htable, keys[i]);
+		__htable_prefetch_bucket(htable, hashes[i]);
+	}
 
-	//
-	node->key = alloc_key(key);
-	if (!node->key)
-		goto free_node;
+	for (uint32_t i = 0; i < n; i++) {
+		if (keys[i])
+			__htable_prefetch_entry(htable, hashes[i]);
+	}
+}
 
-	//
-	node->value = alloc_value(value);
-	if (!node->value)
-		goto free_key;
 
-	return node;
+/******************************************************************************/
 
-free_key:
-	free_key(node->key);
-free_node:
-	free(node);
-error:
-	return NULL;
+static int __htable_lookup(htable_t *htable, void *key, uint64_t hash,
+						void **value)
+{
+	if (htable->type == HTABLE_OPEN)
+		return __htable_open_lookup(htable, key, hash, value);
+
+	return __htable_chained_lookup(htable, key, hash, value);
 }
 
-/**
- * Destroy memory for a node in hash table.
- */
-static void __htable_node_destroy(htable_node_t *node, free_key_cb free_key,
-								free_value_cb free_value)
+static int __htable_insert(htable_t *htable, void *key, void *value,
+						uint64_t hash)
 {
-	if (!node)
-		return;
+	int rv;
 
-	//
-	free_key(node->key);
-	free_value(node->value);
+	// key already in hash table
+	if (!__htable_lookup(htable, key, hash, NULL))
+		return -5;
+
+	// validate available memory left
+	if (__htable_reserve(htable))
+		return -2;
 
 	//
-	free(node);
+	if (htable->type == HTABLE_OPEN)
+		rv = __htable_open_insert(htable, key, value, hash);
+	else
+		rv = __htable_chained_insert(htable, key, value, hash);
+
+	if (!rv)
+		htable->size++;
+
+	return rv;
 }
 
 
-/******************************** PUBLIC API **********************************/
+/******************************************************************************/
 
 /**
- * Create a hash table.
- *
- * @capacity: Hash table capacity.
- * @hash	: Hash function.
- *
- * Return new allocated hash table on success and false otherwise.
+ * Slot size of an entry (open addressing): a pointer for allocated entries,
+ * the entry size for inline ones. Sizes are rounded up to a power of 2 (small
+ * entries) or to pointer size, so that slots are naturally aligned.
  */
-htable_t *htable_create(uint32_t capacity, hash_cb hash, cmp_cb cmp,
-						alloc_key_cb alloc_key, free_key_cb free_key,
-						alloc_value_cb alloc_value, free_value_cb free_value)
+static uint32_t __htable_entry_stride(uint32_t size)
+{
+	if (!size)
+		return sizeof(void *);
+
+	if (size >= sizeof(void *))
+		return ALIGN(size, sizeof(void *));
+
+	return IS_POWER_2(size) ? size : 1U << (32 - __builtin_clz(size));
+}
+
+static htable_t *__htable_create(htable_type_e type, uint32_t capacity,
+								uint32_t key_size, uint32_t value_size,
+								hash_cb hash, cmp_cb cmp,
+								alloc_key_cb alloc_key, free_key_cb free_key,
+								alloc_value_cb alloc_value,
+								free_value_cb free_value)
 {
 	htable_t *htable;
 
 	//
-	if (!hash || !cmp || !alloc_key || !free_key || !alloc_value || !free_value)
+	if (!hash || !cmp)
+		goto error;
+
+	if (type != HTABLE_CHAINED && type != HTABLE_OPEN)
+		goto error;
+
+	if (capacity > HTABLE_MAX_CAPACITY)
 		goto error;
 
 	//
-	htable = malloc(sizeof(htable_t));
+	htable = calloc(1, sizeof(htable_t));
 	if (!htable)
 		goto error;
 
 	//
-	htable->buckets = malloc(capacity * sizeof(kdlist_head_t));
-	if (!htable->buckets)
-		goto free_htable;
-
-	for (int i = 0; i < capacity; i++)
-		kdlist_head_init(&htable->buckets[i]);
+	capacity = capacity < HTABLE_MIN_CAPACITY ? HTABLE_MIN_CAPACITY : capacity;
+	if (!IS_POWER_2(capacity))
+		capacity = 1U << (32 - __builtin_clz(capacity));
 
 	//
+	htable->type = type;
 	htable->size = 0;
-	htable->capacity = capacity;
+	htable->rehash_idx = -1;
+
+	//
+	htable->key_size = key_size;
+	htable->key_stride = __htable_entry_stride(key_size);
+	htable->value_size = value_size;
+	htable->value_stride = __htable_entry_stride(value_size);
+
+	if (__htable_tbl_create(htable, &htable->tbl[0], capacity))
+		goto free_htable;
 
 	//
 	htable->__hash = hash;
@@ -145,31 +1124,122 @@ error:
 	return NULL;
 }
 
+
+/******************************** PUBLIC API **********************************/
+
 /**
- * Destroy (free) a hash table.
+ * Create a hash table (HTABLE_CHAINED).
+ *
+ * @capacity: Hash table initial capacity.
+ * @hash	: Hash function.
+ *
+ * Return new allocated hash table on success and false otherwise.
  */
-void htable_destroy(htable_t *htable)
+htable_t *htable_create(uint32_t capacity, hash_cb hash, cmp_cb cmp,
+						alloc_key_cb alloc_key, free_key_cb free_key,
+						alloc_value_cb alloc_value, free_value_cb free_value)
 {
-	htable_node_t *node;
-	kdlist_node_t *it, *aux;
-	kdlist_head_t *bucket_list;
+	return htable_create_type(HTABLE_CHAINED, capacity, hash, cmp, alloc_key,
+							free_key, alloc_value, free_value);
+}
+
+/**
+ * Create a hash table using a given storage mode.
+ *
+ * @type	: Hash table storage mode.
+ * @capacity: Hash table initial capacity.
+ * @hash	: Hash function.
+ *
+ * Return new allocated hash table on success and false otherwise.
+ */
+htable_t *htable_create_type(htable_type_e type, uint32_t capacity,
+						hash_cb hash, cmp_cb cmp,
+						alloc_key_cb alloc_key, free_key_cb free_key,
+						alloc_value_cb alloc_value, free_value_cb free_value)
+{
+	//
+	if (!alloc_key || !free_key || !alloc_value || !free_value)
+		return NULL;
+
+	return __htable_create(type, capacity, 0, 0, hash, cmp, alloc_key,
+						free_key, alloc_value, free_value);
+}
+
+/**
+ * Create a hash table storing fixed-size keys and values inline (copied into
+ * the table, no allocation callbacks).
+ *
+ * @type		: Hash table storage mode.
+ * @capacity	: Hash table initial capacity.
+ * @key_size	: Key size in bytes.
+ * @value_size	: Value size in bytes.
+ * @hash		: Hash function.
+ *
+ * Return new allocated hash table on success and NULL otherwise.
+ */
+htable_t *htable_create_inline(htable_type_e type, uint32_t capacity,
+						uint32_t key_size, uint32_t value_size,
+						hash_cb hash, cmp_cb cmp)
+{
+	//
+	if (!key_size || !value_size)
+		return NULL;
+
+	return __htable_create(type, capacity, key_size, value_size, hash, cmp,
+						NULL, NULL, NULL, NULL);
+}
+
+/**
+ * Allocate nodes of a hash table from a slab cache. Only HTABLE_CHAINED tables
+ * have nodes, and the table must be empty (no node allocated so far).
+ *
+ * @htable	: Hash table data structure.
+ * @cache	: Slab cache (obj_size >= htable_node_size()), or NULL for malloc.
+ * @cpu_id	: Core id used for slab cache operations.
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+int htable_set_node_cache(htable_t *htable, slab_cache_t *cache, int cpu_id)
+{
+	// validate input
+	if (!htable || htable->type != HTABLE_CHAINED || htable->size)
+		return -1;
+
+	if (cache && (cache->obj_size < NODE_SIZE(htable) ||
+		(cpu_id != SLAB_CPU_ANY && (cpu_id < 0 || cpu_id >= MAX_CPUS))))
+		return -1;
 
 	//
+	htable->node_cache = cache;
+	htable->cpu_id = cpu_id;
+
+	return 0;
+}
+
+/**
+ * Size of a hash table node (HTABLE_CHAINED), inline key and value included.
+ */
+size_t htable_node_size(htable_t *htable)
+{
 	if (!htable)
-		return;
+		return 0;
 
-	for (int i = 0; i < htable->capacity; i++) {
-		bucket_list = &htable->buckets[i];
+	return NODE_SIZE(htable);
+}
 
-		kdlist_for_each_safe(it, aux, bucket_list) {
-			node = container_of(it, htable_node_t, node);
-			__htable_node_destroy(node, htable->__free_key,
-								htable->__free_value);
-		}
-	}
+/**
+ * Destroy (free) a hash table.
+ */
+void htable_destroy(htable_t *htable)
+{
+	//
+	if (!htable)
+		return;
 
 	//
-	free(htable->buckets);
+	__htable_tbl_destroy(htable, &htable->tbl[0]);
+	if (HTABLE_IS_REHASHING(htable))
+		__htable_tbl_destroy(htable, &htable->tbl[1]);
 
 	//
 	free(htable);
@@ -189,39 +1259,19 @@ void htable_destroy(htable_t *htable)
  */
 int htable_insert(htable_t *htable, void *key, void *value)
 {
-	int rv = 0;
-	uint32_t htable_idx;
-	htable_node_t *node;
+	uint64_t hash;
 
 	// validate input
-	if (!htable || !key || !value) {
-		rv = -1; goto finish;
-	}
-
-	// validate available memory left
-	if (htable->size == htable->capacity) {
-		rv = -2; goto finish;
-	}
-
-	// compute and validate hash index
-	htable_idx = htable->__hash(key);
-	if (htable_idx >= htable->capacity) {
-		rv = -3; goto finish;
-	}
+	if (!htable || !key || !value)
+		return -1;
 
-	// create new node for bucket list
-	node = __htable_node_create(key, value, htable->__alloc_key,
-								htable->__free_key,
-								htable->__alloc_value);
-	if (!node) {
-		rv = -4; goto finish;
-	}
+	//
+	__htable_rehash_step(htable, HTABLE_REHASH_STEP);
 
-	// insert data to bucket (if collision, add at the end of the list)
-	kdlist_push_tail(&htable->buckets[htable_idx], &node->node);
+	//
+	hash = __htable_hash(htable, key);
 
-finish:
-	return rv;
+	return __htable_insert(htable, key, value, hash);
 }
 
 /**
@@ -234,81 +1284,203 @@ finish:
  */
 int htable_delete(htable_t *htable, void *key)
 {
-	int rv = 0;
-	uint32_t htable_idx;
-	htable_node_t *node;
-	kdlist_node_t *it, *aux;
-	kdlist_head_t *bucket_list;
+	int rv;
+	uint64_t hash;
 
 	// validate input
-	if (!htable || !key) {
-		rv = -1; goto finish;
-	}
+	if (!htable || !key)
+		return -1;
 
-	// compute and validate hash index
-	htable_idx = htable->__hash(key);
-	if (htable_idx >= htable->capacity) {
-		rv = -2; goto finish;
-	}
+	//
+	__htable_rehash_step(htable, HTABLE_REHASH_STEP);
 
-	bucket_list = &htable->buckets[htable_idx];
+	//
+	hash = __htable_hash(htable, key);
+	if (htable->type == HTABLE_OPEN)
+		rv = __htable_open_delete(htable, key, hash);
+	else
+		rv = __htable_chained_delete(htable, key, hash);
 
-	// empty buckets list
-	if (kdlist_is_empty(bucket_list)) {
-		rv = -3; goto finish;
-	}
+	if (!rv)
+		htable->size--;
 
-	// lookup into buckets list
-	kdlist_for_each_safe(it, aux, bucket_list) {
-		node = container_of(it, htable_node_t, node);
+	return rv;
+}
 
-		if (htable->__cmp(key, node->key) == 0) {
-			//
-			it->next->prev = it->prev;
-			it->prev->next = it->next;
-			//
-			__htable_node_destroy(node, htable->__free_key,
-								htable->__free_value);
-		}
-	}
+/**
+ * Lookup an entry in hashtable.
+ *
+ * @htable	: Hash table data structure.
+ * @key		: Hash table entry key to lookup.
+ * @value	: Hash table entry value (output).
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+int htable_lookup(htable_t *htable, void *key, void **value)
+{
+	uint64_t hash;
+
+	// validate input
+	if (!htable || !key || !value)
+		return -1;
 
-// not found
-	rv = -4;
+	//
+	hash = __htable_hash(htable, key);
 
-finish:
-	return rv;
+	return __htable_lookup(htable, key, hash, value);
+}
+
+/**
+ * Lookup an entry in hashtable.
+ *
+ * @htable	: Hash table data structure.
+ * @key		: Hash table entry key to lookup.
+ *
+ * Return entry value if found and NULL otherwise.
+ */
+void *htable_find_ptr(htable_t *htable, void *key)
+{
+	void *value;
+
+	if (htable_lookup(htable, key, &value))
+		return NULL;
+
+	return value;
 }
 
 
 /*****************************************************************************/
 
+/**
+ * Insert a batch of entries into hashtable. Hashes are computed and buckets
+ * prefetched ahead (HTABLE_BATCH_CHUNK keys at a time), then entries are
+ * inserted in order, as n htable_insert() calls would.
+ *
+ * @htable	: Hash table data structure.
+ * @keys	: Entries keys.
+ * @values	: Entries values.
+ * @rv		: Per entry status, as returned by htable_insert() (output).
+ * @n		: Number of entries.
+ *
+ * Return number of inserted entries on success and <0 otherwise.
+ */
+int htable_insert_batch(htable_t *htable, void **keys, void **values, int *rv,
+						uint32_t n)
+{
+	int inserted = 0;
+	uint32_t chunk;
+	uint64_t hashes[HTABLE_BATCH_CHUNK];
+
+	// validate input
+	if (!htable || !keys || !values || !rv)
+		return -1;
+
+	//
+	for (uint32_t i = 0; i < n; i += chunk) {
+		chunk = MIN(n - i, HTABLE_BATCH_CHUNK);
+
+		__htable_prefetch_batch(htable, &keys[i], hashes, chunk);
+
+		for (uint32_t j = 0; j < chunk; j++) {
+			if (!keys[i + j] || !values[i + j]) {
+				rv[i + j] = -1;
+				continue;
+			}
+
+			__htable_rehash_step(htable, HTABLE_REHASH_STEP);
+
+			rv[i + j] = __htable_insert(htable, keys[i + j], values[i + j],
+										hashes[j]);
+			if (!rv[i + j])
+				inserted++;
+		}
+	}
+
+	return inserted;
+}
 
 /**
- * Print current entries in hashtable.
+ * Lookup a batch of entries in hashtable. Hashes are computed and buckets
+ * prefetched ahead (HTABLE_BATCH_CHUNK keys at a time), so memory latency of
+ * different keys overlaps.
  *
  * @htable	: Hash table data structure.
- * @pkey	: Custom function for printing keys.
- * @pval	: Custom function for printing values.
+ * @keys	: Entries keys to lookup.
+ * @values	: Entries values, left untouched for missing keys (output).
+ * @rv		: Per entry status, as returned by htable_lookup() (output).
+ * @n		: Number of entries.
+ *
+ * Return number of found entries on success and <0 otherwise.
  */
-void htable_print(htable_t *htable, print_key_cb pkey, print_key_cb pval)
+int htable_lookup_batch(htable_t *htable, void **keys, void **values, int *rv,
+						uint32_t n)
+{
+	int found = 0;
+	uint32_t chunk;
+	uint64_t hashes[HTABLE_BATCH_CHUNK];
+
+	// validate input
+	if (!htable || !keys || !values || !rv)
+		return -1;
+
+	//
+	for (uint32_t i = 0; i < n; i += chunk) {
+		chunk = MIN(n - i, HTABLE_BATCH_CHUNK);
+
+		__htable_prefetch_batch(htable, &keys[i], hashes, chunk);
+
+		for (uint32_t j = 0; j < chunk; j++) {
+			if (!keys[i + j]) {
+				rv[i + j] = -1;
+				continue;
+			}
+
+			rv[i + j] = __htable_lookup(htable, keys[i + j], hashes[j],
+										&values[i + j]);
+			if (!rv[i + j])
+				found++;
+		}
+	}
+
+	return found;
+}
+
+
+/*****************************************************************************/
+
+static void __htable_tbl_print(htable_t *htable, htable_tbl_t *tbl,
+							print_key_cb pkey, print_key_cb pval)
 {
 	htable_node_t *node;
 	kdlist_node_t *it, *aux;
 	kdlist_head_t *bucket_list;
 
 	//
-	if (!htable)
-		return;
+	printf("Capacity: %u\n", tbl->capacity);
+	printf("Size    : %u\n", tbl->size);
 
 	//
-	printf("Capacity: %u\n", htable->capacity);
-	printf("Size    : %u\n", htable->size);
+	if (htable->type == HTABLE_OPEN) {
+		for (uint32_t i = 0; i < tbl->capacity; i++) {
+			if (!CTRL_IS_FULL(tbl->ctrl[i]))
+				continue;
+
+			//
+			printf("    Slot id: %u (tag 0x%02x)\n", i, tbl->ctrl[i]);
+
+			//
+			pkey(__htable_slot_key(htable, tbl, i));
+			pval(__htable_slot_value(htable, tbl, i));
+		}
+
+		return;
+	}
 
 	//
-	for (int i = 0; i < htable->capacity; i++) {
-		bucket_list = &htable->buckets[i];
+	for (uint32_t i = 0; i < tbl->capacity; i++) {
+		bucket_list = &tbl->buckets[i];
 		//
-		printf("    Bucket id: %d\n", i);
+		printf("    Bucket id: %u\n", i);
 
 		//
 		if (kdlist_is_empty(bucket_list)) {
@@ -326,3 +1498,28 @@ void htable_print(htable_t *htable, print_key_cb pkey, print_key_cb pval)
 		}
 	}
 }
+
+/**
+ * Print current entries in hashtable.
+ *
+ * @htable	: Hash table data structure.
+ * @pkey	: Custom function for printing keys.
+ * @pval	: Custom function for printing values.
+ */
+void htable_print(htable_t *htable, print_key_cb pkey, print_key_cb pval)
+{
+	//
+	if (!htable)
+		return;
+
+	//
+	printf("Size    : %u\n", htable->size);
+
+	//
+	__htable_tbl_print(htable, &htable->tbl[0], pkey, pval);
+
+	if (HTABLE_IS_REHASHING(htable)) {
+		printf("Rehashing (next %ld):\n", htable->rehash_idx);
+		__htable_tbl_print(htable, &htable->tbl[1], pkey, pval);
+	}
+}
@@ -0,0 +1,413 @@
+/**
+ * RCU protected hash table implementation.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "htable/rcu_htable.h"
+
+
+/******************************************************************************/
+
+/**
+ * RCU HTABLE
+ *
+ *  buckets
+ *
+ *  |  | ---> |key|value|next| ---> |key|value|next| ---> NULL
+ *   --
+ *  |  | ---> NULL
+ *   --
+ *  |  | ---> |key|value|next| ---> NULL
+ *   --
+ *
+ * Delete (writer, under lock):
+ *
+ *  prev->next = rcu_assign_pointer(node->next)   (readers see old or new list)
+ *  rcu_call(node)                                 (free after grace period)
+ */
+
+/******************************************************************************/
+
+#define GOLDEN_RATIO_32				0x9E3779B9U
+
+
+/******************************************************************************/
+
+static inline _Atomic(void *) *__rcu_htable_bucket(rcu_htable_t *table,
+													void *key)
+{
+	uint32_t hash = table->__hash(key) * GOLDEN_RATIO_32;
+
+	// shift is 32 for a single bucket
+	return &table->buckets[(uint64_t)hash >> table->shift];
+}
+
+
+/******************************************************************************/
+
+static rcu_htable_node_t *__rcu_htable_node_create(rcu_htable_t *table,
+												void *key, void *value)
+{
+	rcu_htable_node_t *node;
+
+	//
+	node = malloc(sizeof(rcu_htable_node_t));
+	if (!node)
+		goto error;
+
+	//
+	node->key = table->__alloc_key(key);
+	if (!node->key)
+		goto free_node;
+
+	//
+	node->value = table->__alloc_value(value);
+	if (!node->value)
+		goto free_key;
+
+	//
+	node->table = table;
+	atomic_init(&node->next, NULL);
+
+	return node;
+
+free_key:
+	table->__free_key(node->key);
+free_node:
+	free(node);
+error:
+	return NULL;
+}
+
+static void __rcu_htable_node_destroy(void *ptr)
+{
+	rcu_htable_node_t *node = (rcu_htable_node_t *)ptr;
+
+	node->table->__free_key(node->key);
+	node->table->__free_value(node->value);
+
+	free(node);
+}
+
+/**
+ * Lookup the link pointing to the node of a given key. Called by writers
+ * (under lock), so relaxed loads are enough.
+ *
+ * Return link on success and NULL otherwise.
+ */
+static _Atomic(void *) *__rcu_htable_find_link(rcu_htable_t *table, void *key)
+{
+	_Atomic(void *) *link;
+	rcu_htable_node_t *node;
+
+	//
+	link = __rcu_htable_bucket(table, key);
+
+	while ((node = atomic_load_explicit(link, memory_order_relaxed))) {
+		if (table->__cmp(key, node->key) == 0)
+			return link;
+
+		link = &node->next;
+	}
+
+	return NULL;
+}
+
+
+/******************************** PUBLIC API **********************************/
+
+/**
+ * Create a rcu hash table.
+ *
+ * @rcu		: Rcu context used by readers.
+ * @capacity: Number of buckets (rounded up to a power of 2).
+ * @hash	: Hash function.
+ *
+ * Return new allocated hash table on success and NULL otherwise.
+ */
+rcu_htable_t *rcu_htable_create(rcu_ctx_t *rcu, uint32_t capacity,
+						hash_cb hash, cmp_cb cmp,
+						alloc_key_cb alloc_key, free_key_cb free_key,
+						alloc_value_cb alloc_value, free_value_cb free_value)
+{
+	rcu_htable_t *table;
+
+	//
+	if (!rcu || !hash || !cmp || !alloc_key || !free_key || !alloc_value ||
+		!free_value)
+		goto error;
+
+	if (capacity > HTABLE_MAX_CAPACITY)
+		goto error;
+
+	capacity = capacity ? capacity : 1;
+	if (!IS_POWER_2(capacity))
+		capacity = 1U << (32 - __builtin_clz(capacity));
+
+	//
+	table = malloc(sizeof(rcu_htable_t));
+	if (!table)
+		goto error;
+
+	table->buckets = calloc(capacity, sizeof(_Atomic(void *)));
+	if (!table->buckets)
+		goto free_table;
+
+	//
+	table->capacity = capacity;
+	table->shift = 32 - __builtin_ctz(capacity);
+	atomic_init(&table->size, 0);
+
+	//
+	table->rcu = rcu;
+	pthread_mutex_init(&table->lock, NULL);
+
+	//
+	table->__hash = hash;
+	table->__cmp = cmp;
+	table->__alloc_key = alloc_key;
+	table->__free_key = free_key;
+	table->__alloc_value = alloc_value;
+	table->__free_value = free_value;
+
+	return table;
+
+free_table:
+	free(table);
+error:
+	return NULL;
+}
+
+/**
+ * Destroy (free) a rcu hash table. No reader or writer may access the table
+ * at this point. Pending deferred frees are executed first.
+ */
+void rcu_htable_destroy(rcu_htable_t *table)
+{
+	rcu_htable_node_t *node, *next;
+
+	//
+	if (!table)
+		return;
+
+	//
+	rcu_htable_reclaim(table);
+
+	for (uint32_t i = 0; i < table->capacity; i++) {
+		node = atomic_load_explicit(&table->buckets[i], memory_order_relaxed);
+
+		while (node) {
+			next = atomic_load_explicit(&node->next, memory_order_relaxed);
+			__rcu_htable_node_destroy(node);
+			node = next;
+		}
+	}
+
+	//
+	pthread_mutex_destroy(&table->lock);
+	free(table->buckets);
+	free(table);
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Insert an entry into rcu hash table.
+ *
+ * @table	: Rcu hash table.
+ * @key		: Entry key.
+ * @value	: Entry value.
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+int rcu_htable_insert(rcu_htable_t *table, void *key, void *value)
+{
+	int rv = 0;
+	_Atomic(void *) *bucket;
+	rcu_htable_node_t *node;
+
+	// validate input
+	if (!table || !key || !value)
+		return -1;
+
+	// initialize node before being visible to readers
+	node = __rcu_htable_node_create(table, key, value);
+	if (!node)
+		return -4;
+
+	//
+	pthread_mutex_lock(&table->lock);
+
+	// key already in hash table
+	if (__rcu_htable_find_link(table, key)) {
+		rv = -5; goto unlock;
+	}
+
+	// publish at bucket head
+	bucket = __rcu_htable_bucket(table, key);
+	atomic_store_explicit(&node->next,
+						atomic_load_explicit(bucket, memory_order_relaxed),
+						memory_order_relaxed);
+	rcu_assign_pointer(bucket, node);
+
+	atomic_fetch_add_explicit(&table->size, 1, memory_order_relaxed);
+
+unlock:
+	pthread_mutex_unlock(&table->lock);
+
+	if (rv)
+		__rcu_htable_node_destroy(node);
+
+	return rv;
+}
+
+/**
+ * Replace the value of an entry in rcu hash table. Readers see either the old
+ * or the new entry; the old one is freed after a grace period.
+ *
+ * @table	: Rcu hash table.
+ * @key		: Entry key.
+ * @value	: New entry value.
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+int rcu_htable_update(rcu_htable_t *table, void *key, void *value)
+{
+	int rv = 0;
+	_Atomic(void *) *link;
+	rcu_htable_node_t *node, *old;
+
+	// validate input
+	if (!table || !key || !value)
+		return -1;
+
+	//
+	node = __rcu_htable_node_create(table, key, value);
+	if (!node)
+		return -4;
+
+	//
+	pthread_mutex_lock(&table->lock);
+
+	link = __rcu_htable_find_link(table, key);
+	if (!link) {
+		rv = -3; goto unlock;
+	}
+
+	// new node takes old node place
+	old = atomic_load_explicit(link, memory_order_relaxed);
+	atomic_store_explicit(&node->next,
+						atomic_load_explicit(&old->next, memory_order_relaxed),
+						memory_order_relaxed);
+	rcu_assign_pointer(link, node);
+
+	//
+	rcu_call(table->rcu, __rcu_htable_node_destroy, old);
+
+unlock:
+	pthread_mutex_unlock(&table->lock);
+
+	if (rv)
+		__rcu_htable_node_destroy(node);
+
+	return rv;
+}
+
+/**
+ * Delete an entry from rcu hash table. The entry is freed after a grace
+ * period.
+ *
+ * @table	: Rcu hash table.
+ * @key		: Entry key.
+ *
+ * Return 0 on success and <0 otherwise.
+ */
+int rcu_htable_delete(rcu_htable_t *table, void *key)
+{
+	int rv = 0;
+	_Atomic(void *) *link;
+	rcu_htable_node_t *node;
+
+	// validate input
+	if (!table || !key)
+		return -1;
+
+	//
+	pthread_mutex_lock(&table->lock);
+
+	link = __rcu_htable_find_link(table, key);
+	if (!link) {
+		rv = -4; goto unlock;
+	}
+
+	// unlink (readers already on node can still move forward)
+	node = atomic_load_explicit(link, memory_order_relaxed);
+	rcu_assign_pointer(link,
+					atomic_load_explicit(&node->next, memory_order_relaxed));
+
+	//
+	rcu_call(table->rcu, __rcu_htable_node_destroy, node);
+	atomic_fetch_sub_explicit(&table->size, 1, memory_order_relaxed);
+
+unlock:
+	pthread_mutex_unlock(&table->lock);
+
+	return rv;
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Lookup an entry in rcu hash table. Must be called inside a rcu read-side
+ * critical section of the table rcu context.
+ *
+ * @table	: Rcu hash table.
+ * @key		: Entry key.
+ *
+ * Return entry value (valid until rcu_read_unlock()) or NULL if not found.
+ */
+void *rcu_htable_lookup(rcu_htable_t *table, void *key)
+{
+	rcu_htable_node_t *node;
+
+	//
+	if (!table || !key)
+		return NULL;
+
+	//
+	node = rcu_dereference(__rcu_htable_bucket(table, key));
+
+	while (node) {
+		if (table->__cmp(key, node->key) == 0)
+			return node->value;
+
+		node = rcu_dereference(&node->next);
+	}
+
+	return NULL;
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Wait until the deferred frees scheduled so far are done (after a grace
+ * period). Must not be called inside a rcu read-side critical section.
+ *
+ * @table	: Rcu hash table.
+ */
+void rcu_htable_reclaim(rcu_htable_t *table)
+{
+	if (!table)
+		return;
+
+	rcu_barrier(table->rcu);
+}
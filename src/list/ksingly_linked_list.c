@@ -220,7 +220,7 @@ void kslist_replace(kslist_head_t *head, kslist_node_t *old, kslist_node_t *new)
  *
  * @head: Generic singly linked list head.
  */
-void kslist_print(kslist_head_t *head, print_cb cb)
+void kslist_print(kslist_head_t *head, kslist_print_cb cb)
 {
 	kslist_node_t *node;
 
@@ -0,0 +1,248 @@
+/**
+ * POC implementation of distributed (reader scalable) read-write lock.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "synchronization/drwlock.h"
+
+
+/*****************************************************************************/
+
+// next slot given to a thread
+static atomic_uint __drwlock_next_slot;
+
+// reader slot of this thread (-1 until first read)
+static __thread int __drwlock_slot = -1;
+
+
+/*****************************************************************************/
+
+static inline void __futex_wait(atomic_int *addr, int val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static inline void __futex_wake_all(atomic_int *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+
+/*****************************************************************************/
+
+static inline drwlock_slot_t *__drwlock_slot_of(drwlock_t *drwlock)
+{
+	// threads are spread over slots in order of their first read
+	if (__drwlock_slot < 0)
+		__drwlock_slot = atomic_fetch_add_explicit(&__drwlock_next_slot, 1,
+								memory_order_relaxed) & (DRWLOCK_SLOTS - 1);
+
+	return &drwlock->slots[__drwlock_slot];
+}
+
+/**
+ * Drop a read reference. The last reader of a slot wakes a waiting writer
+ * (no system call unless the writer sleeps).
+ */
+static inline void __drwlock_slot_put(drwlock_t *drwlock, drwlock_slot_t *slot)
+{
+	// sequentially consistent with writer store and slots scan
+	if (atomic_fetch_sub(&slot->readers, 1) != 1 ||
+		!atomic_load(&drwlock->writer))
+		return;
+
+	atomic_fetch_add_explicit(&drwlock->seq, 1, memory_order_release);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (atomic_load_explicit(&drwlock->sleepers, memory_order_relaxed))
+		__futex_wake_all(&drwlock->seq);
+}
+
+/**
+ * Take a read reference in the thread slot, unless a writer holds or waits
+ * for the lock.
+ */
+static inline bool __drwlock_read_try(drwlock_t *drwlock, drwlock_slot_t *slot)
+{
+	// sequentially consistent with writer store and slots scan
+	atomic_fetch_add(&slot->readers, 1);
+
+	if (!atomic_load(&drwlock->writer))
+		return true;
+
+	__drwlock_slot_put(drwlock, slot);
+	return false;
+}
+
+/**
+ * Wait (writer) for the readers of a slot to drain: spin with exponential
+ * backoff first, then sleep until the last reader of a slot leaves.
+ */
+static void __drwlock_slot_drain(drwlock_t *drwlock, drwlock_slot_t *slot)
+{
+	int seq, backoff = 1;
+	bool done;
+
+	/******************************************************
+	 * Bounded spinning
+	 ******************************************************/
+	for (int i = 0; i < DRWLOCK_SPIN_MAX; i++) {
+		if (!atomic_load(&slot->readers))
+			return;
+
+		rwlock_pause(backoff);
+		backoff = MIN(2 * backoff, RWLOCK_BACKOFF_MAX);
+	}
+
+	/******************************************************
+	 * Sleep. Sleeper is visible before the last check, so
+	 * the last reader after it sees the sleeper and wakes
+	 * it (or changes seq and the wait returns at once).
+	 ******************************************************/
+	while (1) {
+		seq = atomic_load_explicit(&drwlock->seq, memory_order_acquire);
+
+		atomic_fetch_add_explicit(&drwlock->sleepers, 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);
+
+		done = !atomic_load(&slot->readers);
+		if (!done)
+			__futex_wait(&drwlock->seq, seq);
+
+		atomic_fetch_sub_explicit(&drwlock->sleepers, 1, memory_order_relaxed);
+
+		if (done || !atomic_load(&slot->readers))
+			return;
+	}
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Create a new distributed read-write lock.
+ *
+ * Return the lock on success or NULL on error.
+ */
+drwlock_t *drwlock_create(void)
+{
+	drwlock_t *drwlock = NULL;
+
+	// slots are cache line aligned
+	if (posix_memalign((void **)&drwlock, CACHE_LINE_SIZE, sizeof(drwlock_t)))
+		goto finish;
+
+	//
+	atomic_init(&drwlock->writer, 0);
+	atomic_init(&drwlock->seq, 0);
+	atomic_init(&drwlock->sleepers, 0);
+	rwlock_init(&drwlock->lock);
+
+	for (int i = 0; i < DRWLOCK_SLOTS; i++)
+		atomic_init(&drwlock->slots[i].readers, 0);
+
+finish:
+	return drwlock;
+}
+
+
+/**
+ * Free memory for a distributed read-write lock.
+ */
+void drwlock_destroy(drwlock_t *drwlock)
+{
+	free(drwlock);
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Wait and acquire a read lock.
+ *
+ * @drwlock	: Distributed read-write lock.
+ */
+void drwlock_read_lock(drwlock_t *drwlock)
+{
+	drwlock_slot_t *slot = __drwlock_slot_of(drwlock);
+
+	while (!__drwlock_read_try(drwlock, slot)) {
+		// sleep until the writer is done
+		rwlock_read_lock(&drwlock->lock);
+		rwlock_read_unlock(&drwlock->lock);
+	}
+}
+
+/**
+ * Try to acquire a read lock.
+ *
+ * @drwlock	: Distributed read-write lock.
+ *
+ * Return 0 on success and <0 if a writer holds or waits for the lock.
+ */
+int drwlock_read_trylock(drwlock_t *drwlock)
+{
+	return __drwlock_read_try(drwlock, __drwlock_slot_of(drwlock)) ? 0 : -1;
+}
+
+/**
+ * Release a read lock (from the thread holding it).
+ *
+ * @drwlock	: Distributed read-write lock.
+ */
+void drwlock_read_unlock(drwlock_t *drwlock)
+{
+	__drwlock_slot_put(drwlock, __drwlock_slot_of(drwlock));
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Wait and acquire a write lock.
+ *
+ * @drwlock	: Distributed read-write lock.
+ */
+void drwlock_write_lock(drwlock_t *drwlock)
+{
+	// one writer at a time
+	rwlock_write_lock(&drwlock->lock);
+
+	// block new readers, sequentially consistent with their slot increment
+	atomic_store(&drwlock->writer, 1);
+
+	/******************************************************
+	 * Wait for readers to drain, slot by slot (a drained
+	 * slot stays empty, new readers back off)
+	 ******************************************************/
+	for (int i = 0; i < DRWLOCK_SLOTS; i++)
+		__drwlock_slot_drain(drwlock, &drwlock->slots[i]);
+}
+
+/**
+ * Release a write lock.
+ *
+ * @drwlock	: Distributed read-write lock.
+ */
+void drwlock_write_unlock(drwlock_t *drwlock)
+{
+	atomic_store_explicit(&drwlock->writer, 0, memory_order_release);
+
+	// wakes readers sleeping on the lock
+	rwlock_write_unlock(&drwlock->lock);
+}
@@ -3,6 +3,9 @@
  * Copyright (C) 2025 Lazar Razvan.
  */
 
+#define _GNU_SOURCE
+
+#include <time.h>
 #include <sched.h>
 #include <stdio.h>
 #include <assert.h>
@@ -11,10 +14,247 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "synchronization/rcu.h"
 
 
+/*****************************************************************************/
+
+// callback queue of this thread (for the last context used)
+static __thread rcu_ctx_t *__rcu_queue_ctx;
+static __thread int __rcu_queue_id;
+
+
+/*****************************************************************************/
+
+static inline void __futex_wait(atomic_int *addr, int val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static inline void __futex_wake_all(atomic_int *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Whether a reader slot holds a snapshot older than the epoch.
+ */
+static inline bool __rcu_slot_busy(thread_counter_t *slot, uint64_t epoch)
+{
+	uint64_t ctr = atomic_load(&slot->ctr);
+
+	return ctr && ctr < epoch;
+}
+
+/**
+ * Wait (writer) for the reader of a slot to leave a section entered before
+ * the epoch: spin first, then sleep until a reader leaves its section.
+ */
+static void __rcu_slot_wait(rcu_ctx_t *rcu, thread_counter_t *slot,
+							uint64_t epoch)
+{
+	int seq;
+	bool done;
+
+	/******************************************************
+	 * Bounded spinning
+	 ******************************************************/
+	for (int i = 0; i < RCU_SPIN_MAX; i++) {
+		if (!__rcu_slot_busy(slot, epoch))
+			return;
+	}
+
+	/******************************************************
+	 * Sleep. Sleeper is visible before the last check, so
+	 * the reader leaving after it sees the sleeper and wakes
+	 * it (or changes seq and the wait returns at once).
+	 ******************************************************/
+	while (1) {
+		seq = atomic_load_explicit(&rcu->seq, memory_order_acquire);
+
+		atomic_fetch_add_explicit(&rcu->sleepers, 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);
+
+		done = !__rcu_slot_busy(slot, epoch);
+		if (!done)
+			__futex_wait(&rcu->seq, seq);
+
+		atomic_fetch_sub_explicit(&rcu->sleepers, 1, memory_order_relaxed);
+
+		if (done || !__rcu_slot_busy(slot, epoch))
+			return;
+	}
+}
+
+/**
+ * Get the callback queue of the calling thread: its registration slot, or the
+ * shared queue if not registered. Any queue is safe to push to, the lookup
+ * only spreads writers over different cache lines.
+ */
+static rcu_queue_t *__rcu_queue_of(rcu_ctx_t *rcu)
+{
+	int size;
+	pthread_t self;
+
+	//
+	if (__rcu_queue_ctx == rcu)
+		return &rcu->queues[__rcu_queue_id];
+
+	/******************************************************
+	 * Slots are published before size, scan without lock
+	 ******************************************************/
+	self = pthread_self();
+	size = atomic_load_explicit(&rcu->size, memory_order_acquire);
+
+	__rcu_queue_ctx = rcu;
+	__rcu_queue_id = MAX_THREADS;
+
+	for (int i = 0; i < size; i++) {
+		if (pthread_equal(rcu->threads_idx[i], self)) {
+			__rcu_queue_id = i;
+			break;
+		}
+	}
+
+	return &rcu->queues[__rcu_queue_id];
+}
+
+/**
+ * Detach the callbacks of all queues.
+ *
+ * Return the callbacks as one list (NULL if none).
+ */
+static kslist_node_t *__rcu_collect(rcu_ctx_t *rcu)
+{
+	kslist_node_t *batch = NULL, *first, *last;
+	long cnt;
+
+	for (int i = 0; i < RCU_QUEUES; i++) {
+		first = atomic_exchange_explicit(&rcu->queues[i].head, NULL,
+							memory_order_acquire);
+		if (!first)
+			continue;
+
+		//
+		for (cnt = 1, last = first; last->next; last = last->next)
+			cnt++;
+
+		atomic_fetch_sub_explicit(&rcu->queues[i].len, cnt,
+							memory_order_relaxed);
+
+		last->next = batch;
+		batch = first;
+	}
+
+	return batch;
+}
+
+/**
+ * Call and free a list of callbacks.
+ */
+static void __rcu_run(kslist_node_t *batch)
+{
+	rcu_node_t *_node;
+
+	while (batch) {
+		_node = kslist_entry(batch, rcu_node_t, node);
+		batch = batch->next;
+
+		_node->fn(_node->ptr);
+		free(_node);
+	}
+}
+
+/**
+ * Whether all callback queues are empty.
+ */
+static bool __rcu_idle(rcu_ctx_t *rcu)
+{
+	for (int i = 0; i < RCU_QUEUES; i++) {
+		if (atomic_load_explicit(&rcu->queues[i].head, memory_order_relaxed))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Reclaimer thread: one grace period per batch of callbacks.
+ */
+static void *__rcu_reclaimer(void *arg)
+{
+	rcu_ctx_t *rcu = (rcu_ctx_t *)arg;
+	kslist_node_t *batch;
+	struct timespec ts;
+	bool stop, timer;
+	uint64_t req;
+
+	do {
+		/******************************************************
+		 * Sleep while there is no callback, then until the
+		 * period ends (batching) or someone wakes us. A push
+		 * on an empty queue signals under the lock, so it is
+		 * never missed between the check and the wait
+		 ******************************************************/
+		pthread_mutex_lock(&rcu->reclaim_lock);
+
+		timer = false;
+
+		while (!rcu->wake && !rcu->stop) {
+			if (!timer && __rcu_idle(rcu)) {
+				pthread_cond_wait(&rcu->reclaim_cond, &rcu->reclaim_lock);
+				continue;
+			}
+
+			if (!timer) {
+				clock_gettime(CLOCK_MONOTONIC, &ts);
+				ts.tv_nsec += RCU_RECLAIM_DELAY_MS * 1000000L;
+				ts.tv_sec += ts.tv_nsec / 1000000000L;
+				ts.tv_nsec %= 1000000000L;
+				timer = true;
+			}
+
+			if (pthread_cond_timedwait(&rcu->reclaim_cond,
+					&rcu->reclaim_lock, &ts))
+				break;
+		}
+
+		rcu->wake = false;
+		stop = rcu->stop;
+		req = rcu->barrier_req;
+
+		pthread_mutex_unlock(&rcu->reclaim_lock);
+
+		/******************************************************
+		 * Callbacks queued before the barriers seen above are
+		 * all in this batch
+		 ******************************************************/
+		batch = __rcu_collect(rcu);
+		if (batch) {
+			rcu_synchronize(rcu);
+			__rcu_run(batch);
+		}
+
+		//
+		pthread_mutex_lock(&rcu->reclaim_lock);
+		rcu->barrier_done = req;
+		pthread_cond_broadcast(&rcu->barrier_cond);
+		pthread_mutex_unlock(&rcu->reclaim_lock);
+
+	} while (!stop);
+
+	return NULL;
+}
+
+
 /*****************************************************************************/
 
 /**
@@ -24,48 +264,109 @@
  */
 rcu_ctx_t *rcu_create(void)
 {
+	return rcu_create_flags(0);
+}
+
+/**
+ * Create a rcu mechanism context.
+ *
+ * @flags	: RCU_RECLAIM_THREAD or 0.
+ *
+ * Return context on success or NULL on error.
+ */
+rcu_ctx_t *rcu_create_flags(uint32_t flags)
+{
+	pthread_condattr_t attr;
 	rcu_ctx_t *rcu = NULL;
 
+	//
+	if (flags & ~RCU_FLAGS_MASK)
+		goto finish;
+
 	//
 	// ensure CACHE_LINE_SIZE align to prevent false sharing
 	if (posix_memalign((void **)&rcu, CACHE_LINE_SIZE, (sizeof(rcu_ctx_t))))
 		goto finish;
 
 	//
-	rcu->size = 0;
+	atomic_init(&rcu->size, 0);
 	pthread_mutex_init(&rcu->lock, NULL);
 	//
-	kslist_head_init(&rcu->cbs);
+	atomic_init(&rcu->gp, 1);
+	atomic_init(&rcu->seq, 0);
+	atomic_init(&rcu->sleepers, 0);
 	//
 	memset(rcu->threads_idx, 0, MAX_THREADS * sizeof(pthread_t));
 	memset(rcu->threads_cnt, 0, MAX_THREADS * sizeof(thread_counter_t));
 
+	for (int i = 0; i < MAX_THREADS; i++)
+		atomic_init(&rcu->threads_cnt[i].ctr, 0);
+
+	for (int i = 0; i < RCU_QUEUES; i++) {
+		atomic_init(&rcu->queues[i].head, NULL);
+		atomic_init(&rcu->queues[i].len, 0);
+	}
+
+	//
+	rcu->flags = flags;
+	rcu->wake = false;
+	rcu->stop = false;
+	rcu->barrier_req = 0;
+	rcu->barrier_done = 0;
+
+	pthread_mutex_init(&rcu->reclaim_lock, NULL);
+	// reclaimer period is not affected by wall clock changes
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&rcu->reclaim_cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_cond_init(&rcu->barrier_cond, NULL);
+
+	if (!(flags & RCU_RECLAIM_THREAD))
+		goto finish;
+
+	if (pthread_create(&rcu->reclaimer, NULL, __rcu_reclaimer, rcu))
+		goto error;
+
 finish:
 	return rcu;
+
+error:
+	pthread_cond_destroy(&rcu->barrier_cond);
+	pthread_cond_destroy(&rcu->reclaim_cond);
+	pthread_mutex_destroy(&rcu->reclaim_lock);
+	pthread_mutex_destroy(&rcu->lock);
+
+	free(rcu);
+	return NULL;
 }
 
 
 /**
- * Free memort for a rcu mechanism context.
+ * Free memort for a rcu mechanism context. Pending callbacks are called
+ * (no reader must be left).
  */
 void rcu_destroy(rcu_ctx_t *rcu)
 {
-	rcu_node_t *_node;
-	kslist_head_t *_it, *_tmp;
-
 	//
-	if (kslist_is_empty(&rcu->cbs))
-		goto free_rcu;
+	if (rcu->flags & RCU_RECLAIM_THREAD) {
+		pthread_mutex_lock(&rcu->reclaim_lock);
+		rcu->stop = true;
+		pthread_cond_signal(&rcu->reclaim_cond);
+		pthread_mutex_unlock(&rcu->reclaim_lock);
+
+		pthread_join(rcu->reclaimer, NULL);
+	}
 
 	//
-	kslist_for_each_safe(_tmp, _it, &rcu->cbs) {
-		_node = kslist_entry(_tmp, rcu_node_t, node);
-		_node->fn(_node->ptr);
+	__rcu_run(__rcu_collect(rcu));
 
-		free(_node);
-	}
+	//
+	pthread_cond_destroy(&rcu->barrier_cond);
+	pthread_cond_destroy(&rcu->reclaim_cond);
+	pthread_mutex_destroy(&rcu->reclaim_lock);
+	pthread_mutex_destroy(&rcu->lock);
 
-free_rcu:
 	free(rcu);
 }
 
@@ -77,11 +378,11 @@ free_rcu:
  *
  * @rcu			: Rcu context.
  *
- * Return slot_id to be used in subsequent calls.
+ * Return slot_id to be used in subsequent calls or <0 if all slots are used.
  */
 int rcu_register_thread(rcu_ctx_t *rcu)
 {
-	int id;
+	int id, size;
 	pthread_t self;
 
 	//
@@ -90,18 +391,28 @@ int rcu_register_thread(rcu_ctx_t *rcu)
 	//
 	pthread_mutex_lock(&rcu->lock);
 
-	for (int i = 0; i < rcu->size; i++) {
+	size = atomic_load_explicit(&rcu->size, memory_order_relaxed);
+
+	for (int i = 0; i < size; i++) {
 		if (pthread_equal(rcu->threads_idx[i], self)) {
 			pthread_mutex_unlock(&rcu->lock);
 			return i;
 		}
 	}
 
-	id = rcu->size;
+	id = -1;
+	if (size == MAX_THREADS)
+		goto unlock;
+
+	id = size;
 	rcu->threads_idx[id] = self;
-	rcu->size++;
+	atomic_store_explicit(&rcu->size, size + 1, memory_order_release);
 
-	//
+	// callbacks go to the thread queue from now on
+	__rcu_queue_ctx = rcu;
+	__rcu_queue_id = id;
+
+unlock:
 	pthread_mutex_unlock(&rcu->lock);
 
 	return id;
@@ -119,11 +430,24 @@ int rcu_register_thread(rcu_ctx_t *rcu)
  */
 void rcu_read_lock(rcu_ctx_t *rcu, int thread_id)
 {
+	thread_counter_t *slot;
+
 #if DBG_ENABLE
-	assert(thread_id >= 0 && thread_id < rcu->size);
+	assert(thread_id >= 0 && thread_id < atomic_load(&rcu->size));
 #endif
 
-	atomic_fetch_add(&rcu->threads_cnt[thread_id].cnt, 1);
+	//
+	slot = &rcu->threads_cnt[thread_id];
+	if (slot->nest++)
+		return;
+
+	/******************************************************
+	 * Publish the epoch snapshot, sequentially consistent
+	 * with the writer epoch increment and slots scan
+	 ******************************************************/
+	atomic_store(&slot->ctr, atomic_load_explicit(&rcu->gp,
+						memory_order_relaxed));
+	atomic_thread_fence(memory_order_seq_cst);
 }
 
 
@@ -135,11 +459,30 @@ void rcu_read_lock(rcu_ctx_t *rcu, int thread_id)
  */
 void rcu_read_unlock(rcu_ctx_t *rcu, int thread_id)
 {
+	thread_counter_t *slot;
+
 #if DBG_ENABLE
-	assert(thread_id >= 0 && thread_id < rcu->size);
+	assert(thread_id >= 0 && thread_id < atomic_load(&rcu->size));
+	assert(rcu->threads_cnt[thread_id].nest > 0);
 #endif
 
-	atomic_fetch_sub(&rcu->threads_cnt[thread_id].cnt, 1);
+	//
+	slot = &rcu->threads_cnt[thread_id];
+	if (--slot->nest)
+		return;
+
+	/******************************************************
+	 * Quiescent, reads of the section are done before. The
+	 * store is sequentially consistent with the sleepers
+	 * check, system call only if a writer sleeps
+	 ******************************************************/
+	atomic_store(&slot->ctr, 0);
+
+	if (!atomic_load(&rcu->sleepers))
+		return;
+
+	atomic_fetch_add_explicit(&rcu->seq, 1, memory_order_release);
+	__futex_wake_all(&rcu->seq);
 }
 
 
@@ -172,88 +515,143 @@ void *rcu_dereference(_Atomic(void *) *ptr)
 /*****************************************************************************/
 
 /**
- * Writer section to wait for all reader.
+ * Writer section to wait for all readers that entered their read-side
+ * critical section before this call (grace period). Readers entering after
+ * are not waited for.
  *
  * @rcu			: Rcu context.
  */
 void rcu_synchronize(rcu_ctx_t *rcu)
 {
-	int i;
-	bool any_reader;
-
-	while (1) {
-		any_reader = false;
-
-		for (i = 0; i < rcu->size; i++) {
-			if (atomic_load(&rcu->threads_cnt[i].cnt) > 0) {
-				any_reader = true; break;
-			}
-		}
-
-		if (!any_reader)
-			break;
-
-		sched_yield();
-	}
+	int size;
+	uint64_t epoch;
+
+	/******************************************************
+	 * Start a new epoch, sequentially consistent with the
+	 * updates made before and the slots scan
+	 ******************************************************/
+	epoch = atomic_fetch_add(&rcu->gp, 1) + 1;
+	atomic_thread_fence(memory_order_seq_cst);
+
+	/******************************************************
+	 * Wait for readers with an older snapshot, slot by slot
+	 * (a slot past the epoch never goes back)
+	 ******************************************************/
+	size = atomic_load_explicit(&rcu->size, memory_order_acquire);
+
+	for (int i = 0; i < size; i++)
+		__rcu_slot_wait(rcu, &rcu->threads_cnt[i], epoch);
+
+	// callbacks and frees run after the readers are done
+	atomic_thread_fence(memory_order_acquire);
 }
 
 
 /*****************************************************************************/
 
 /**
- * Collect unused objects.
+ * Schedule a callback to be called after a grace period. If no memory is
+ * left to queue it, the callback is called inline after a rcu_synchronize()
+ * (so never call it from a read-side critical section).
  *
  * @rcu	: Rcu context.
+ * @fn	: Callback.
+ * @ptr	: Callback argument (object to free).
  */
 void rcu_call(rcu_ctx_t *rcu, rcu_callback_t fn, void *ptr)
 {
 	rcu_node_t *node;
+	rcu_queue_t *queue;
+	kslist_node_t *head;
+	long len;
 
 	//
 	node = malloc(sizeof(rcu_node_t));
-	if (!node)
+	if (!node) {
+		rcu_synchronize(rcu);
+		fn(ptr);
 		return;
+	}
 
 	//
 	node->fn	= fn;
 	node->ptr	= ptr;
 
-	//
-	pthread_mutex_lock(&rcu->lock);
-	kslist_push_head(&rcu->cbs, &node->node);
-	pthread_mutex_unlock(&rcu->lock);
+	/******************************************************
+	 * Lockless push on the thread queue
+	 ******************************************************/
+	queue = __rcu_queue_of(rcu);
+	head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+	do {
+		node->node.next = head;
+	} while (!atomic_compare_exchange_weak_explicit(&queue->head, &head,
+				&node->node, memory_order_release, memory_order_relaxed));
+
+	len = atomic_fetch_add_explicit(&queue->len, 1, memory_order_relaxed) + 1;
+
+	if (!(rcu->flags & RCU_RECLAIM_THREAD))
+		return;
+
+	/******************************************************
+	 * First callback of an empty queue starts the period
+	 * of an idle reclaimer, large batches wake it early
+	 ******************************************************/
+	if (!head || len == RCU_BATCH_MAX) {
+		pthread_mutex_lock(&rcu->reclaim_lock);
+		if (head)
+			rcu->wake = true;
+		pthread_cond_signal(&rcu->reclaim_cond);
+		pthread_mutex_unlock(&rcu->reclaim_lock);
+	}
 }
 
 
 /*****************************************************************************/
 
 /**
- * Cleanup unused objects.
+ * Cleanup unused objects (scheduled before a rcu_synchronize() call).
  *
  * @rcu	: Rcu context.
  */
 void rcu_cleanup(rcu_ctx_t *rcu)
 {
-	rcu_node_t *_node;
-	kslist_head_t *_it, *_tmp;
+	__rcu_run(__rcu_collect(rcu));
+}
 
-	//
-	pthread_mutex_lock(&rcu->lock);
-	_it = kslist_get_head(&rcu->cbs);
-	kslist_head_init(&rcu->cbs);;
-	pthread_mutex_unlock(&rcu->lock);
+/**
+ * Wait until all callbacks scheduled before this call are called. Without a
+ * reclaimer thread, the callbacks are called by the caller.
+ *
+ * @rcu	: Rcu context.
+ */
+void rcu_barrier(rcu_ctx_t *rcu)
+{
+	kslist_node_t *batch;
+	uint64_t req;
 
 	//
-	_tmp = _it;
-	while (_it) {
-		_it = _it->next;
-
-		//
-		_node = kslist_entry(_tmp, rcu_node_t, node);
-		_node->fn(_node->ptr);
+	if (!(rcu->flags & RCU_RECLAIM_THREAD)) {
+		batch = __rcu_collect(rcu);
+		if (batch) {
+			rcu_synchronize(rcu);
+			__rcu_run(batch);
+		}
 
-		//
-		free(_node);
-		_tmp = _it;
+		return;
 	}
+
+	/******************************************************
+	 * Wait for a reclaimer batch started after this point
+	 ******************************************************/
+	pthread_mutex_lock(&rcu->reclaim_lock);
+
+	req = ++rcu->barrier_req;
+	rcu->wake = true;
+	pthread_cond_signal(&rcu->reclaim_cond);
+
+	while (rcu->barrier_done < req)
+		pthread_cond_wait(&rcu->barrier_cond, &rcu->reclaim_lock);
+
+	pthread_mutex_unlock(&rcu->reclaim_lock);
 }
@@ -3,41 +3,399 @@
  * Copyright (C) 2025 Lazar Razvan.
  */
 
+#define _GNU_SOURCE
+
 #include <sched.h>
 #include <stdio.h>
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "synchronization/rwlock.h"
 
 
+/*****************************************************************************/
+
+static inline void __futex_wait(atomic_int *addr, int val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static inline void __futex_wake_all(atomic_int *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+
 /*****************************************************************************/
 
 /**
- * Create a new read-write lock.
+ * Wait until `ready` (with argument `arg`) is true: spin with exponential
+ * backoff first, then sleep on the release sequence.
+ */
+static void __rwlock_wait(rwlock_t *rwlock,
+						bool (*ready)(rwlock_t *, unsigned int), unsigned int arg)
+{
+	int seq, backoff = 1;
+	bool done;
+
+	/******************************************************
+	 * Bounded spinning
+	 ******************************************************/
+	for (int i = 0; i < RWLOCK_SPIN_MAX; i++) {
+		if (ready(rwlock, arg))
+			return;
+
+		rwlock_pause(backoff);
+		backoff = MIN(2 * backoff, RWLOCK_BACKOFF_MAX);
+	}
+
+	/******************************************************
+	 * Sleep. Sleeper is visible before the last attempt,
+	 * so a release after it sees the sleeper and wakes it
+	 * (or changes seq and the wait returns at once).
+	 ******************************************************/
+	while (1) {
+		seq = atomic_load_explicit(&rwlock->seq, memory_order_acquire);
+
+		atomic_fetch_add_explicit(&rwlock->sleepers, 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);
+
+		done = ready(rwlock, arg);
+		if (!done)
+			__futex_wait(&rwlock->seq, seq);
+
+		atomic_fetch_sub_explicit(&rwlock->sleepers, 1, memory_order_relaxed);
+
+		if (done || ready(rwlock, arg))
+			return;
+	}
+}
+
+/**
+ * Lock may be available, wake all sleepers (no system call without them).
+ */
+static inline void __rwlock_wake(rwlock_t *rwlock)
+{
+	atomic_fetch_add_explicit(&rwlock->seq, 1, memory_order_release);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (atomic_load_explicit(&rwlock->sleepers, memory_order_relaxed))
+		__futex_wake_all(&rwlock->seq);
+}
+
+
+/******************************************************************************
+ * Writer preferring lock (default)
+ *****************************************************************************/
+
+static bool __rwlock_read_try(rwlock_t *rwlock, unsigned int unused)
+{
+	int c;
+
+	// prevent new reader if there is a waiting writer
+	if (atomic_load_explicit(&rwlock->writers, memory_order_acquire))
+		return false;
+
+	// no writer holds the lock
+	c = atomic_load_explicit(&rwlock->cnt, memory_order_acquire);
+	while (c >= 0) {
+		if (atomic_compare_exchange_weak_explicit(&rwlock->cnt, &c, c + 1,
+							memory_order_acquire, memory_order_relaxed))
+			return true;
+	}
+
+	return false;
+}
+
+static bool __rwlock_write_try(rwlock_t *rwlock, unsigned int unused)
+{
+	int x = 0;
+
+	return atomic_compare_exchange_strong_explicit(&rwlock->cnt, &x, -1,
+							memory_order_acquire, memory_order_relaxed);
+}
+
+// upgrading reader is the last one
+static bool __rwlock_upgrade_try(rwlock_t *rwlock, unsigned int unused)
+{
+	int x = 1;
+
+	return atomic_compare_exchange_strong_explicit(&rwlock->cnt, &x, -1,
+							memory_order_acquire, memory_order_relaxed);
+}
+
+static void __rwlock_read_unlock(rwlock_t *rwlock)
+{
+	int c;
+
+	// last reader (or last but the upgrading one), writers may proceed
+	c = atomic_fetch_sub(&rwlock->cnt, 1);
+	if (c == 1 || (c == 2 && atomic_load(&rwlock->upgrading)))
+		__rwlock_wake(rwlock);
+}
+
+static int __rwlock_upgrade(rwlock_t *rwlock)
+{
+	int x = 0;
+
+	// one upgrade at a time, two would wait for each other
+	if (!atomic_compare_exchange_strong(&rwlock->upgrading, &x, 1))
+		return -1;
+
+	// block new readers, wait for the others to finish
+	atomic_fetch_add(&rwlock->writers, 1);
+
+	if (!__rwlock_upgrade_try(rwlock, 0))
+		__rwlock_wait(rwlock, __rwlock_upgrade_try, 0);
+
+	atomic_fetch_sub(&rwlock->writers, 1);
+	atomic_store(&rwlock->upgrading, 0);
+
+	return 0;
+}
+
+
+/******************************************************************************
+ * Phase fair lock (RWLOCK_FAIR)
+ *****************************************************************************/
+
+// writer bits changed (writer gone, or next writer waiting for this reader)
+static bool __pf_read_ready(rwlock_t *rwlock, unsigned int w)
+{
+	return (atomic_load_explicit(&rwlock->rin, memory_order_acquire) &
+			RWLOCK_PF_WBITS) != w;
+}
+
+// writer ticket is served
+static bool __pf_write_turn(rwlock_t *rwlock, unsigned int ticket)
+{
+	return atomic_load_explicit(&rwlock->wout, memory_order_acquire) == ticket;
+}
+
+// readers entered before the writer are gone
+static bool __pf_readers_done(rwlock_t *rwlock, unsigned int rticket)
+{
+	return atomic_load(&rwlock->rout) == rticket;
+}
+
+static void __pf_read_lock(rwlock_t *rwlock)
+{
+	unsigned int w;
+
+	// enter, wait for the writer present at arrival only
+	w = atomic_fetch_add(&rwlock->rin, RWLOCK_PF_RINC) & RWLOCK_PF_WBITS;
+
+	if (w && !__pf_read_ready(rwlock, w))
+		__rwlock_wait(rwlock, __pf_read_ready, w);
+}
+
+static void __pf_read_unlock(rwlock_t *rwlock)
+{
+	atomic_fetch_add(&rwlock->rout, RWLOCK_PF_RINC);
+
+	// a writer waits for readers to leave
+	if (atomic_load(&rwlock->rin) & RWLOCK_PF_PRES)
+		__rwlock_wake(rwlock);
+}
+
+static int __pf_read_trylock(rwlock_t *rwlock)
+{
+	unsigned int w;
+
+	//
+	if (atomic_load_explicit(&rwlock->rin, memory_order_acquire) &
+		RWLOCK_PF_WBITS)
+		return -1;
+
+	w = atomic_fetch_add(&rwlock->rin, RWLOCK_PF_RINC) & RWLOCK_PF_WBITS;
+	if (!w)
+		return 0;
+
+	// writer came first, leave as a finished reader
+	__pf_read_unlock(rwlock);
+
+	return -1;
+}
+
+/**
+ * Block new readers and wait for the readers entered before (but `self`
+ * readers of the caller).
+ */
+static void __pf_write_readers(rwlock_t *rwlock, unsigned int ticket,
+								unsigned int self)
+{
+	unsigned int rticket;
+
+	rticket = atomic_fetch_add(&rwlock->rin,
+					RWLOCK_PF_PRES | (ticket & RWLOCK_PF_PHID)) & ~RWLOCK_PF_WBITS;
+	rticket -= self * RWLOCK_PF_RINC;
+
+	if (!__pf_readers_done(rwlock, rticket))
+		__rwlock_wait(rwlock, __pf_readers_done, rticket);
+}
+
+static void __pf_write_lock(rwlock_t *rwlock)
+{
+	unsigned int ticket;
+
+	// writers in ticket order
+	ticket = atomic_fetch_add(&rwlock->win, 1);
+
+	if (!__pf_write_turn(rwlock, ticket))
+		__rwlock_wait(rwlock, __pf_write_turn, ticket);
+
+	__pf_write_readers(rwlock, ticket, 0);
+}
+
+static void __pf_write_unlock(rwlock_t *rwlock)
+{
+	// readers phase, then next writer
+	atomic_fetch_and(&rwlock->rin, ~RWLOCK_PF_WBITS);
+	atomic_fetch_add(&rwlock->wout, 1);
+
+	__rwlock_wake(rwlock);
+}
+
+/**
+ * Take the writer ticket only if no writer is queued or holds the lock.
+ */
+static bool __pf_write_ticket_try(rwlock_t *rwlock, unsigned int *ticket)
+{
+	*ticket = atomic_load(&rwlock->wout);
+
+	return atomic_compare_exchange_strong(&rwlock->win, ticket, *ticket + 1);
+}
+
+static int __pf_write_trylock(rwlock_t *rwlock)
+{
+	unsigned int ticket, rticket;
+
+	//
+	if (!__pf_write_ticket_try(rwlock, &ticket))
+		return -1;
+
+	rticket = atomic_fetch_add(&rwlock->rin,
+					RWLOCK_PF_PRES | (ticket & RWLOCK_PF_PHID)) & ~RWLOCK_PF_WBITS;
+	if (__pf_readers_done(rwlock, rticket))
+		return 0;
+
+	// readers in progress, give the turn back
+	__pf_write_unlock(rwlock);
+
+	return -1;
+}
+
+static int __pf_upgrade(rwlock_t *rwlock)
+{
+	unsigned int ticket;
+
+	// a queued writer waits for this reader, it must go first
+	if (!__pf_write_ticket_try(rwlock, &ticket))
+		return -1;
+
+	// wait for the other readers, then leave as reader
+	__pf_write_readers(rwlock, ticket, 1);
+	atomic_fetch_add(&rwlock->rout, RWLOCK_PF_RINC);
+
+	return 0;
+}
+
+static void __pf_downgrade(rwlock_t *rwlock)
+{
+	unsigned int w;
+
+	// enter as reader and clear writer bits at once, then next writer
+	w = atomic_load(&rwlock->rin) & RWLOCK_PF_WBITS;
+	atomic_fetch_add(&rwlock->rin, RWLOCK_PF_RINC - w);
+	atomic_fetch_add(&rwlock->wout, 1);
+
+	__rwlock_wake(rwlock);
+}
+
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+
+/**
+ * Create a new read-write lock (writer preferring).
  *
  * Return the lock on success or NULL on error.
  */
 rwlock_t *rwlock_create(void)
+{
+	return rwlock_create_flags(0);
+}
+
+/**
+ * Create a new read-write lock.
+ *
+ * @flags	: RWLOCK_FAIR or 0.
+ *
+ * Return the lock on success or NULL on error.
+ */
+rwlock_t *rwlock_create_flags(uint32_t flags)
 {
 	rwlock_t *rwlock = NULL;
 
 	//
+	if (flags & ~RWLOCK_FLAGS_MASK)
+		goto finish;
+
 	if (posix_memalign((void **)&rwlock, CACHE_LINE_SIZE, (sizeof(rwlock_t))))
 		goto finish;
 
 	//
-	atomic_store_explicit(&rwlock->cnt, 0, memory_order_release);
-	atomic_store_explicit(&rwlock->writers, 0, memory_order_release);
+	rwlock_init_flags(rwlock, flags);
 
 finish:
 	return rwlock;
 }
 
+/**
+ * Initialize a read-write lock (embedded in another structure).
+ *
+ * @rwlock	: Read-write lock.
+ */
+void rwlock_init(rwlock_t *rwlock)
+{
+	rwlock_init_flags(rwlock, 0);
+}
+
+/**
+ * Initialize a read-write lock (embedded in another structure).
+ *
+ * @rwlock	: Read-write lock.
+ * @flags	: RWLOCK_FAIR or 0.
+ */
+void rwlock_init_flags(rwlock_t *rwlock, uint32_t flags)
+{
+	rwlock->flags = flags;
+
+	//
+	atomic_store_explicit(&rwlock->cnt, 0, memory_order_release);
+	atomic_store_explicit(&rwlock->writers, 0, memory_order_release);
+	atomic_store_explicit(&rwlock->upgrading, 0, memory_order_release);
+
+	//
+	atomic_store_explicit(&rwlock->rin, 0, memory_order_release);
+	atomic_store_explicit(&rwlock->rout, 0, memory_order_release);
+	atomic_store_explicit(&rwlock->win, 0, memory_order_release);
+	atomic_store_explicit(&rwlock->wout, 0, memory_order_release);
+
+	//
+	atomic_store_explicit(&rwlock->seq, 0, memory_order_release);
+	atomic_store_explicit(&rwlock->sleepers, 0, memory_order_release);
+}
+
 
 /**
  * Free memory for a read-write lock.
@@ -57,46 +415,34 @@ void rwlock_destroy(rwlock_t *rwlock)
  */
 void rwlock_read_lock(rwlock_t *rwlock)
 {
-	int c;
-
-	while (1) {
-		// prevent new reader if there is a wating writer
-		if (atomic_load_explicit(&rwlock->writers, memory_order_acquire)) {
-			sched_yield();
-			continue;
-		}
-
-		do {
-			// wait for writer to finish
-			while ((c = atomic_load_explicit(&rwlock->cnt, memory_order_acquire)) < 0)
-				sched_yield();
-		} while (!atomic_compare_exchange_weak(&rwlock->cnt, &c, c + 1));
-
-		break;
+	//
+	if (rwlock->flags & RWLOCK_FAIR) {
+		__pf_read_lock(rwlock);
+		return;
 	}
+
+	// uncontended
+	if (__rwlock_read_try(rwlock, 0))
+		return;
+
+	// wait for writers to finish
+	__rwlock_wait(rwlock, __rwlock_read_try, 0);
 }
 
 /**
  * Try to acquire a read lock.
  *
  * @rwlock	: Read-write lock.
+ *
+ * Return 0 on success and <0 if a writer holds or waits for the lock.
  */
 int rwlock_read_trylock(rwlock_t *rwlock)
 {
-	int c;
-
-	// stop if any writer is waiting
-	if (atomic_load_explicit(&rwlock->writers, memory_order_acquire))
-		return -1;
-
-	do {
-		// stop if any writer holds the lock
-		c = atomic_load_explicit(&rwlock->cnt, memory_order_acquire);
-		if (c < 0)
-			return -1;
-	} while (!atomic_compare_exchange_weak(&rwlock->cnt, &c, c + 1));
+	//
+	if (rwlock->flags & RWLOCK_FAIR)
+		return __pf_read_trylock(rwlock);
 
-	return 0;
+	return __rwlock_read_try(rwlock, 0) ? 0 : -1;
 }
 
 /**
@@ -106,7 +452,10 @@ int rwlock_read_trylock(rwlock_t *rwlock)
  */
 void rwlock_read_unlock(rwlock_t *rwlock)
 {
-	atomic_fetch_sub(&rwlock->cnt, 1);
+	if (rwlock->flags & RWLOCK_FAIR)
+		__pf_read_unlock(rwlock);
+	else
+		__rwlock_read_unlock(rwlock);
 }
 
 
@@ -119,16 +468,18 @@ void rwlock_read_unlock(rwlock_t *rwlock)
  */
 void rwlock_write_lock(rwlock_t *rwlock)
 {
-	int x = 0;
+	//
+	if (rwlock->flags & RWLOCK_FAIR) {
+		__pf_write_lock(rwlock);
+		return;
+	}
 
 	// new waiting writer
 	atomic_fetch_add(&rwlock->writers, 1);
 
 	// wait for readers to finish
-	while (!atomic_compare_exchange_weak(&rwlock->cnt, &x, -1)) {
-		x = 0;
-		sched_yield();
-	}
+	if (!__rwlock_write_try(rwlock, 0))
+		__rwlock_wait(rwlock, __rwlock_write_try, 0);
 
 	// waiting writer serviced
 	atomic_fetch_sub(&rwlock->writers, 1);
@@ -138,28 +489,20 @@ void rwlock_write_lock(rwlock_t *rwlock)
  * Try to acquire a write lock.
  *
  * @rwlock	: Read-write lock.
+ *
+ * Return 0 on success and <0 if the lock is held or writers wait for it.
  */
 int rwlock_write_trylock(rwlock_t *rwlock)
 {
-	int x = 0;
-
-	// new waiting writer
-	atomic_fetch_add(&rwlock->writers, 1);
-
-	// writers already waiting
-	if (atomic_load_explicit(&rwlock->writers, memory_order_acquire)) {
-		atomic_fetch_sub(&rwlock->writers, 1);
-		return -1;
-	}
+	//
+	if (rwlock->flags & RWLOCK_FAIR)
+		return __pf_write_trylock(rwlock);
 
-	// readers in progress
-	if (!atomic_compare_exchange_strong(&rwlock->cnt, &x, -1)) {
-		atomic_fetch_sub(&rwlock->writers, 1);
+	// waiting writers go first
+	if (atomic_load_explicit(&rwlock->writers, memory_order_acquire))
 		return -1;
-	}
 
-	atomic_fetch_sub(&rwlock->writers, 1);
-	return 0;
+	return __rwlock_write_try(rwlock, 0) ? 0 : -1;
 }
 
 /**
@@ -169,5 +512,51 @@ int rwlock_write_trylock(rwlock_t *rwlock)
  */
 void rwlock_write_unlock(rwlock_t *rwlock)
 {
+	//
+	if (rwlock->flags & RWLOCK_FAIR) {
+		__pf_write_unlock(rwlock);
+		return;
+	}
+
 	atomic_store_explicit(&rwlock->cnt, 0, memory_order_release);
+	__rwlock_wake(rwlock);
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Upgrade a read lock to a write lock, without releasing it. Fails when
+ * another reader is upgrading (and, with RWLOCK_FAIR, when a writer is queued
+ * before), the caller then still holds the read lock and must release it
+ * before taking the write lock.
+ *
+ * @rwlock	: Read-write lock (read locked by the caller).
+ *
+ * Return 0 if the caller holds the write lock and <0 otherwise.
+ */
+int rwlock_upgrade(rwlock_t *rwlock)
+{
+	if (rwlock->flags & RWLOCK_FAIR)
+		return __pf_upgrade(rwlock);
+
+	return __rwlock_upgrade(rwlock);
+}
+
+/**
+ * Downgrade a write lock to a read lock, without releasing it. Waiting
+ * readers are let in.
+ *
+ * @rwlock	: Read-write lock (write locked by the caller).
+ */
+void rwlock_downgrade(rwlock_t *rwlock)
+{
+	//
+	if (rwlock->flags & RWLOCK_FAIR) {
+		__pf_downgrade(rwlock);
+		return;
+	}
+
+	atomic_store_explicit(&rwlock->cnt, 1, memory_order_release);
+	__rwlock_wake(rwlock);
 }
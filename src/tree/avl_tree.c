@@ -56,15 +56,31 @@ avl_tree_node * __avl_node_get_min_node(avl_tree_node *node)
 	return node;
 }
 
-static avl_tree_node *__avl_node_create(void *data, alloc_fn _alloc)
+static avl_tree_node *__avl_node_alloc(avl_tree_entry *entry)
+{
+	if (entry->node_cache)
+		return slab_cache_alloc(entry->node_cache, entry->cpu_id);
+
+	return (avl_tree_node *)malloc(sizeof(avl_tree_node));
+}
+
+static void __avl_node_free(avl_tree_entry *entry, avl_tree_node *node)
+{
+	if (entry->node_cache)
+		slab_cache_free(entry->node_cache, node, entry->cpu_id);
+	else
+		free(node);
+}
+
+static avl_tree_node *__avl_node_create(avl_tree_entry *entry, void *data)
 {
 	avl_tree_node *node = NULL;
 
-	node = (avl_tree_node *)malloc(sizeof(avl_tree_node));
+	node = __avl_node_alloc(entry);
 	if (!node)
 		goto error;
 
-	node->data = _alloc(data);
+	node->data = entry->_alloc(data);
 	if (!node->data)
 		goto node_free;
 
@@ -76,15 +92,15 @@ static avl_tree_node *__avl_node_create(void *data, alloc_fn _alloc)
 	return node;
 
 node_free:
-	free(node);
+	__avl_node_free(entry, node);
 error:
 	return NULL;
 }
 
-static void __avl_node_destroy(avl_tree_node *node, free_fn _free)
+static void __avl_node_destroy(avl_tree_entry *entry, avl_tree_node *node)
 {
-	_free(node->data);
-	free(node);
+	entry->_free(node->data);
+	__avl_node_free(entry, node);
 }
 
 static int __avl_node_copy_content(avl_tree_node *dst, avl_tree_node *src,
@@ -234,23 +250,23 @@ static avl_tree_node *__avl_tree_balance(avl_tree_node *node)
 	return node;
 }
 
-static avl_tree_node *__avl_tree_insert(avl_tree_node *node, void *data,
-										alloc_fn _alloc, cmp_fn _cmp)
+static avl_tree_node *__avl_tree_insert(avl_tree_entry *entry,
+										avl_tree_node *node, void *data)
 {
 	int cmp_id;
 
 	if (!node)
-		return __avl_node_create(data, _alloc);
+		return __avl_node_create(entry, data);
 
 	// node insert 
-	cmp_id = _cmp(data, node->data);
+	cmp_id = entry->_cmp(data, node->data);
 	if (cmp_id < 0) {
-		node->left = __avl_tree_insert(node->left, data, _alloc, _cmp);
+		node->left = __avl_tree_insert(entry, node->left, data);
 		if (!node->left)
 			return NULL;
 
 	} else if (cmp_id > 0) {
-		node->right = __avl_tree_insert(node->right, data, _alloc, _cmp);
+		node->right = __avl_tree_insert(entry, node->right, data);
 		if (!node->right)
 			return NULL;
 
@@ -261,9 +277,8 @@ static avl_tree_node *__avl_tree_insert(avl_tree_node *node, void *data,
 	return __avl_tree_balance(node);
 }
 
-static avl_tree_node *__avl_tree_delete(avl_tree_node *node, void *data,
-										alloc_fn _alloc, free_fn _free,
-										cmp_fn _cmp)
+static avl_tree_node *__avl_tree_delete(avl_tree_entry *entry,
+										avl_tree_node *node, void *data)
 {
 	int cmp_id;
 	avl_tree_node *tmp;
@@ -272,21 +287,21 @@ static avl_tree_node *__avl_tree_delete(avl_tree_node *node, void *data,
 		return NULL;
 
 	// node delete
-	cmp_id = _cmp(data, node->data);
+	cmp_id = entry->_cmp(data, node->data);
 
 	// left lookup
 	if (cmp_id < 0)
-		node->left = __avl_tree_delete(node->left, data, _alloc, _free, _cmp);
+		node->left = __avl_tree_delete(entry, node->left, data);
 
 	// right lookup
 	if (cmp_id > 0)
-		node->right = __avl_tree_delete(node->right, data, _alloc, _free, _cmp);
+		node->right = __avl_tree_delete(entry, node->right, data);
 
 	// node deletion
 	if (cmp_id == 0) {
 		// leaf node
 		if (__avl_node_is_leaf(node)) {
-			__avl_node_destroy(node, _free);
+			__avl_node_destroy(entry, node);
 			return NULL;
 		}
 
@@ -295,22 +310,22 @@ static avl_tree_node *__avl_tree_delete(avl_tree_node *node, void *data,
 			tmp = node->left ? node->left : node->right;
 
 			//
-			if (__avl_node_copy_content(node, tmp, _alloc, _free))
+			if (__avl_node_copy_content(node, tmp, entry->_alloc,
+										entry->_free))
 				return NULL;
 
 			//
-			__avl_node_destroy(tmp, _free);
+			__avl_node_destroy(entry, tmp);
 		} else {
 			// node with two children (replace data with right subtree min)
 			tmp = __avl_node_get_min_node(node->right);
 
 			//
-			if (__avl_node_copy_data(node, tmp, _alloc, _free))
+			if (__avl_node_copy_data(node, tmp, entry->_alloc, entry->_free))
 				return NULL;
 
 			//
-			node->right = __avl_tree_delete(node->right, tmp->data, _alloc,
-											_free, _cmp);
+			node->right = __avl_tree_delete(entry, node->right, tmp->data);
 		}
 	}
 
@@ -339,16 +354,16 @@ static int __avl_tree_lookup(avl_tree_node *node, void *data, cmp_fn _cmp)
 	return 1;
 }
 
-static void __avl_tree_destroy(avl_tree_node *node, free_fn _free)
+static void __avl_tree_destroy(avl_tree_entry *entry, avl_tree_node *node)
 {
 	if (!node)
 		return;
 
-	__avl_tree_destroy(node->left, _free);
-	__avl_tree_destroy(node->right, _free);
+	__avl_tree_destroy(entry, node->left);
+	__avl_tree_destroy(entry, node->right);
 
 	//
-	__avl_node_destroy(node, _free);
+	__avl_node_destroy(entry, node);
 }
 
 static void __avl_tree_in_order_print(avl_tree_node *node, print_fn _print)
@@ -433,9 +448,34 @@ static void __avl_tree_level_order_print(avl_tree_node *node, print_fn _print)
  */
 avl_tree_entry *avl_tree_create(alloc_fn _alloc, free_fn _free, cmp_fn _cmp,
 								print_fn _print)
+{
+	return avl_tree_create_slab(_alloc, _free, _cmp, _print, NULL, 0);
+}
+
+/**
+ * Create an AVL tree entry, allocating nodes from a slab cache.
+ *
+ * @_alloc		: Function to create node inforation.
+ * @_free		: Function to free node inforation.
+ * @_cmp		: Function to compare to node information.
+ * @_print		: Function to print node information.
+ * @node_cache	: Slab cache for nodes (obj_size >= sizeof(avl_tree_node)), or
+ *				  NULL to use malloc.
+ * @cpu_id		: Core id used for slab cache operations.
+ *
+ * Return new allocated entry on success and false otherwise.
+ */
+avl_tree_entry *avl_tree_create_slab(alloc_fn _alloc, free_fn _free,
+									cmp_fn _cmp, print_fn _print,
+									slab_cache_t *node_cache, int cpu_id)
 {
 	avl_tree_entry *entry = NULL;
 
+	//
+	if (node_cache && (node_cache->obj_size < sizeof(avl_tree_node) ||
+		(cpu_id != SLAB_CPU_ANY && (cpu_id < 0 || cpu_id >= MAX_CPUS))))
+		return NULL;
+
 	// create entry
 	entry = (avl_tree_entry *)malloc(sizeof(avl_tree_entry));
 	if (!entry)
@@ -448,6 +488,10 @@ avl_tree_entry *avl_tree_create(alloc_fn _alloc, free_fn _free, cmp_fn _cmp,
 	entry->_cmp		= _cmp;
 	entry->_print	= _print;
 
+	//
+	entry->node_cache	= node_cache;
+	entry->cpu_id		= cpu_id;
+
 	return entry;
 }
 
@@ -459,7 +503,7 @@ void avl_tree_destroy(avl_tree_entry *entry)
 	if (!entry || !entry->_free)
 		return;
 
-	__avl_tree_destroy(entry->root, entry->_free);
+	__avl_tree_destroy(entry, entry->root);
 	free(entry);
 }
 
@@ -477,7 +521,7 @@ int avl_tree_insert(avl_tree_entry *entry, void *data)
 		goto error;
 
 	//
-	node = __avl_tree_insert(entry->root, data, entry->_alloc, entry->_cmp);
+	node = __avl_tree_insert(entry, entry->root, data);
 	if (!node)
 		goto error;	// do not alter the root
 
@@ -499,9 +543,16 @@ int avl_tree_delete(avl_tree_entry *entry, void *data)
 	if (!entry || !data || !entry->_alloc || !entry->_free || !entry->_cmp)
 		goto error;
 
+	// last node (empty tree is not an error)
+	if (entry->root && __avl_node_is_leaf(entry->root) &&
+		entry->_cmp(data, entry->root->data) == 0) {
+		__avl_node_destroy(entry, entry->root);
+		entry->root = NULL;
+		return 0;
+	}
+
 	//
-	node = __avl_tree_delete(entry->root, data, entry->_alloc, entry->_free,
-							entry->_cmp);
+	node = __avl_tree_delete(entry, entry->root, data);
 	if (!node)
 		goto error;	// do not alter the root
 
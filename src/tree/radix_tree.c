@@ -69,16 +69,37 @@ __node_children(radix_tree_node_t *node)
 	return cnt;
 }
 
+/**
+ * Alloc (free) memory for a node, from tree node cache if any.
+ */
+static inline radix_tree_node_t *
+__node_alloc(radix_tree_t *tree)
+{
+	if (tree->node_cache)
+		return slab_cache_alloc(tree->node_cache, tree->cpu_id);
+
+	return (radix_tree_node_t *)malloc(sizeof(radix_tree_node_t));
+}
+
+static inline void
+__node_free(radix_tree_t *tree, radix_tree_node_t *node)
+{
+	if (tree->node_cache)
+		slab_cache_free(tree->node_cache, node, tree->cpu_id);
+	else
+		free(node);
+}
+
 /**
  * Create a node in radix tree.
  */
 static inline radix_tree_node_t *
-__node_create(char *prefix, void *data, alloc_fn _alloc)
+__node_create(radix_tree_t *tree, char *prefix, void *data)
 {
 	radix_tree_node_t *node = NULL;
 
 	//
-	node = (radix_tree_node_t *)malloc(sizeof(radix_tree_node_t));
+	node = __node_alloc(tree);
 	if (!node)
 		goto error;
 
@@ -96,7 +117,7 @@ __node_create(char *prefix, void *data, alloc_fn _alloc)
 
 	//
 	if (data) {
-		node->data = _alloc(data);
+		node->data = tree->_alloc(data);
 		if (!node->data)
 			goto prefix_free;
 	}
@@ -106,7 +127,7 @@ __node_create(char *prefix, void *data, alloc_fn _alloc)
 prefix_free:
 	free(node->prefix);
 node_free:
-	free(node);
+	__node_free(tree, node);
 error:
 	return NULL;
 }
@@ -115,22 +136,22 @@ error:
  * Free a node from radix tree.
  */
 static inline void
-__node_destroy(radix_tree_node_t *node, free_fn _free)
+__node_destroy(radix_tree_t *tree, radix_tree_node_t *node)
 {
 	if (!node)
 		return;
 
 	//
-	_free(node->data);
+	tree->_free(node->data);
 	free(node->prefix);
-	free(node);
+	__node_free(tree, node);
 }
 
 /**
  * Remove obosolete paths for a node.
  */
 static inline void
-__node_cleanup(radix_tree_node_t *node, free_fn _free)
+__node_cleanup(radix_tree_t *tree, radix_tree_node_t *node)
 {
 	radix_tree_node_t *it;
 
@@ -144,7 +165,7 @@ __node_cleanup(radix_tree_node_t *node, free_fn _free)
 
 		if (__node_children(it) == 0 && !it->data) {
 			node->children[i] = NULL;
-			__node_destroy(it, _free);
+			__node_destroy(tree, it);
 		}
 	}
 }
@@ -153,7 +174,7 @@ __node_cleanup(radix_tree_node_t *node, free_fn _free)
  * Split a node in radix tree based on prefix len.
  */
 static inline int
-__node_split(radix_tree_node_t *node, int prefix_len, alloc_fn _alloc)
+__node_split(radix_tree_t *tree, radix_tree_node_t *node, int prefix_len)
 {
 	int child_index;
 	radix_tree_node_t *child_node;
@@ -166,7 +187,7 @@ __node_split(radix_tree_node_t *node, int prefix_len, alloc_fn _alloc)
 	child_index = (unsigned char)*(node->prefix + prefix_len);
 
 	// create child node
-	child_node = __node_create(node->prefix + prefix_len, NULL, _alloc);
+	child_node = __node_create(tree, node->prefix + prefix_len, NULL);
 	if (!child_node)
 		return -1;
 
@@ -192,7 +213,7 @@ __node_split(radix_tree_node_t *node, int prefix_len, alloc_fn _alloc)
  * his child are not user defined nodes).
  */
 static inline int
-__node_merge(radix_tree_node_t *node, free_fn _free)
+__node_merge(radix_tree_t *tree, radix_tree_node_t *node)
 {
 	int i;
 	radix_tree_node_t *child = NULL;
@@ -225,7 +246,7 @@ __node_merge(radix_tree_node_t *node, free_fn _free)
 	memcpy(node->children, child->children, sizeof(child->children));
 
 	// free child node
-	__node_destroy(child, _free);
+	__node_destroy(tree, child);
 
 	return 0;
 }
@@ -241,8 +262,8 @@ __node_merge(radix_tree_node_t *node, free_fn _free)
  * Insert a node in radix tree.
  */
 static inline int
-__radix_tree_insert(radix_tree_node_t *node, char *key, void *data,
-					alloc_fn _alloc)
+__radix_tree_insert(radix_tree_t *tree, radix_tree_node_t *node, char *key,
+					void *data)
 {
 	int index, prefix_len;
 	radix_tree_node_t *new_node, *it;
@@ -256,7 +277,7 @@ __radix_tree_insert(radix_tree_node_t *node, char *key, void *data,
 
 		// path not found (create node with remaining key as prefix)
 		if (!it->children[index]) {
-			new_node = __node_create(key, data, _alloc);
+			new_node = __node_create(tree, key, data);
 			if (!new_node)
 				return -1;
 
@@ -274,7 +295,7 @@ __radix_tree_insert(radix_tree_node_t *node, char *key, void *data,
 
 		// shorther prefix, split current node
 		if (prefix_len < strlen(it->prefix)) {
-			if (__node_split(it, prefix_len, _alloc))
+			if (__node_split(tree, it, prefix_len))
 				return -2;
 		}
 
@@ -284,7 +305,7 @@ __radix_tree_insert(radix_tree_node_t *node, char *key, void *data,
 				return -3;	// already existing
 
 			// node become user defined node
-			it->data = _alloc(data);
+			it->data = tree->_alloc(data);
 			if (!it->data)
 				return -3;
 
@@ -304,7 +325,7 @@ finish:
  * intermediate node (data is set).
  */
 static inline int
-__radix_tree_remove(radix_tree_node_t *node, char *key, free_fn _free)
+__radix_tree_remove(radix_tree_t *tree, radix_tree_node_t *node, char *key)
 {
 	int index, prefix_len;
 	radix_tree_node_t *it;
@@ -335,12 +356,12 @@ __radix_tree_remove(radix_tree_node_t *node, char *key, free_fn _free)
 		if (__node_children(it) == 0) {
 			// no children, remove it from tree and try compacting the tree
 			node->children[index] = NULL;
-			__node_destroy(it, _free);
+			__node_destroy(tree, it);
 
 			goto compact_tree;
 		} else {
 			// there are children, only free data
-			_free(it->data);
+			tree->_free(it->data);
 			it->data = NULL;
 
 			goto finish;
@@ -348,18 +369,18 @@ __radix_tree_remove(radix_tree_node_t *node, char *key, free_fn _free)
 	}
 
 	// continue recursion
-	if (__radix_tree_remove(it, key + prefix_len, _free))
+	if (__radix_tree_remove(tree, it, key + prefix_len))
 		return -4;
 
 compact_tree:
 	// cleanup empty paths in root (not user defined nodes)
 	if (!node->prefix) {
-		__node_cleanup(node, _free);
+		__node_cleanup(tree, node);
 
 		goto finish;
 	}
 
-	return __node_merge(node, _free);
+	return __node_merge(tree, node);
 
 finish:
 	return 0;
@@ -409,7 +430,7 @@ __radix_tree_lookup(radix_tree_node_t *node, char *key)
  * Free memory for radix tree.
  */
 static inline void
-__radix_tree_destroy(radix_tree_node_t *node, free_fn _free)
+__radix_tree_destroy(radix_tree_t *tree, radix_tree_node_t *node)
 {
 	if (!node)
 		return;
@@ -417,11 +438,11 @@ __radix_tree_destroy(radix_tree_node_t *node, free_fn _free)
 	//
 	for (int i = 0; i < RADIX; i++) {
 		if (node->children[i])
-			__radix_tree_destroy(node->children[i], _free);
+			__radix_tree_destroy(tree, node->children[i]);
 	}
 
 	//
-	__node_destroy(node, _free);
+	__node_destroy(tree, node);
 }
 
 /**
@@ -465,6 +486,25 @@ __radix_tree_dump(radix_tree_node_t *node, print_fn _print, int level)
  */
 radix_tree_t *radix_tree_init(alloc_fn _alloc, print_fn _print,
 							free_fn _free)
+{
+	return radix_tree_init_slab(_alloc, _print, _free, NULL, 0);
+}
+
+/**
+ * Initialize a radix tree, allocating nodes from a slab cache.
+ *
+ * @_alloc		: Data allocation function.
+ * @_print		: Data print function.
+ * @_free		: Data free function.
+ * @node_cache	: Slab cache for nodes (obj_size >= sizeof(radix_tree_node_t)),
+ *				  or NULL to use malloc.
+ * @cpu_id		: Core id used for slab cache operations.
+ *
+ * Return radix tree pointer on success and NULL on error.
+ */
+radix_tree_t *radix_tree_init_slab(alloc_fn _alloc, print_fn _print,
+								free_fn _free, slab_cache_t *node_cache,
+								int cpu_id)
 {
 	radix_tree_t *tree = NULL;
 
@@ -472,21 +512,29 @@ radix_tree_t *radix_tree_init(alloc_fn _alloc, print_fn _print,
 	if (!_alloc || !_print || !_free)
 		goto error;
 
+	if (node_cache && (node_cache->obj_size < sizeof(radix_tree_node_t) ||
+		(cpu_id != SLAB_CPU_ANY && (cpu_id < 0 || cpu_id >= MAX_CPUS))))
+		goto error;
+
 	//
 	tree = (radix_tree_t *)malloc(sizeof(radix_tree_t));
 	if (!tree)
 		goto error;
 
-	//
-	tree->root = __node_create(NULL, NULL, _alloc);
-	if (!tree->root)
-		goto tree_free;
-
 	//
 	tree->_alloc = _alloc;
 	tree->_print = _print;
 	tree->_free = _free;
 
+	//
+	tree->node_cache = node_cache;
+	tree->cpu_id = cpu_id;
+
+	//
+	tree->root = __node_create(tree, NULL, NULL);
+	if (!tree->root)
+		goto tree_free;
+
 	return tree;
 
 tree_free:
@@ -507,7 +555,7 @@ void radix_tree_destroy(radix_tree_t *tree)
 
 	//
 	assert(tree->_free);
-	__radix_tree_destroy(tree->root, tree->_free);
+	__radix_tree_destroy(tree, tree->root);
 
 	//
 	free(tree);
@@ -525,7 +573,7 @@ int radix_tree_insert(radix_tree_t *tree, char *key, void *data)
 	if (!tree || !tree->root || !tree->_alloc || !key || !strlen(key) || !data)
 		return -1;
 
-	return __radix_tree_insert(tree->root, key, data, tree->_alloc);
+	return __radix_tree_insert(tree, tree->root, key, data);
 }
 
 /**
@@ -540,7 +588,7 @@ int radix_tree_remove(radix_tree_t *tree, char *key)
 	if (!tree || !tree->root || !tree->_free || !key || !strlen(key))
 		return -1;
 
-	return __radix_tree_remove(tree->root, key, tree->_free);
+	return __radix_tree_remove(tree, tree->root, key);
 }
 
 /**
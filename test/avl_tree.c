@@ -53,6 +53,7 @@ void avl_tree_print(void *data)
 int main()
 {
 	avl_tree_entry *avl_tree;
+	slab_cache_t *cache = NULL;
 	int data_insert[] = {
 		10, 20, 30, 40, 50, 60, 70, 80, 90, 100,
 		110, 120, 5, 15, 25, 35, 45, 55, 65, 75,
@@ -121,8 +122,49 @@ int main()
 		}
 	}
 
+	avl_tree_destroy(avl_tree);
+
+	// nodes allocated from a slab cache, insert / delete churn
+	cache = slab_cache_create(sizeof(avl_tree_node), "avl_node");
+	if (!cache) {
+		fprintf(stderr, "Fail to create slab cache!\n");
+		goto finish;
+	}
+
+	avl_tree = avl_tree_create_slab(avl_tree_alloc, avl_tree_free,
+									avl_tree_compare, avl_tree_print, cache, 0);
+	if (!avl_tree) {
+		fprintf(stderr, "Fail to create AVL tree!\n");
+		goto cache_destroy;
+	}
+
+	for (int round = 0; round < 4; round++) {
+		for (int i = 0; i < data_insert_size; i++) {
+			if (avl_tree_insert(avl_tree, &data_insert[i])) {
+				fprintf(stderr, "Fail to add node [%d]!\n", data_insert[i]);
+				goto tree_destroy;
+			}
+		}
+
+		for (int i = 0; i < data_insert_size; i++) {
+			if (avl_tree_delete(avl_tree, &data_insert[i])) {
+				fprintf(stderr, "Fail to del node [%d]!\n", data_insert[i]);
+				goto tree_destroy;
+			}
+		}
+
+		if (avl_tree->root) {
+			fprintf(stderr, "AVL tree not empty!\n");
+			goto tree_destroy;
+		}
+	}
+
+	printf("Slab backed AVL tree churn done!\n");
+
 tree_destroy:
 	avl_tree_destroy(avl_tree);
+cache_destroy:
+	slab_cache_destroy(cache);
 finish:
 	return 0;
 }
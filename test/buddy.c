@@ -8,10 +8,21 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 
 #include "allocator/buddy.h"
 
 
+/*****************************************************************************/
+
+// 32 pages arena
+#define TEST_ORDERS			5
+#define TEST_MEM			((1 << TEST_ORDERS) * PAGE_SIZE)
+
+
 /*****************************************************************************/
 
 static uint32_t __generate_random_size(uint32_t min, uint32_t max)
@@ -70,7 +81,7 @@ __buddy_exceed_slots_for_order(buddy_t *buddy, uint8_t order)
 	srand(time(NULL));
 
 	// alloc
-	for (int i = 0; i <= ((1 << (BUDDY_ORDERS - order)) - 1); i++) {
+	for (int i = 0; i <= ((1 << (TEST_ORDERS - order)) - 1); i++) {
 		arr[i] = buddy_alloc(buddy, __generate_order_size(order));
 		if (!arr[i])
 			goto failed;
@@ -82,7 +93,7 @@ __buddy_exceed_slots_for_order(buddy_t *buddy, uint8_t order)
 		goto failed;
 
 	// free
-	for (int i = 0; i <= ((1 << (BUDDY_ORDERS - order)) - 1); i++)
+	for (int i = 0; i <= ((1 << (TEST_ORDERS - order)) - 1); i++)
 		if (buddy_free(buddy, arr[i]))
 			goto failed;
 
@@ -160,7 +171,7 @@ __buddy_invalid_free(buddy_t *buddy)
 			goto failed;
 
 	// free all other order 0 pages
-	for (int i = 1; i < (1 << BUDDY_ORDERS); i++)
+	for (int i = 1; i < (1 << TEST_ORDERS); i++)
 		if (!buddy_free(buddy, addr + i * PAGE_SIZE))
 			goto failed;
 
@@ -181,6 +192,405 @@ failed:
 	assert(0);
 }
 
+// cache holding a block until asked to release it
+static void *__cached_blk;
+static int __shrink_calls;
+
+static size_t __buddy_cache_shrink(void *arg)
+{
+	buddy_t *buddy = arg;
+
+	__shrink_calls++;
+
+	if (!__cached_blk)
+		return 0;
+
+	buddy_free(buddy, __cached_blk);
+	__cached_blk = NULL;
+
+	return PAGE_SIZE;
+}
+
+static void
+__buddy_shrinker(buddy_t *buddy)
+{
+	void *arr[32];
+
+	//
+	if (buddy_register_shrinker(buddy, __buddy_cache_shrink, buddy))
+		goto failed;
+
+	// cache one page, then all remaining pages
+	__cached_blk = buddy_alloc(buddy, 1);
+	if (!__cached_blk)
+		goto failed;
+
+	for (int i = 0; i < (1 << TEST_ORDERS) - 1; i++) {
+		arr[i] = buddy_alloc(buddy, 1);
+		if (!arr[i])
+			goto failed;
+	}
+
+	// no free page: shrinker releases the cached one
+	arr[31] = buddy_alloc(buddy, 1);
+	if (!arr[31] || __shrink_calls != 1 || __cached_blk)
+		goto failed;
+
+	// nothing left to release
+	if (buddy_alloc(buddy, 1) || __shrink_calls != 2)
+		goto failed;
+
+	// free
+	for (int i = 0; i < (1 << TEST_ORDERS); i++)
+		if (buddy_free(buddy, arr[i]))
+			goto failed;
+
+	//
+	if (buddy_unregister_shrinker(buddy, __buddy_cache_shrink, buddy) ||
+		!buddy_unregister_shrinker(buddy, __buddy_cache_shrink, buddy))
+		goto failed;
+
+// success:
+	printf("[SUCCESS] Shrinker\n");
+	return;
+
+failed:
+	printf("[FAILED] Shrinker\n");
+	assert(0);
+}
+
+static void
+__buddy_free_orders(buddy_t *buddy)
+{
+	void *blk[2];
+
+	// single block of the largest order
+	if (buddy->free_orders != (1U << TEST_ORDERS))
+		goto failed;
+
+	// one pass split leaves one free block of each lower order
+	blk[0] = buddy_alloc(buddy, 1);
+	if (blk[0] != buddy->mem || buddy->free_orders != (1U << TEST_ORDERS) - 1)
+		goto failed;
+
+	// smallest fitting order is used (order 2 block split in two)
+	blk[1] = buddy_alloc(buddy, 2 * PAGE_SIZE);
+	if (blk[1] != buddy->mem + 2 * PAGE_SIZE ||
+		buddy->free_orders != (1U << TEST_ORDERS) - 1 - (1U << 1))
+		goto failed;
+
+	//
+	if (buddy_free(buddy, blk[1]) || buddy_free(buddy, blk[0]) ||
+		buddy->free_orders != (1U << TEST_ORDERS))
+		goto failed;
+
+// success:
+	printf("[SUCCESS] Free orders mask\n");
+	return;
+
+failed:
+	printf("[FAILED] Free orders mask\n");
+	assert(0);
+}
+
+#define TEST_THREADS		8
+#define TEST_THREAD_BLKS	256
+#define TEST_THREAD_ROUNDS	64
+
+static buddy_t *__threads_buddy;
+static void *__threads_blks[TEST_THREADS][TEST_THREAD_BLKS];
+static pthread_barrier_t __threads_barrier;
+
+static void *__buddy_thread(void *arg)
+{
+	int id = (intptr_t)arg, peer;
+	unsigned int seed = id;
+	uint8_t order;
+
+	for (int r = 0; r < TEST_THREAD_ROUNDS; r++) {
+		// mostly pages, some larger blocks
+		for (int i = 0; i < TEST_THREAD_BLKS; i++) {
+			order = rand_r(&seed) % 8 ? 0 : rand_r(&seed) % 4;
+
+			__threads_blks[id][i] = buddy_alloc(__threads_buddy,
+												ORDER_2_SIZE(order));
+			assert(__threads_blks[id][i]);
+
+			memset(__threads_blks[id][i], id, PAGE_SIZE);
+		}
+
+		pthread_barrier_wait(&__threads_barrier);
+
+		// free blocks of the peer thread
+		peer = (id + 1) % TEST_THREADS;
+
+		for (int i = 0; i < TEST_THREAD_BLKS; i++) {
+			assert(*(uint8_t *)__threads_blks[peer][i] == peer);
+			assert(!buddy_free(__threads_buddy, __threads_blks[peer][i]));
+		}
+
+		pthread_barrier_wait(&__threads_barrier);
+	}
+
+	return NULL;
+}
+
+static void
+__buddy_threads(void)
+{
+	pthread_t threads[TEST_THREADS];
+
+	// 64MiB arena
+	__threads_buddy = buddy_init(64 * _1MiB);
+	if (!__threads_buddy)
+		goto failed;
+
+	pthread_barrier_init(&__threads_barrier, NULL, TEST_THREADS);
+
+	for (intptr_t i = 0; i < TEST_THREADS; i++)
+		pthread_create(&threads[i], NULL, __buddy_thread, (void *)i);
+
+	for (int i = 0; i < TEST_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_barrier_destroy(&__threads_barrier);
+
+	// all blocks merged back once cpu lists are drained
+	buddy_drain(__threads_buddy);
+
+	if (__threads_buddy->free_orders != (1U << __threads_buddy->orders) ||
+		!buddy_alloc(__threads_buddy, 64 * _1MiB))
+		goto failed;
+
+	buddy_destroy(__threads_buddy);
+
+// success:
+	printf("[SUCCESS] Threads\n");
+	return;
+
+failed:
+	printf("[FAILED] Threads\n");
+	assert(0);
+}
+
+static void
+__buddy_large_arena(uint32_t flags)
+{
+	buddy_t *buddy;
+	void *blk, *arr[1024];
+
+	// 1GiB arena (orders up to 18)
+	buddy = buddy_init_flags(_1GiB, flags);
+	if (!buddy || buddy->orders != 18)
+		goto failed;
+
+	if (flags & BUDDY_HUGEPAGE && !buddy->hugetlb &&
+		(uintptr_t)buddy->mem % BUDDY_HUGEPAGE_SIZE)
+		goto failed;
+
+	// whole arena, then nothing left
+	blk = buddy_alloc(buddy, _1GiB);
+	if (!blk || buddy_alloc(buddy, 1) || buddy_free(buddy, blk))
+		goto failed;
+
+	// larger than arena
+	if (buddy_alloc(buddy, _1GiB + 1))
+		goto failed;
+
+	// pages and blocks of all orders
+	for (int i = 0; i < ARRAY_SIZE(arr); i++) {
+		arr[i] = buddy_alloc(buddy, ORDER_2_SIZE(i % 10));
+		if (!arr[i] || (arr[i] - buddy->mem) % ORDER_2_SIZE(i % 10))
+			goto failed;
+
+		memset(arr[i], i, PAGE_SIZE);
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(arr); i++) {
+		if (*(uint8_t *)arr[i] != (uint8_t)i || buddy_free(buddy, arr[i]))
+			goto failed;
+	}
+
+	// page freed to a cpu list
+	blk = buddy_alloc(buddy, 1);
+	if (!blk || buddy_free(buddy, blk) || !buddy_free(buddy, blk))
+		goto failed;
+
+	// all blocks merged back
+	blk = buddy_alloc(buddy, _1GiB);
+	if (!blk || buddy_free(buddy, blk))
+		goto failed;
+
+	buddy_destroy(buddy);
+
+// success:
+	printf("[SUCCESS] Large arena%s\n", flags & BUDDY_HUGEPAGE ? " (huge pages)" : "");
+	return;
+
+failed:
+	printf("[FAILED] Large arena%s\n", flags & BUDDY_HUGEPAGE ? " (huge pages)" : "");
+	assert(0);
+}
+
+static void
+__buddy_odd_arena(void)
+{
+	buddy_t *buddy;
+	void *blk[3];
+
+	// 44 pages arena: 32 + 8 + 4 pages blocks
+	buddy = buddy_init(44 * PAGE_SIZE - 1);
+	if (!buddy || buddy->pages != 44 || buddy->orders != 5)
+		goto failed;
+
+	blk[0] = buddy_alloc(buddy, 32 * PAGE_SIZE);
+	blk[1] = buddy_alloc(buddy, 8 * PAGE_SIZE);
+	blk[2] = buddy_alloc(buddy, 4 * PAGE_SIZE);
+	if (!blk[0] || !blk[1] || !blk[2] || buddy_alloc(buddy, 1))
+		goto failed;
+
+	// 4 pages buddy is past the end of arena, no merge
+	for (int i = 0; i < ARRAY_SIZE(blk); i++)
+		if (buddy_free(buddy, blk[i]))
+			goto failed;
+
+	if (buddy_alloc(buddy, 64 * PAGE_SIZE))
+		goto failed;
+
+	// 11 blocks of 4 pages
+	for (int i = 0; i < 11; i++)
+		if (!buddy_alloc(buddy, 4 * PAGE_SIZE))
+			goto failed;
+
+	if (buddy_alloc(buddy, 1))
+		goto failed;
+
+	buddy_destroy(buddy);
+
+// success:
+	printf("[SUCCESS] Arena not power of 2\n");
+	return;
+
+failed:
+	printf("[FAILED] Arena not power of 2\n");
+	assert(0);
+}
+
+static void
+__buddy_stats(void)
+{
+	buddy_t *buddy;
+	buddy_stats_t stats;
+	void *blk[2];
+	size_t samples;
+
+	// fresh 32 pages arena, one free block
+	buddy = buddy_init(TEST_MEM);
+	if (!buddy || buddy_stats(buddy, &stats) || !buddy_stats(NULL, &stats))
+		goto failed;
+
+	if (stats.free_pages != 32 || stats.free_blocks[TEST_ORDERS] != 1 ||
+		stats.largest_free != TEST_MEM || stats.fragmentation != 0)
+		goto failed;
+
+	// one page splits the arena down to order 0
+	blk[0] = buddy_alloc(buddy, 1);
+	if (!blk[0] || buddy_stats(buddy, &stats))
+		goto failed;
+
+	if (stats.splits != TEST_ORDERS || stats.free_pages != 31 ||
+		stats.largest_free != TEST_MEM / 2 || stats.fragmentation <= 0)
+		goto failed;
+
+	for (int order = 0; order < TEST_ORDERS; order++)
+		if (stats.free_blocks[order] != 1)
+			goto failed;
+
+	// failure is counted
+	blk[1] = buddy_alloc(buddy, TEST_MEM);
+	if (blk[1] || buddy_stats(buddy, &stats) || stats.allocs != 1 ||
+		stats.failures != 1)
+		goto failed;
+
+	// merged back to a single block
+	if (buddy_free(buddy, blk[0]) || buddy_stats(buddy, &stats))
+		goto failed;
+
+	if (stats.merges != TEST_ORDERS || stats.frees != 1 ||
+		stats.free_blocks[TEST_ORDERS] != 1 || stats.fragmentation != 0)
+		goto failed;
+
+	// sampled latency
+	for (int i = 0; i < 4 * BUDDY_STATS_SAMPLE; i++) {
+		blk[0] = buddy_alloc(buddy, PAGE_SIZE);
+		if (!blk[0] || buddy_free(buddy, blk[0]))
+			goto failed;
+	}
+
+	if (buddy_stats(buddy, &stats))
+		goto failed;
+
+	samples = 0;
+	for (int i = 0; i < BUDDY_LAT_BUCKETS; i++)
+		samples += stats.alloc_lat[i] + stats.free_lat[i];
+
+	if (samples < 4)
+		goto failed;
+
+	buddy_destroy(buddy);
+
+// success:
+	printf("[SUCCESS] Statistics\n");
+	return;
+
+failed:
+	printf("[FAILED] Statistics\n");
+	assert(0);
+}
+
+static void
+__buddy_node(void)
+{
+	buddy_t *buddy;
+	void *blk;
+	int node = -1;
+
+	// invalid and offline nodes
+	if (buddy_init_node(TEST_MEM, 0, BUDDY_MAX_NODES) ||
+		buddy_init_node(TEST_MEM, 0, -2) ||
+		buddy_init_node(TEST_MEM, 0, BUDDY_MAX_NODES - 1))
+		goto failed;
+
+	// arena on node 0
+	buddy = buddy_init_node(_1GiB, BUDDY_HUGEPAGE, 0);
+	if (!buddy || buddy->node != 0)
+		goto failed;
+
+	blk = buddy_alloc(buddy, 64 * PAGE_SIZE);
+	if (!blk)
+		goto failed;
+
+	memset(blk, 0xA5, 64 * PAGE_SIZE);
+
+	// page was allocated on the node when touched
+	if (syscall(SYS_get_mempolicy, &node, NULL, 0, blk + 63 * PAGE_SIZE,
+				MPOL_F_NODE | MPOL_F_ADDR) || node != 0)
+		goto failed;
+
+	if (buddy_free(buddy, blk))
+		goto failed;
+
+	buddy_destroy(buddy);
+
+// success:
+	printf("[SUCCESS] NUMA node\n");
+	return;
+
+failed:
+	printf("[FAILED] NUMA node\n");
+	assert(0);
+}
+
 /*****************************************************************************/
 
 int main()
@@ -192,12 +602,16 @@ int main()
 	srand(time(NULL));
 
 	// create buddy allocator
-	buddy = buddy_init();
+	buddy = buddy_init(TEST_MEM);
 	if (!buddy)
 		return -1;
 
+	// invalid arenas
+	assert(!buddy_init(0));
+	assert(!buddy_init_flags(TEST_MEM, 1U << 31));
+
 	// test exceed slots
-	for (int order = 0; order <= BUDDY_ORDERS; order++)
+	for (int order = 0; order <= TEST_ORDERS; order++)
 		__buddy_exceed_slots_for_order(buddy, order);
 
 	// Pattern: [1, 1, 2, 1, 1, 2, ..] - Filling 32 pages exactly
@@ -308,8 +722,26 @@ int main()
 	// invalid free
 	__buddy_invalid_free(buddy);
 
+	// memory pressure callbacks
+	__buddy_shrinker(buddy);
+
+	// non-empty orders
+	__buddy_free_orders(buddy);
+
 	// free buddy allocator
 	buddy_destroy(buddy);
 
+	// runtime sized arenas
+	__buddy_odd_arena();
+	__buddy_large_arena(0);
+	__buddy_large_arena(BUDDY_HUGEPAGE);
+	__buddy_node();
+
+	// concurrent alloc/free
+	__buddy_threads();
+
+	// fragmentation and latency statistics
+	__buddy_stats();
+
 	return 0;
 }
@@ -0,0 +1,215 @@
+/**
+ * Concurrent (sharded) hash table test.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "htable/chtable.h"
+
+
+/*****************************************************************************/
+
+#define NUM_SHARDS						64
+#define NUM_THREADS_MAX					32
+#define KEYS_PER_THREAD					(16 * 1024)
+
+//
+#define WORKLOAD_KEYS					(64 * 1024)
+#define WORKLOAD_OPS					(128 * 1024)
+#define WORKLOAD_READ_PERCENT			90
+
+
+/*****************************************************************************/
+
+static uint32_t u64_hash(void *key)
+{
+	uint64_t k = *(uint64_t *)key;
+
+	return (uint32_t)(k ^ (k >> 32));
+}
+
+static int u64_cmp(void *a, void *b)
+{
+	return *(uint64_t *)a != *(uint64_t *)b;
+}
+
+static void *u64_alloc(void *data)
+{
+	uint64_t *p = malloc(sizeof(uint64_t));
+
+	if (p)
+		*p = *(uint64_t *)data;
+
+	return p;
+}
+
+static void u64_free(void *data)
+{
+	free(data);
+}
+
+static void u64_read(void *key, void *value, void *arg)
+{
+	*(uint64_t *)arg = *(uint64_t *)value;
+}
+
+//
+static inline uint64_t now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/*****************************************************************************/
+
+static chtable_t *chtable;
+static atomic_int errors;
+
+
+/*****************************************************************************/
+
+static void *insert_thread(void *arg)
+{
+	uint64_t key, value;
+	uint64_t id = (uint64_t)(intptr_t)arg;
+
+	for (uint64_t i = 0; i < KEYS_PER_THREAD; i++) {
+		key = id * KEYS_PER_THREAD + i;
+		if (chtable_insert(chtable, &key, &key))
+			atomic_fetch_add(&errors, 1);
+	}
+
+	for (uint64_t i = 0; i < KEYS_PER_THREAD; i++) {
+		key = id * KEYS_PER_THREAD + i;
+		if (chtable_lookup(chtable, &key, u64_read, &value) || value != key)
+			atomic_fetch_add(&errors, 1);
+	}
+
+	// delete odd keys
+	for (uint64_t i = 1; i < KEYS_PER_THREAD; i += 2) {
+		key = id * KEYS_PER_THREAD + i;
+		if (chtable_delete(chtable, &key))
+			atomic_fetch_add(&errors, 1);
+	}
+
+	return NULL;
+}
+
+static void test_concurrent_updates(htable_type_e type)
+{
+	pthread_t threads[NUM_THREADS_MAX];
+	uint64_t key;
+
+	printf("Running %s test (type %d)...\n", __func__, type);
+
+	chtable = chtable_create(NUM_SHARDS, type, 0, u64_hash, u64_cmp,
+							u64_alloc, u64_free, u64_alloc, u64_free);
+	assert(chtable);
+
+	//
+	for (intptr_t i = 0; i < NUM_THREADS_MAX; i++)
+		pthread_create(&threads[i], NULL, insert_thread, (void *)i);
+
+	for (int i = 0; i < NUM_THREADS_MAX; i++)
+		pthread_join(threads[i], NULL);
+
+	//
+	assert(atomic_load(&errors) == 0);
+	assert(chtable_size(chtable) == NUM_THREADS_MAX * KEYS_PER_THREAD / 2);
+
+	for (key = 0; key < NUM_THREADS_MAX * KEYS_PER_THREAD; key++)
+		assert(chtable_contains(chtable, &key) == !(key % 2));
+
+	chtable_destroy(chtable);
+
+	printf("%s test passed!\n", __func__);
+}
+
+
+/*****************************************************************************/
+
+static void *workload_thread(void *arg)
+{
+	uint64_t key, value;
+	unsigned int seed = (unsigned int)(intptr_t)arg;
+
+	for (int i = 0; i < WORKLOAD_OPS; i++) {
+		key = rand_r(&seed) % WORKLOAD_KEYS;
+
+		if (rand_r(&seed) % 100 < WORKLOAD_READ_PERCENT) {
+			chtable_lookup(chtable, &key, u64_read, &value);
+			continue;
+		}
+
+		// writes toggle the key presence
+		if (chtable_insert(chtable, &key, &key))
+			chtable_delete(chtable, &key);
+	}
+
+	return NULL;
+}
+
+/**
+ * Mixed 90/10 read/write workload throughput for an increasing number of
+ * threads.
+ */
+static void test_workload(htable_type_e type)
+{
+	pthread_t threads[NUM_THREADS_MAX];
+	uint64_t key, start, end;
+
+	printf("Running %s (type %d, %d%% reads)...\n", __func__, type,
+			WORKLOAD_READ_PERCENT);
+
+	for (int n = 1; n <= NUM_THREADS_MAX; n *= 2) {
+		chtable = chtable_create(NUM_SHARDS, type, WORKLOAD_KEYS, u64_hash,
+								u64_cmp, u64_alloc, u64_free, u64_alloc,
+								u64_free);
+		assert(chtable);
+
+		// half of the keys are present
+		for (key = 0; key < WORKLOAD_KEYS; key += 2)
+			assert(!chtable_insert(chtable, &key, &key));
+
+		//
+		start = now_ns();
+
+		for (intptr_t i = 0; i < n; i++)
+			pthread_create(&threads[i], NULL, workload_thread, (void *)(i + 1));
+
+		for (int i = 0; i < n; i++)
+			pthread_join(threads[i], NULL);
+
+		end = now_ns();
+
+		//
+		printf("threads %2d: %8.2f Mops/s\n", n,
+				(double)n * WORKLOAD_OPS * 1000 / (end - start));
+
+		chtable_destroy(chtable);
+	}
+}
+
+
+/*****************************************************************************/
+
+int main()
+{
+	test_concurrent_updates(HTABLE_CHAINED);
+	test_concurrent_updates(HTABLE_OPEN);
+
+	test_workload(HTABLE_CHAINED);
+	test_workload(HTABLE_OPEN);
+
+	printf("All tests passed!\n");
+	return 0;
+}
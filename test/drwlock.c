@@ -0,0 +1,252 @@
+/**
+ * Distributed read-write lock test.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "synchronization/drwlock.h"
+
+
+/*****************************************************************************/
+
+// exclusion test (more threads than slots share slots)
+#define STRESS_THREADS					(DRWLOCK_SLOTS + 8)
+#define STRESS_ITERS					4096
+
+// writer waiting for a long read section
+#define BLOCK_READER_MS					200
+
+// read throughput
+#define BENCH_MAX_THREADS				8
+#define BENCH_ITERS						200000
+
+
+/*****************************************************************************/
+
+static drwlock_t *drwlock;
+static rwlock_t *rwlock;
+
+static atomic_int stress_readers;
+static atomic_int stress_writers;
+static long stress_data[2];
+
+
+/*****************************************************************************/
+
+static inline uint64_t now_ns() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/*****************************************************************************/
+
+static void *stress_thread(void *arg)
+{
+	int id = (int)(intptr_t)arg;
+
+	for (int i = 0; i < STRESS_ITERS; i++) {
+		if ((i + id) % 16) {
+			drwlock_read_lock(drwlock);
+			atomic_fetch_add(&stress_readers, 1);
+			assert(atomic_load(&stress_writers) == 0);
+			assert(stress_data[0] == stress_data[1]);
+			atomic_fetch_sub(&stress_readers, 1);
+			drwlock_read_unlock(drwlock);
+		} else {
+			drwlock_write_lock(drwlock);
+			assert(atomic_fetch_add(&stress_writers, 1) == 0);
+			assert(atomic_load(&stress_readers) == 0);
+			stress_data[0]++;
+			stress_data[1]++;
+			atomic_fetch_sub(&stress_writers, 1);
+			drwlock_write_unlock(drwlock);
+		}
+	}
+
+	return NULL;
+}
+
+static void test_exclusion(void)
+{
+	pthread_t threads[STRESS_THREADS];
+
+	printf("=============== EXCLUSION ===============\n");
+
+	for (int i = 0; i < STRESS_THREADS; i++)
+		pthread_create(&threads[i], NULL, stress_thread, (void *)(intptr_t)i);
+
+	for (int i = 0; i < STRESS_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	assert(stress_data[0] == STRESS_THREADS * STRESS_ITERS / 16);
+
+	for (int i = 0; i < DRWLOCK_SLOTS; i++)
+		assert(atomic_load(&drwlock->slots[i].readers) == 0);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static void *trylock_writer(void *arg)
+{
+	drwlock_write_lock(drwlock);
+	drwlock_write_unlock(drwlock);
+
+	return NULL;
+}
+
+static void test_trylock(void)
+{
+	pthread_t writer;
+
+	printf("================ TRYLOCK ================\n");
+
+	// readers nest
+	assert(drwlock_read_trylock(drwlock) == 0);
+	drwlock_read_lock(drwlock);
+
+	// writer waits for both references
+	pthread_create(&writer, NULL, trylock_writer, NULL);
+
+	while (!atomic_load(&drwlock->writer))
+		usleep(1000);
+
+	// new readers are blocked by the waiting writer
+	assert(drwlock_read_trylock(drwlock) < 0);
+
+	drwlock_read_unlock(drwlock);
+	drwlock_read_unlock(drwlock);
+	pthread_join(writer, NULL);
+
+	assert(drwlock_read_trylock(drwlock) == 0);
+	drwlock_read_unlock(drwlock);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static uint64_t thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *blocked_writer(void *arg)
+{
+	uint64_t start = thread_cpu_ns();
+
+	drwlock_write_lock(drwlock);
+	drwlock_write_unlock(drwlock);
+
+	*(uint64_t *)arg = thread_cpu_ns() - start;
+
+	return NULL;
+}
+
+static void test_blocking(void)
+{
+	pthread_t writer;
+	uint64_t cpu_ns;
+
+	printf("=============== BLOCKING ================\n");
+
+	// writer sleeps while a reader holds its slot
+	drwlock_read_lock(drwlock);
+
+	pthread_create(&writer, NULL, blocked_writer, &cpu_ns);
+
+	usleep(BLOCK_READER_MS * 1000);
+	drwlock_read_unlock(drwlock);
+
+	pthread_join(writer, NULL);
+
+	printf("writer cpu time: %.3f ms\n", cpu_ns / 1e6);
+	assert(cpu_ns < BLOCK_READER_MS * 1000000ULL / 4);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static void *bench_drwlock(void *arg)
+{
+	for (int i = 0; i < BENCH_ITERS; i++) {
+		drwlock_read_lock(drwlock);
+		drwlock_read_unlock(drwlock);
+	}
+
+	return NULL;
+}
+
+static void *bench_rwlock(void *arg)
+{
+	for (int i = 0; i < BENCH_ITERS; i++) {
+		rwlock_read_lock(rwlock);
+		rwlock_read_unlock(rwlock);
+	}
+
+	return NULL;
+}
+
+static double bench(void *(*fn)(void *), int threads_no)
+{
+	pthread_t threads[BENCH_MAX_THREADS];
+	uint64_t start, end;
+
+	start = now_ns();
+
+	for (int i = 0; i < threads_no; i++)
+		pthread_create(&threads[i], NULL, fn, NULL);
+
+	for (int i = 0; i < threads_no; i++)
+		pthread_join(threads[i], NULL);
+
+	end = now_ns();
+
+	return (double)threads_no * BENCH_ITERS * 1000 / (end - start);
+}
+
+static void test_benchmark(void)
+{
+	printf("=============== BENCHMARK ===============\n");
+
+	for (int n = 1; n <= BENCH_MAX_THREADS; n *= 2)
+		printf("readers %d: drwlock %8.2f Mops/s, rwlock %8.2f Mops/s\n", n,
+				bench(bench_drwlock, n), bench(bench_rwlock, n));
+}
+
+
+/*****************************************************************************/
+
+int main() {
+	drwlock = drwlock_create();
+	rwlock = rwlock_create();
+	assert(drwlock && rwlock);
+
+	test_exclusion();
+	test_trylock();
+	test_blocking();
+	test_benchmark();
+
+	rwlock_destroy(rwlock);
+	drwlock_destroy(drwlock);
+
+	return 0;
+}
@@ -0,0 +1,619 @@
+/**
+ * Hash table data structure test.
+ * Copyright (C) 2024 Lazar Razvan.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "utils.h"
+#include "htable/htable.h"
+
+
+/*****************************************************************************/
+
+#define HTABLE_CAPACITY					1024
+#define HTABLE_KEYS_NO					512
+#define HTABLE_KEY_LEN					32
+
+#define HTABLE_GROW_CAPACITY			16
+#define HTABLE_GROW_KEYS_NO				(128 * 1024)
+
+#define HTABLE_BATCH_KEYS_NO			64
+
+#define HTABLE_INLINE_KEYS_NO			(64 * 1024)
+
+#define HTABLE_BENCH_KEYS_NO			(1024 * 1024)
+
+
+/*****************************************************************************/
+
+// djb2
+static uint32_t str_hash(void *key)
+{
+	uint32_t hash = 5381;
+	char *str = (char *)key;
+
+	while (*str)
+		hash = ((hash << 5) + hash) + *str++;
+
+	return hash;
+}
+
+static int str_cmp(void *a, void *b)
+{
+	return strcmp((char *)a, (char *)b);
+}
+
+static void *str_alloc(void *data)
+{
+	return strdup((char *)data);
+}
+
+static void str_free(void *data)
+{
+	free(data);
+}
+
+//
+static uint32_t u64_hash(void *key)
+{
+	uint64_t k = *(uint64_t *)key;
+
+	return (uint32_t)(k ^ (k >> 32));
+}
+
+static int u64_cmp(void *a, void *b)
+{
+	return *(uint64_t *)a != *(uint64_t *)b;
+}
+
+static void *u64_alloc(void *data)
+{
+	uint64_t *p = malloc(sizeof(uint64_t));
+
+	if (p)
+		*p = *(uint64_t *)data;
+
+	return p;
+}
+
+static void u64_free(void *data)
+{
+	free(data);
+}
+
+//
+static inline uint64_t now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/*****************************************************************************/
+
+static int test_basic_operations(htable_t *htable)
+{
+	void *value;
+
+	printf("Running %s test...\n", __func__);
+
+	if (htable_insert(htable, "cat", "value_cat"))
+		goto error;
+	if (htable_insert(htable, "car", "value_car"))
+		goto error;
+	if (htable_insert(htable, "cart", "value_cart"))
+		goto error;
+
+	// duplicated key
+	if (!htable_insert(htable, "cat", "value_cat2"))
+		goto error;
+
+	if (htable_lookup(htable, "car", &value) || strcmp(value, "value_car"))
+		goto error;
+	if (!htable_find_ptr(htable, "cart"))
+		goto error;
+	if (htable_find_ptr(htable, "dog"))
+		goto error;
+
+	if (htable_delete(htable, "cat"))
+		goto error;
+	if (htable_delete(htable, "car"))
+		goto error;
+	if (!htable_delete(htable, "car"))
+		goto error;
+
+	if (htable_find_ptr(htable, "cat") || htable_find_ptr(htable, "car"))
+		goto error;
+	if (!htable_find_ptr(htable, "cart"))
+		goto error;
+
+	if (htable_delete(htable, "cart"))
+		goto error;
+
+	if (htable->size != 0)
+		goto error;
+
+//success:
+	printf("%s test passed!\n", __func__);
+	return 0;
+
+error:
+	printf("%s test failed!\n", __func__);
+	return -1;
+}
+
+static int test_many_keys(htable_t *htable)
+{
+	char key[HTABLE_KEY_LEN];
+	char *value;
+
+	printf("Running %s test...\n", __func__);
+
+	for (int i = 0; i < HTABLE_KEYS_NO; i++) {
+		snprintf(key, sizeof(key), "key_%d", i);
+		if (htable_insert(htable, key, key))
+			goto error;
+	}
+
+	if (htable->size != HTABLE_KEYS_NO)
+		goto error;
+
+	// delete odd keys
+	for (int i = 1; i < HTABLE_KEYS_NO; i += 2) {
+		snprintf(key, sizeof(key), "key_%d", i);
+		if (htable_delete(htable, key))
+			goto error;
+	}
+
+	for (int i = 0; i < HTABLE_KEYS_NO; i++) {
+		snprintf(key, sizeof(key), "key_%d", i);
+		value = htable_find_ptr(htable, key);
+
+		if (i % 2 && value)
+			goto error;
+		if (!(i % 2) && (!value || strcmp(value, key)))
+			goto error;
+	}
+
+	// reinsert odd keys (reuse deleted slots)
+	for (int i = 1; i < HTABLE_KEYS_NO; i += 2) {
+		snprintf(key, sizeof(key), "key_%d", i);
+		if (htable_insert(htable, key, key))
+			goto error;
+	}
+
+	for (int i = 0; i < HTABLE_KEYS_NO; i++) {
+		snprintf(key, sizeof(key), "key_%d", i);
+		value = htable_find_ptr(htable, key);
+
+		if (!value || strcmp(value, key))
+			goto error;
+	}
+
+//success:
+	printf("%s test passed!\n", __func__);
+	return 0;
+
+error:
+	printf("%s test failed!\n", __func__);
+	return -1;
+}
+
+
+static int test_growth(htable_t *htable)
+{
+	char key[HTABLE_KEY_LEN];
+	char *value;
+
+	printf("Running %s test...\n", __func__);
+
+	// lookup all inserted keys while tables are being rehashed
+	for (int i = 0; i < HTABLE_GROW_KEYS_NO; i++) {
+		snprintf(key, sizeof(key), "key_%d", i);
+		if (htable_insert(htable, key, key))
+			goto error;
+
+		if (i % 1024)
+			continue;
+
+		for (int j = 0; j <= i; j += 7) {
+			snprintf(key, sizeof(key), "key_%d", j);
+			value = htable_find_ptr(htable, key);
+			if (!value || strcmp(value, key))
+				goto error;
+		}
+	}
+
+	if (htable->size != HTABLE_GROW_KEYS_NO)
+		goto error;
+
+	for (int i = 0; i < HTABLE_GROW_KEYS_NO; i++) {
+		snprintf(key, sizeof(key), "key_%d", i);
+		value = htable_find_ptr(htable, key);
+		if (!value || strcmp(value, key))
+			goto error;
+	}
+
+	for (int i = 0; i < HTABLE_GROW_KEYS_NO; i++) {
+		snprintf(key, sizeof(key), "key_%d", i);
+		if (htable_delete(htable, key))
+			goto error;
+	}
+
+	if (htable->size != 0)
+		goto error;
+
+//success:
+	printf("%s test passed!\n", __func__);
+	return 0;
+
+error:
+	printf("%s test failed!\n", __func__);
+	return -1;
+}
+
+static int test_batch_operations(htable_t *htable)
+{
+	char keys_buf[HTABLE_BATCH_KEYS_NO][HTABLE_KEY_LEN];
+	void *keys[HTABLE_BATCH_KEYS_NO], *values[HTABLE_BATCH_KEYS_NO];
+	int rv[HTABLE_BATCH_KEYS_NO];
+	uint32_t size = htable->size;
+
+	printf("Running %s test...\n", __func__);
+
+	for (int i = 0; i < HTABLE_BATCH_KEYS_NO; i++) {
+		snprintf(keys_buf[i], HTABLE_KEY_LEN, "batch_%d", i);
+		keys[i] = keys_buf[i];
+	}
+
+	// insert even keys one by one, then all keys as a batch
+	for (int i = 0; i < HTABLE_BATCH_KEYS_NO; i += 2) {
+		if (htable_insert(htable, keys[i], keys[i]))
+			goto error;
+	}
+
+	if (htable_insert_batch(htable, keys, keys, rv, HTABLE_BATCH_KEYS_NO) !=
+		HTABLE_BATCH_KEYS_NO / 2)
+		goto error;
+
+	for (int i = 0; i < HTABLE_BATCH_KEYS_NO; i++) {
+		if (rv[i] != (i % 2 ? 0 : -5))
+			goto error;
+	}
+
+	// lookup all keys, delete odd ones, lookup again
+	if (htable_lookup_batch(htable, keys, values, rv, HTABLE_BATCH_KEYS_NO) !=
+		HTABLE_BATCH_KEYS_NO)
+		goto error;
+
+	for (int i = 0; i < HTABLE_BATCH_KEYS_NO; i++) {
+		if (rv[i] || strcmp(values[i], keys[i]))
+			goto error;
+	}
+
+	for (int i = 1; i < HTABLE_BATCH_KEYS_NO; i += 2) {
+		if (htable_delete(htable, keys[i]))
+			goto error;
+	}
+
+	// missing entries
+	keys[0] = NULL;
+
+	if (htable_lookup_batch(htable, keys, values, rv, HTABLE_BATCH_KEYS_NO) !=
+		HTABLE_BATCH_KEYS_NO / 2 - 1)
+		goto error;
+
+	if (rv[0] != -1)
+		goto error;
+
+	for (int i = 1; i < HTABLE_BATCH_KEYS_NO; i++) {
+		if (rv[i] != (i % 2 ? -3 : 0))
+			goto error;
+	}
+
+	//
+	for (int i = 0; i < HTABLE_BATCH_KEYS_NO; i += 2) {
+		if (htable_delete(htable, keys_buf[i]))
+			goto error;
+	}
+
+	if (htable->size != size)
+		goto error;
+
+//success:
+	printf("%s test passed!\n", __func__);
+	return 0;
+
+error:
+	printf("%s test failed!\n", __func__);
+	return -1;
+}
+
+static int test_inline(htable_type_e type)
+{
+	uint64_t key, value, *found;
+	htable_t *htable;
+
+	printf("Running %s test (type %d)...\n", __func__, type);
+
+	htable = htable_create_inline(type, 0, sizeof(uint64_t), sizeof(uint64_t),
+								u64_hash, u64_cmp);
+	if (!htable)
+		goto error;
+
+	// grows from min capacity
+	for (key = 0; key < HTABLE_INLINE_KEYS_NO; key++) {
+		value = key * 3;
+		if (htable_insert(htable, &key, &value))
+			goto free_htable;
+	}
+
+	// entries are copied
+	key = 0;
+	if (htable_insert(htable, &key, &value) != -5)
+		goto free_htable;
+
+	for (key = 0; key < HTABLE_INLINE_KEYS_NO; key++) {
+		if (htable_lookup(htable, &key, (void **)&found) || *found != key * 3)
+			goto free_htable;
+	}
+
+	// delete odd keys
+	for (key = 1; key < HTABLE_INLINE_KEYS_NO; key += 2) {
+		if (htable_delete(htable, &key))
+			goto free_htable;
+	}
+
+	for (key = 0; key < HTABLE_INLINE_KEYS_NO; key++) {
+		found = htable_find_ptr(htable, &key);
+
+		if (key % 2 && found)
+			goto free_htable;
+		if (!(key % 2) && (!found || *found != key * 3))
+			goto free_htable;
+	}
+
+	if (htable->size != HTABLE_INLINE_KEYS_NO / 2)
+		goto free_htable;
+
+	htable_destroy(htable);
+
+//success:
+	printf("%s test passed!\n", __func__);
+	return 0;
+
+free_htable:
+	htable_destroy(htable);
+error:
+	printf("%s test failed!\n", __func__);
+	return -1;
+}
+
+static int test_node_cache(void)
+{
+	uint64_t key, *found;
+	slab_cache_t *cache;
+	htable_t *htable;
+
+	printf("Running %s test...\n", __func__);
+
+	htable = htable_create_inline(HTABLE_CHAINED, 0, sizeof(uint64_t),
+								sizeof(uint64_t), u64_hash, u64_cmp);
+	if (!htable)
+		goto error;
+
+	cache = slab_cache_create(htable_node_size(htable), "htable_node");
+	if (!cache)
+		goto free_htable;
+
+	if (htable_set_node_cache(htable, cache, 0))
+		goto free_cache;
+
+	// insert / delete churn
+	for (int round = 0; round < 2; round++) {
+		for (key = 0; key < HTABLE_INLINE_KEYS_NO; key++) {
+			if (htable_insert(htable, &key, &key))
+				goto free_cache;
+		}
+
+		// only allowed on empty tables
+		if (!htable_set_node_cache(htable, NULL, 0))
+			goto free_cache;
+
+		for (key = 0; key < HTABLE_INLINE_KEYS_NO; key++) {
+			found = htable_find_ptr(htable, &key);
+			if (!found || *found != key)
+				goto free_cache;
+		}
+
+		for (key = round; key < HTABLE_INLINE_KEYS_NO; key++) {
+			if (htable_delete(htable, &key))
+				goto free_cache;
+		}
+
+		// keep one entry to be released by destroy
+		if (htable->size != round)
+			goto free_cache;
+
+		if (round == 0 && htable_set_node_cache(htable, cache, 0))
+			goto free_cache;
+	}
+
+	htable_destroy(htable);
+	slab_cache_destroy(cache);
+
+//success:
+	printf("%s test passed!\n", __func__);
+	return 0;
+
+free_cache:
+	htable_destroy(htable);
+	slab_cache_destroy(cache);
+	goto error;
+free_htable:
+	htable_destroy(htable);
+error:
+	printf("%s test failed!\n", __func__);
+	return -1;
+}
+
+
+/*****************************************************************************/
+
+/**
+ * Compare HTABLE_OPEN (SIMD probed groups) against HTABLE_CHAINED layout, with
+ * allocated and inline entries (chained nodes from malloc or slab cache).
+ */
+static void test_benchmark(void)
+{
+	uint64_t key, start, insert, hit, miss, batch, delete;
+	uint64_t batch_keys[HTABLE_BATCH_KEYS_NO];
+	void *keys[HTABLE_BATCH_KEYS_NO], *values[HTABLE_BATCH_KEYS_NO];
+	int rv[HTABLE_BATCH_KEYS_NO];
+	htable_type_e types[] = { HTABLE_CHAINED, HTABLE_OPEN, HTABLE_CHAINED,
+							HTABLE_OPEN, HTABLE_CHAINED };
+	bool inline_entries[] = { false, false, true, true, true };
+	bool slab_nodes[] = { false, false, false, false, true };
+	char *names[] = { "chained", "open", "chained inline", "open inline",
+					"chained slab" };
+	slab_cache_t *cache = NULL;
+	htable_t *htable;
+
+	printf("Running %s (%d keys, group width %d)...\n", __func__,
+			HTABLE_BENCH_KEYS_NO, HTABLE_GROUP_WIDTH);
+
+	for (int i = 0; i < ARRAY_SIZE(types); i++) {
+		if (inline_entries[i])
+			htable = htable_create_inline(types[i], HTABLE_BENCH_KEYS_NO,
+							sizeof(uint64_t), sizeof(uint64_t), u64_hash,
+							u64_cmp);
+		else
+			htable = htable_create_type(types[i], HTABLE_BENCH_KEYS_NO,
+							u64_hash, u64_cmp, u64_alloc, u64_free, u64_alloc,
+							u64_free);
+		assert(htable);
+
+		if (slab_nodes[i]) {
+			cache = slab_cache_create(htable_node_size(htable), "htable_node");
+			assert(cache);
+			assert(!htable_set_node_cache(htable, cache, 0));
+		}
+
+		start = now_ns();
+
+		for (key = 0; key < HTABLE_BENCH_KEYS_NO; key++)
+			assert(!htable_insert(htable, &key, &key));
+		insert = now_ns();
+
+		for (key = 0; key < HTABLE_BENCH_KEYS_NO; key++)
+			assert(htable_find_ptr(htable, &key));
+		hit = now_ns();
+
+		for (key = HTABLE_BENCH_KEYS_NO; key < 2 * HTABLE_BENCH_KEYS_NO; key++)
+			assert(!htable_find_ptr(htable, &key));
+		miss = now_ns();
+
+		for (int j = 0; j < HTABLE_BATCH_KEYS_NO; j++)
+			keys[j] = &batch_keys[j];
+
+		for (key = 0; key < HTABLE_BENCH_KEYS_NO; key += HTABLE_BATCH_KEYS_NO) {
+			for (int j = 0; j < HTABLE_BATCH_KEYS_NO; j++)
+				batch_keys[j] = key + j;
+
+			assert(htable_lookup_batch(htable, keys, values, rv,
+						HTABLE_BATCH_KEYS_NO) == HTABLE_BATCH_KEYS_NO);
+		}
+		batch = now_ns();
+
+		for (key = 0; key < HTABLE_BENCH_KEYS_NO; key++)
+			assert(!htable_delete(htable, &key));
+		delete = now_ns();
+
+		htable_destroy(htable);
+		slab_cache_destroy(cache);
+		cache = NULL;
+
+		//
+		printf("%-14s insert: %6.1f ns/op, lookup hit: %6.1f ns/op, "
+				"lookup miss: %6.1f ns/op, batch lookup hit: %6.1f ns/op, "
+				"delete: %6.1f ns/op\n", names[i],
+				(double)(insert - start) / HTABLE_BENCH_KEYS_NO,
+				(double)(hit - insert) / HTABLE_BENCH_KEYS_NO,
+				(double)(miss - hit) / HTABLE_BENCH_KEYS_NO,
+				(double)(batch - miss) / HTABLE_BENCH_KEYS_NO,
+				(double)(delete - batch) / HTABLE_BENCH_KEYS_NO);
+	}
+}
+
+
+/*****************************************************************************/
+
+int main()
+{
+	htable_t *htable;
+
+	//
+	// HTABLE_CHAINED
+	//
+	htable = htable_create(HTABLE_CAPACITY, str_hash, str_cmp, str_alloc,
+						str_free, str_alloc, str_free);
+	assert(htable);
+
+	assert(!test_basic_operations(htable));
+	assert(!test_many_keys(htable));
+	assert(!test_batch_operations(htable));
+
+	htable_destroy(htable);
+
+	htable = htable_create(HTABLE_GROW_CAPACITY, str_hash, str_cmp, str_alloc,
+						str_free, str_alloc, str_free);
+	assert(htable);
+
+	assert(!test_growth(htable));
+
+	htable_destroy(htable);
+
+	//
+	// HTABLE_OPEN
+	//
+	htable = htable_create_type(HTABLE_OPEN, HTABLE_CAPACITY, str_hash, str_cmp,
+						str_alloc, str_free, str_alloc, str_free);
+	assert(htable);
+
+	assert(!test_basic_operations(htable));
+	assert(!test_many_keys(htable));
+	assert(!test_batch_operations(htable));
+
+	htable_destroy(htable);
+
+	htable = htable_create_type(HTABLE_OPEN, HTABLE_GROW_CAPACITY, str_hash,
+						str_cmp, str_alloc, str_free, str_alloc, str_free);
+	assert(htable);
+
+	assert(!test_growth(htable));
+
+	htable_destroy(htable);
+
+	//
+	// Inline entries
+	//
+	assert(!test_inline(HTABLE_CHAINED));
+	assert(!test_inline(HTABLE_OPEN));
+
+	//
+	// Slab node cache
+	//
+	assert(!test_node_cache());
+
+	test_benchmark();
+
+	printf("All tests passed!\n");
+	return 0;
+}
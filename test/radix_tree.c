@@ -412,6 +412,7 @@ error:
 int main()
 {
 	radix_tree_t *radix;
+	slab_cache_t *cache;
 
 	// init
 	radix = radix_tree_init(data_alloc, data_print, data_free);
@@ -432,5 +433,23 @@ int main()
 	// destroy
 	radix_tree_destroy(radix);
 
+	// same tests, nodes allocated from a slab cache
+	cache = slab_cache_create(sizeof(radix_tree_node_t), "radix_node");
+	assert(cache);
+
+	radix = radix_tree_init_slab(data_alloc, data_print, data_free, cache, 0);
+	assert(radix);
+
+	assert(!test_basic_operations(radix));
+	assert(!test_splitting_nodes(radix));
+	assert(!test_merging_nodes(radix));
+	assert(!test_existing_nodes(radix));
+	assert(!test_edge_cases(radix));
+	assert(!test_lookup_nodes(radix));
+	assert(!test_large(radix));
+
+	radix_tree_destroy(radix);
+	slab_cache_destroy(cache);
+
 	return 0;
 }
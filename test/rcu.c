@@ -3,6 +3,8 @@
  * Copyright (C) 2025 Lazar Razvan.
  */
 
+#include <time.h>
+#include <sched.h>
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
@@ -19,6 +21,17 @@
 #define NUM_WRITERS						4
 #define ITERATIONS						100
 
+// writer vs. overlapping readers
+#define STREAM_READERS					4
+#define STREAM_SYNCS					64
+
+// writer vs. long read section
+#define BLOCK_READER_MS					200
+
+// deferred callbacks (config reload sized bursts)
+#define CALL_THREADS					4
+#define CALL_OBJS						20000
+
 
 /*****************************************************************************/
 
@@ -126,6 +139,305 @@ void *writer_thread(void *arg)
 }
 
 
+/*****************************************************************************/
+
+static atomic_int stream_stop;
+static atomic_int stream_entered;
+static atomic_int sync_done;
+static atomic_int calls_done;
+
+static void *stream_reader(void *arg)
+{
+	shared_object_t *obj;
+	int thread_id = rcu_register_thread(rcu_ctx);
+
+	assert(thread_id >= 0);
+	atomic_fetch_add(&stream_entered, 1);
+
+	/******************************************************
+	 * Sections overlap (a reader is always inside one), a
+	 * published object is never freed under a reader
+	 ******************************************************/
+	while (!atomic_load(&stream_stop)) {
+		rcu_read_lock(rcu_ctx, thread_id);
+		rcu_read_lock(rcu_ctx, thread_id);
+
+		obj = rcu_dereference((_Atomic(void *) *)&shared_ptr);
+		assert(obj && obj->version >= 0);
+		sched_yield();
+		assert(obj->version >= 0);
+
+		rcu_read_unlock(rcu_ctx, thread_id);
+		rcu_read_unlock(rcu_ctx, thread_id);
+	}
+
+	return NULL;
+}
+
+static void test_no_starvation(void)
+{
+	pthread_t readers[STREAM_READERS];
+	shared_object_t *obj, *old;
+
+	printf("============= NO STARVATION =============\n");
+
+	obj = calloc(1, sizeof(shared_object_t));
+	assert(obj);
+	rcu_assign_pointer((_Atomic(void *) *)&shared_ptr, obj);
+
+	for (int i = 0; i < STREAM_READERS; i++)
+		pthread_create(&readers[i], NULL, stream_reader, NULL);
+
+	while (atomic_load(&stream_entered) < STREAM_READERS)
+		sched_yield();
+
+	// each grace period ends while new readers keep entering
+	for (int i = 1; i <= STREAM_SYNCS; i++) {
+		obj = malloc(sizeof(shared_object_t));
+		assert(obj);
+		obj->version = i;
+
+		old = rcu_dereference((_Atomic(void *) *)&shared_ptr);
+		rcu_assign_pointer((_Atomic(void *) *)&shared_ptr, obj);
+
+		rcu_synchronize(rcu_ctx);
+
+		old->version = -1;
+		free(old);
+	}
+
+	atomic_store(&stream_stop, 1);
+	for (int i = 0; i < STREAM_READERS; i++)
+		pthread_join(readers[i], NULL);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static void *sync_writer(void *arg)
+{
+	rcu_synchronize(rcu_ctx);
+	atomic_store(&sync_done, 1);
+
+	return NULL;
+}
+
+static void test_grace_period(void)
+{
+	pthread_t writer;
+	int thread_id;
+
+	printf("============= GRACE PERIOD ==============\n");
+
+	thread_id = rcu_register_thread(rcu_ctx);
+	assert(thread_id >= 0);
+	assert(rcu_register_thread(rcu_ctx) == thread_id);
+
+	// writer waits for the pre-existing (nested) reader
+	rcu_read_lock(rcu_ctx, thread_id);
+	rcu_read_lock(rcu_ctx, thread_id);
+	pthread_create(&writer, NULL, sync_writer, NULL);
+
+	usleep(20000);
+	rcu_read_unlock(rcu_ctx, thread_id);
+
+	usleep(20000);
+	assert(!atomic_load(&sync_done));
+
+	rcu_read_unlock(rcu_ctx, thread_id);
+	pthread_join(writer, NULL);
+	assert(atomic_load(&sync_done));
+
+	// no reader, no wait
+	rcu_synchronize(rcu_ctx);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static uint64_t thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *blocked_writer(void *arg)
+{
+	uint64_t start = thread_cpu_ns();
+
+	rcu_synchronize(rcu_ctx);
+
+	*(uint64_t *)arg = thread_cpu_ns() - start;
+
+	return NULL;
+}
+
+static void test_blocking(void)
+{
+	pthread_t writer;
+	uint64_t cpu_ns;
+	int thread_id;
+
+	printf("=============== BLOCKING ================\n");
+
+	thread_id = rcu_register_thread(rcu_ctx);
+	assert(thread_id >= 0);
+
+	// writer sleeps while a reader holds a long section
+	rcu_read_lock(rcu_ctx, thread_id);
+
+	pthread_create(&writer, NULL, blocked_writer, &cpu_ns);
+
+	usleep(BLOCK_READER_MS * 1000);
+	rcu_read_unlock(rcu_ctx, thread_id);
+
+	pthread_join(writer, NULL);
+
+	printf("writer cpu time: %.3f ms\n", cpu_ns / 1e6);
+	assert(cpu_ns < BLOCK_READER_MS * 1000000ULL / 4);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static void count_callback(void *ptr)
+{
+	atomic_fetch_add(&calls_done, 1);
+	free(ptr);
+}
+
+static void *call_thread(void *arg)
+{
+	// registered threads use their own queue, others the shared one
+	if ((intptr_t)arg % 2)
+		assert(rcu_register_thread(rcu_ctx) >= 0);
+
+	for (int i = 0; i < CALL_OBJS; i++)
+		rcu_call(rcu_ctx, count_callback, malloc(sizeof(shared_object_t)));
+
+	return NULL;
+}
+
+static void test_calls(void)
+{
+	pthread_t threads[CALL_THREADS];
+
+	atomic_store(&calls_done, 0);
+
+	for (intptr_t i = 0; i < CALL_THREADS; i++)
+		pthread_create(&threads[i], NULL, call_thread, (void *)i);
+
+	for (int i = 0; i < CALL_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	// all callbacks scheduled so far are called
+	rcu_barrier(rcu_ctx);
+	assert(atomic_load(&calls_done) == CALL_THREADS * CALL_OBJS);
+
+	// nothing left
+	rcu_barrier(rcu_ctx);
+	assert(atomic_load(&calls_done) == CALL_THREADS * CALL_OBJS);
+}
+
+static void *barrier_thread(void *arg)
+{
+	rcu_barrier(rcu_ctx);
+	atomic_store(&sync_done, 1);
+
+	return NULL;
+}
+
+static void test_barrier_grace_period(void)
+{
+	pthread_t thread;
+	int thread_id;
+
+	thread_id = rcu_register_thread(rcu_ctx);
+	assert(thread_id >= 0);
+
+	atomic_store(&calls_done, 0);
+	atomic_store(&sync_done, 0);
+
+	// callback is not called while a pre-existing reader is inside
+	rcu_read_lock(rcu_ctx, thread_id);
+	rcu_call(rcu_ctx, count_callback, malloc(sizeof(shared_object_t)));
+
+	pthread_create(&thread, NULL, barrier_thread, NULL);
+
+	usleep(5 * RCU_RECLAIM_DELAY_MS * 1000);
+	assert(!atomic_load(&calls_done));
+	assert(!atomic_load(&sync_done));
+
+	rcu_read_unlock(rcu_ctx, thread_id);
+	pthread_join(thread, NULL);
+
+	assert(atomic_load(&calls_done) == 1);
+}
+
+static void test_barrier(void)
+{
+	printf("================ BARRIER ================\n");
+
+	rcu_ctx = rcu_create();
+	assert(rcu_ctx);
+
+	test_calls();
+	test_barrier_grace_period();
+
+	rcu_destroy(rcu_ctx);
+
+	printf("SUCCESS\n");
+}
+
+static void test_reclaimer(void)
+{
+	struct timespec start, end;
+	clockid_t clock;
+
+	printf("=============== RECLAIMER ===============\n");
+
+	assert(!rcu_create_flags(~RCU_FLAGS_MASK));
+
+	rcu_ctx = rcu_create_flags(RCU_RECLAIM_THREAD);
+	assert(rcu_ctx);
+
+	test_calls();
+	test_barrier_grace_period();
+
+	// reclaimer runs callbacks without a barrier
+	atomic_store(&calls_done, 0);
+	rcu_call(rcu_ctx, count_callback, malloc(sizeof(shared_object_t)));
+
+	while (!atomic_load(&calls_done))
+		usleep(1000);
+
+	// idle reclaimer sleeps without timeout (no cpu time)
+	usleep(2 * RCU_RECLAIM_DELAY_MS * 1000);
+	assert(!pthread_getcpuclockid(rcu_ctx->reclaimer, &clock));
+
+	clock_gettime(clock, &start);
+	usleep(10 * RCU_RECLAIM_DELAY_MS * 1000);
+	clock_gettime(clock, &end);
+
+	assert(start.tv_sec == end.tv_sec && start.tv_nsec == end.tv_nsec);
+
+	// pending callbacks are called on destroy
+	rcu_call(rcu_ctx, count_callback, malloc(sizeof(shared_object_t)));
+	rcu_destroy(rcu_ctx);
+	assert(atomic_load(&calls_done) == 2);
+
+	printf("SUCCESS\n");
+}
+
+
 /*****************************************************************************/
 
 int main()
@@ -152,6 +464,22 @@ int main()
 	rcu_destroy(rcu_ctx);
 
 	free(shared_ptr);
+	shared_ptr = NULL;
+
+	//
+	rcu_ctx = rcu_create();
+	assert(rcu_ctx);
+
+	test_grace_period();
+	test_blocking();
+	test_no_starvation();
+
+	rcu_destroy(rcu_ctx);
+	free(shared_ptr);
+
+	//
+	test_barrier();
+	test_reclaimer();
 
 	printf("[MAIN] All threads done. Test completed.\n");
 	return 0;
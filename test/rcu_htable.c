@@ -0,0 +1,182 @@
+/**
+ * RCU protected hash table test.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "htable/rcu_htable.h"
+
+
+/*****************************************************************************/
+
+#define NUM_READERS						8
+#define NUM_KEYS						1024
+#define WRITER_ITERATIONS				(64 * 1024)
+#define WRITER_RECLAIM_PERIOD			1024
+
+// value = key * VERSION_MAX + version
+#define VERSION_MAX						1000000
+
+
+/*****************************************************************************/
+
+static uint32_t u64_hash(void *key)
+{
+	uint64_t k = *(uint64_t *)key;
+
+	return (uint32_t)(k ^ (k >> 32));
+}
+
+static int u64_cmp(void *a, void *b)
+{
+	return *(uint64_t *)a != *(uint64_t *)b;
+}
+
+static void *u64_alloc(void *data)
+{
+	uint64_t *p = malloc(sizeof(uint64_t));
+
+	if (p)
+		*p = *(uint64_t *)data;
+
+	return p;
+}
+
+static void u64_free(void *data)
+{
+	free(data);
+}
+
+
+/*****************************************************************************/
+
+static rcu_ctx_t *rcu_ctx;
+static rcu_htable_t *table;
+static atomic_int done;
+static atomic_int errors;
+
+
+/*****************************************************************************/
+
+void *reader_thread(void *arg)
+{
+	int thread_id;
+	uint64_t key, *value, found = 0;
+	unsigned int seed = (unsigned int)(intptr_t)arg;
+
+	// register thread
+	thread_id = rcu_register_thread(rcu_ctx);
+
+	while (!atomic_load(&done)) {
+		key = rand_r(&seed) % NUM_KEYS;
+
+		rcu_read_lock(rcu_ctx, thread_id);
+
+		// entry either missing or consistent
+		value = rcu_htable_lookup(table, &key);
+		if (value) {
+			if (*value / VERSION_MAX != key)
+				atomic_fetch_add(&errors, 1);
+
+			found++;
+		}
+
+		rcu_read_unlock(rcu_ctx, thread_id);
+
+		usleep(1); // simulate work
+	}
+
+	printf("[READER %ld] Done (%lu entries found).\n", (intptr_t)arg, found);
+	return NULL;
+}
+
+
+/*****************************************************************************/
+
+void *writer_thread(void *arg)
+{
+	uint64_t key, value;
+	unsigned int seed = 0;
+
+	// register thread
+	rcu_register_thread(rcu_ctx);
+
+	for (uint64_t i = 1; i < WRITER_ITERATIONS; i++) {
+		key = rand_r(&seed) % NUM_KEYS;
+		value = key * VERSION_MAX + i % VERSION_MAX;
+
+		switch (rand_r(&seed) % 3) {
+		case 0:
+			if (rcu_htable_insert(table, &key, &value))
+				assert(rcu_htable_update(table, &key, &value) == 0);
+			break;
+		case 1:
+			if (rcu_htable_update(table, &key, &value))
+				assert(rcu_htable_insert(table, &key, &value) == 0);
+			break;
+		case 2:
+			rcu_htable_delete(table, &key);
+			break;
+		}
+
+		if (i % WRITER_RECLAIM_PERIOD == 0)
+			rcu_htable_reclaim(table);
+	}
+
+	atomic_store(&done, 1);
+
+	printf("[WRITER] Done.\n");
+	return NULL;
+}
+
+
+/*****************************************************************************/
+
+int main()
+{
+	uint64_t key, value;
+	pthread_t readers[NUM_READERS];
+	pthread_t writer;
+
+	rcu_ctx = rcu_create();
+	assert(rcu_ctx);
+
+	table = rcu_htable_create(rcu_ctx, NUM_KEYS, u64_hash, u64_cmp, u64_alloc,
+							u64_free, u64_alloc, u64_free);
+	assert(table);
+
+	//
+	key = 7; value = key * VERSION_MAX;
+	assert(rcu_htable_insert(table, &key, &value) == 0);
+	assert(rcu_htable_insert(table, &key, &value) == -5);
+	assert(*(uint64_t *)rcu_htable_lookup(table, &key) == value);
+	assert(rcu_htable_delete(table, &key) == 0);
+	assert(rcu_htable_lookup(table, &key) == NULL);
+	assert(rcu_htable_delete(table, &key) == -4);
+
+	//
+	for (intptr_t i = 0; i < NUM_READERS; ++i)
+		pthread_create(&readers[i], NULL, reader_thread, (void *)(i + 1));
+
+	pthread_create(&writer, NULL, writer_thread, NULL);
+
+	for (int i = 0; i < NUM_READERS; ++i)
+		pthread_join(readers[i], NULL);
+
+	pthread_join(writer, NULL);
+
+	//
+	assert(atomic_load(&errors) == 0);
+
+	rcu_htable_destroy(table);
+	rcu_destroy(rcu_ctx);
+
+	printf("[MAIN] All threads done. Test completed.\n");
+	return 0;
+}
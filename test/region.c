@@ -0,0 +1,271 @@
+/**
+ * Region allocator test.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include "allocator/region.h"
+
+
+/*****************************************************************************/
+
+#define TEST_OBJS					4096
+#define TEST_ROUNDS					64
+
+
+/*****************************************************************************/
+
+static inline uint64_t now_ns() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int check_pattern(void *ptr, uint8_t pattern, size_t size) {
+	uint8_t *p = ptr;
+
+	for (size_t i = 0; i < size; ++i) {
+		if (p[i] != pattern)
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/*****************************************************************************/
+
+static void test_alloc(void)
+{
+	region_t *region;
+	void *ptrs[TEST_OBJS];
+	size_t sizes[TEST_OBJS];
+
+	printf("================= ALLOC =================\n");
+
+	region = region_create(NULL, 0);
+	assert(region);
+	assert(region_size(region) == 0);
+
+	// invalid requests
+	assert(!region_alloc(region, 0));
+	assert(!region_alloc_align(region, 8, 3));
+	assert(!region_alloc_align(region, 8, 2 * PAGE_SIZE));
+	assert(!region_alloc(region, SIZE_MAX));
+
+	// random sizes, objects do not overlap
+	for (int i = 0; i < TEST_OBJS; i++) {
+		sizes[i] = 1 + rand() % 512;
+
+		ptrs[i] = region_alloc(region, sizes[i]);
+		assert(ptrs[i]);
+		assert((uintptr_t)ptrs[i] % REGION_ALIGN == 0);
+
+		memset(ptrs[i], i % 255, sizes[i]);
+	}
+
+	for (int i = 0; i < TEST_OBJS; i++)
+		assert(check_pattern(ptrs[i], i % 255, sizes[i]));
+
+	// any alignment
+	for (size_t align = 1; align <= PAGE_SIZE; align <<= 1) {
+		ptrs[0] = region_alloc_align(region, 3, align);
+		assert(ptrs[0] && (uintptr_t)ptrs[0] % align == 0);
+	}
+
+	// larger than a chunk
+	ptrs[0] = region_alloc(region, 4 * REGION_CHUNK_SIZE);
+	assert(ptrs[0]);
+	memset(ptrs[0], 0xA5, 4 * REGION_CHUNK_SIZE);
+
+	region_destroy(region);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static void test_mark_reset(void)
+{
+	region_t *region;
+	region_mark_t empty, mark;
+	void *first, *ptr, *after[3];
+	size_t size;
+
+	printf("============== MARK/RESET ===============\n");
+
+	region = region_create(NULL, PAGE_SIZE);
+	assert(region);
+
+	// checkpoint of an empty region
+	empty = region_mark(region);
+
+	first = region_alloc(region, 64);
+	assert(first);
+
+	// objects after a mark are given back, in any chunk
+	mark = region_mark(region);
+
+	for (int i = 0; i < ARRAY_SIZE(after); i++) {
+		after[i] = region_alloc(region, PAGE_SIZE / 2);
+		assert(after[i]);
+	}
+
+	size = region_size(region);
+	assert(size >= 2 * PAGE_SIZE);
+
+	region_rewind(region, mark);
+
+	for (int i = 0; i < ARRAY_SIZE(after); i++) {
+		ptr = region_alloc(region, PAGE_SIZE / 2);
+		assert(ptr == after[i]);
+	}
+
+	// chunks are reused, no new memory
+	assert(region_size(region) == size);
+
+	region_rewind(region, empty);
+	assert(region_alloc(region, 64) == first);
+
+	region_reset(region);
+	assert(region_alloc(region, 64) == first);
+
+	// chunks past the current position are given back
+	region_trim(region);
+	assert(region_size(region) == PAGE_SIZE);
+
+	region_reset(region);
+	region_rewind(region, empty);
+	assert(region_alloc(region, 64) == first);
+
+	region_destroy(region);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static void test_buddy(void)
+{
+	buddy_t *buddy;
+	region_t *region;
+	void *ptr;
+
+	printf("================= BUDDY =================\n");
+
+	buddy = buddy_init(16 * PAGE_SIZE);
+	assert(buddy);
+
+	region = region_create(buddy, 2 * PAGE_SIZE);
+	assert(region);
+
+	// chunks from buddy
+	for (int i = 0; i < 64; i++) {
+		ptr = region_alloc(region, 256);
+		assert(ptr && buddy_contains(buddy, ptr));
+		memset(ptr, i, 256);
+	}
+
+	// chunk rounded up to power of two pages
+	ptr = region_alloc(region, 5 * PAGE_SIZE);
+	assert(ptr && buddy_contains(buddy, ptr));
+	assert(region_size(region) == 2 * PAGE_SIZE * 3 + 8 * PAGE_SIZE);
+
+	// buddy exhausted, chunks from malloc
+	ptr = region_alloc(region, 8 * PAGE_SIZE);
+	assert(ptr && !buddy_contains(buddy, ptr));
+	memset(ptr, 0xA5, 8 * PAGE_SIZE);
+
+	// chunks given back to buddy
+	region_reset(region);
+	region_trim(region);
+	region_destroy(region);
+
+	ptr = buddy_alloc(buddy, 16 * PAGE_SIZE);
+	assert(ptr);
+	buddy_free(buddy, ptr);
+
+	buddy_destroy(buddy);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+typedef struct test_entry_s {
+	struct test_entry_s *next;
+	char word[24];
+} test_entry_t;
+
+static void test_benchmark(void)
+{
+	region_t *region;
+	test_entry_t *head, *entry, *next;
+	uint64_t start, end;
+
+	printf("=============== BENCHMARK ===============\n");
+
+	region = region_create(NULL, 0);
+	assert(region);
+
+	// lists of entries with the same lifetime
+	start = now_ns();
+	for (int r = 0; r < TEST_ROUNDS; r++) {
+		head = NULL;
+		for (int i = 0; i < TEST_OBJS; i++) {
+			entry = region_alloc(region, sizeof(test_entry_t));
+			entry->next = head;
+			head = entry;
+		}
+
+		region_reset(region);
+	}
+	end = now_ns();
+
+	printf("region_alloc/reset : %.2f ns/op\n",
+		(double)(end - start) / (TEST_ROUNDS * TEST_OBJS));
+
+	//
+	start = now_ns();
+	for (int r = 0; r < TEST_ROUNDS; r++) {
+		head = NULL;
+		for (int i = 0; i < TEST_OBJS; i++) {
+			entry = malloc(sizeof(test_entry_t));
+			entry->next = head;
+			head = entry;
+		}
+
+		for (entry = head; entry; entry = next) {
+			next = entry->next;
+			free(entry);
+		}
+	}
+	end = now_ns();
+
+	printf("malloc/free        : %.2f ns/op\n",
+		(double)(end - start) / (TEST_ROUNDS * TEST_OBJS));
+
+	region_destroy(region);
+}
+
+
+/*****************************************************************************/
+
+int main()
+{
+	test_alloc();
+	test_mark_reset();
+	test_buddy();
+	test_benchmark();
+
+	return 0;
+}
@@ -3,9 +3,12 @@
  * Copyright (C) 2025 Lazar Razvan.
  */
 
+#include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <assert.h>
 #include <pthread.h>
+#include <stdbool.h>
 #include <stdatomic.h>
 #include <unistd.h>
 
@@ -19,6 +22,16 @@
 #define READS_PER_THREAD				10
 #define WRITES_PER_THREAD				5
 
+// exclusion test (more threads than cpus)
+#define STRESS_THREADS					16
+#define STRESS_ITERS					20000
+
+// blocking test (writer section, ms)
+#define BLOCK_WRITER_MS					100
+
+//
+#define MODE(flags)						((flags) & RWLOCK_FAIR ? "fair" : "pref")
+
 
 /*****************************************************************************/
 
@@ -58,11 +71,269 @@ void *writer_thread(void *arg)
 }
 
 
+/*****************************************************************************/
+
+static atomic_int stress_readers;
+static atomic_int stress_writers;
+static long stress_data[3];
+
+static void *stress_thread(void *arg)
+{
+	int id = (int)(intptr_t)arg;
+
+	for (int i = 0; i < STRESS_ITERS; i++) {
+		if ((i + id) % 8) {
+			rwlock_read_lock(rwlock);
+			atomic_fetch_add(&stress_readers, 1);
+			assert(atomic_load(&stress_writers) == 0);
+			assert(stress_data[0] == stress_data[1]);
+			atomic_fetch_sub(&stress_readers, 1);
+
+			// read-modify-write without dropping the lock
+			if (i % 64 == 1 && !rwlock_upgrade(rwlock)) {
+				assert(atomic_fetch_add(&stress_writers, 1) == 0);
+				assert(atomic_load(&stress_readers) == 0);
+				stress_data[2]++;
+				atomic_fetch_sub(&stress_writers, 1);
+				rwlock_downgrade(rwlock);
+			}
+
+			rwlock_read_unlock(rwlock);
+		} else {
+			rwlock_write_lock(rwlock);
+			assert(atomic_fetch_add(&stress_writers, 1) == 0);
+			assert(atomic_load(&stress_readers) == 0);
+			stress_data[0]++;
+			stress_data[1]++;
+			atomic_fetch_sub(&stress_writers, 1);
+			rwlock_write_unlock(rwlock);
+		}
+	}
+
+	return NULL;
+}
+
+static void test_exclusion(uint32_t flags)
+{
+	pthread_t threads[STRESS_THREADS];
+
+	printf("=========== EXCLUSION (%s) ===========\n", MODE(flags));
+
+	rwlock = rwlock_create_flags(flags);
+	assert(rwlock);
+
+	stress_data[0] = stress_data[1] = stress_data[2] = 0;
+
+	for (int i = 0; i < STRESS_THREADS; i++)
+		pthread_create(&threads[i], NULL, stress_thread, (void *)(intptr_t)i);
+
+	for (int i = 0; i < STRESS_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	assert(stress_data[0] == STRESS_THREADS * STRESS_ITERS / 8);
+	assert(atomic_load(&rwlock->sleepers) == 0);
+
+	printf("upgrades: %ld\n", stress_data[2]);
+
+	rwlock_destroy(rwlock);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static void test_trylock(uint32_t flags)
+{
+	printf("============ TRYLOCK (%s) ============\n", MODE(flags));
+
+	rwlock = rwlock_create_flags(flags);
+	assert(rwlock);
+
+	// free lock
+	assert(rwlock_write_trylock(rwlock) == 0);
+	assert(rwlock_read_trylock(rwlock) < 0);
+	assert(rwlock_write_trylock(rwlock) < 0);
+	rwlock_write_unlock(rwlock);
+
+	// readers share the lock
+	assert(rwlock_read_trylock(rwlock) == 0);
+	assert(rwlock_read_trylock(rwlock) == 0);
+	assert(rwlock_write_trylock(rwlock) < 0);
+	rwlock_read_unlock(rwlock);
+	rwlock_read_unlock(rwlock);
+
+	// failed attempts left the lock free
+	assert(rwlock_write_trylock(rwlock) == 0);
+	rwlock_write_unlock(rwlock);
+
+	// upgrade of the only reader, downgrade
+	rwlock_read_lock(rwlock);
+	assert(rwlock_upgrade(rwlock) == 0);
+	assert(rwlock_read_trylock(rwlock) < 0);
+	rwlock_downgrade(rwlock);
+	assert(rwlock_read_trylock(rwlock) == 0);
+	assert(rwlock_write_trylock(rwlock) < 0);
+	rwlock_read_unlock(rwlock);
+	rwlock_read_unlock(rwlock);
+
+	assert(rwlock_write_trylock(rwlock) == 0);
+	rwlock_write_unlock(rwlock);
+
+	rwlock_destroy(rwlock);
+
+	// invalid flags
+	assert(!rwlock_create_flags(~RWLOCK_FLAGS_MASK));
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static atomic_bool upgrade_done;
+
+static void *upgrade_reader(void *arg)
+{
+	rwlock_read_lock(rwlock);
+	usleep(20000);
+	assert(!atomic_load(&upgrade_done));
+	rwlock_read_unlock(rwlock);
+
+	return NULL;
+}
+
+static void test_upgrade(uint32_t flags)
+{
+	pthread_t reader;
+
+	printf("============ UPGRADE (%s) ============\n", MODE(flags));
+
+	rwlock = rwlock_create_flags(flags);
+	assert(rwlock);
+
+	// upgrade waits for the other reader
+	rwlock_read_lock(rwlock);
+	pthread_create(&reader, NULL, upgrade_reader, NULL);
+	usleep(5000);
+
+	assert(rwlock_upgrade(rwlock) == 0);
+	atomic_store(&upgrade_done, true);
+	rwlock_write_unlock(rwlock);
+
+	pthread_join(reader, NULL);
+	atomic_store(&upgrade_done, false);
+
+	rwlock_destroy(rwlock);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static atomic_bool flood_stop;
+
+static void *flood_writer(void *arg)
+{
+	while (!atomic_load(&flood_stop)) {
+		rwlock_write_lock(rwlock);
+		rwlock_pause(64);
+		rwlock_write_unlock(rwlock);
+	}
+
+	return NULL;
+}
+
+static void test_phase_fair(void)
+{
+	pthread_t writers[NUM_WRITERS];
+
+	printf("============== PHASE FAIR ===============\n");
+
+	rwlock = rwlock_create_flags(RWLOCK_FAIR);
+	assert(rwlock);
+
+	// readers make progress between writers
+	for (int i = 0; i < NUM_WRITERS; i++)
+		pthread_create(&writers[i], NULL, flood_writer, NULL);
+
+	for (int i = 0; i < STRESS_ITERS; i++) {
+		rwlock_read_lock(rwlock);
+		rwlock_read_unlock(rwlock);
+	}
+
+	atomic_store(&flood_stop, true);
+
+	for (int i = 0; i < NUM_WRITERS; i++)
+		pthread_join(writers[i], NULL);
+
+	rwlock_destroy(rwlock);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static uint64_t thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *blocked_reader(void *arg)
+{
+	uint64_t start = thread_cpu_ns();
+
+	rwlock_read_lock(rwlock);
+	rwlock_read_unlock(rwlock);
+
+	*(uint64_t *)arg = thread_cpu_ns() - start;
+
+	return NULL;
+}
+
+static void test_blocking(uint32_t flags)
+{
+	pthread_t threads[NUM_READERS];
+	uint64_t cpu_ns[NUM_READERS];
+
+	printf("=========== BLOCKING (%s) ============\n", MODE(flags));
+
+	rwlock = rwlock_create_flags(flags);
+	assert(rwlock);
+
+	// readers sleep while writer holds the lock
+	rwlock_write_lock(rwlock);
+
+	for (int i = 0; i < NUM_READERS; i++)
+		pthread_create(&threads[i], NULL, blocked_reader, &cpu_ns[i]);
+
+	usleep(BLOCK_WRITER_MS * 1000);
+	rwlock_write_unlock(rwlock);
+
+	for (int i = 0; i < NUM_READERS; i++) {
+		pthread_join(threads[i], NULL);
+
+		printf("reader %d cpu time: %.3f ms\n", i, cpu_ns[i] / 1e6);
+		assert(cpu_ns[i] < BLOCK_WRITER_MS * 1000000ULL / 4);
+	}
+
+	rwlock_destroy(rwlock);
+
+	printf("SUCCESS\n");
+}
+
+
 /*****************************************************************************/
 
 int main() {
 	pthread_t readers[NUM_READERS];
 	pthread_t writers[NUM_WRITERS];
+	uint32_t modes[] = { 0, RWLOCK_FAIR };
 
 	rwlock = rwlock_create();
 	if (!rwlock) {
@@ -87,5 +358,16 @@ int main() {
 	}
 
 	rwlock_destroy(rwlock);
+
+	//
+	for (int i = 0; i < ARRAY_SIZE(modes); i++) {
+		test_trylock(modes[i]);
+		test_upgrade(modes[i]);
+		test_exclusion(modes[i]);
+		test_blocking(modes[i]);
+	}
+
+	test_phase_fair();
+
 	return 0;
 }
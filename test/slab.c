@@ -4,6 +4,13 @@
 #include <time.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 
 #include "allocator/slab.h"
 
@@ -335,7 +342,284 @@ static void __slab_test3(void)
 
 /*****************************************************************************/
 
-#if RED_ZONE
+#define TEST5_THREADS		8
+#define TEST5_ROUNDS		256
+#define TEST5_OBJS			512
+#define TEST5_OBJ_SIZE		64
+
+static slab_cache_t *test5_cache;
+
+// objects handed over by thread i and freed by thread (i + 1) % TEST5_THREADS
+static void *test5_ptrs[TEST5_THREADS][TEST5_OBJS];
+static pthread_barrier_t test5_barrier;
+
+
+static void *__slab_test5_thread(void *arg)
+{
+	int id = (int)(intptr_t)arg;
+	int peer = (id + TEST5_THREADS - 1) % TEST5_THREADS;
+	uint8_t pattern;
+
+	for (int r = 0; r < TEST5_ROUNDS; r++) {
+		pattern = (id * TEST5_ROUNDS + r) % 255;
+
+		// alloc + write
+		for (int j = 0; j < TEST5_OBJS; j++) {
+			test5_ptrs[id][j] = slab_cache_alloc(test5_cache, SLAB_CPU_ANY);
+			assert(test5_ptrs[id][j]);
+			memset(test5_ptrs[id][j], pattern, TEST5_OBJ_SIZE);
+		}
+
+		pthread_barrier_wait(&test5_barrier);
+
+		// check + free objects of peer thread
+		pattern = (peer * TEST5_ROUNDS + r) % 255;
+		for (int j = 0; j < TEST5_OBJS; j++) {
+			assert(check_pattern(test5_ptrs[peer][j], pattern, TEST5_OBJ_SIZE));
+			slab_cache_free(test5_cache, test5_ptrs[peer][j], SLAB_CPU_ANY);
+		}
+
+		pthread_barrier_wait(&test5_barrier);
+	}
+
+	return NULL;
+}
+
+
+static void __slab_test5(void)
+{
+	uint64_t start, end;
+	pthread_t threads[TEST5_THREADS];
+
+	printf("================= TEST5 =================\n");
+	printf("%d threads, %d rounds of %d cross thread alloc/free...\n",
+		TEST5_THREADS, TEST5_ROUNDS, TEST5_OBJS);
+
+	test5_cache = slab_cache_create(TEST5_OBJ_SIZE, "struct test5");
+	assert(test5_cache);
+
+	pthread_barrier_init(&test5_barrier, NULL, TEST5_THREADS);
+
+	start = now_ns();
+
+	for (intptr_t i = 0; i < TEST5_THREADS; i++)
+		pthread_create(&threads[i], NULL, __slab_test5_thread, (void *)i);
+
+	for (int i = 0; i < TEST5_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	end = now_ns();
+
+	printf("Time: %.2f ms\n", (end - start) / 1e6);
+
+	// all magazines are in depot now
+	slab_cache_shrink(test5_cache, 0);
+
+	pthread_barrier_destroy(&test5_barrier);
+	slab_cache_destroy(test5_cache);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static int test6_no = 4096;
+static int test6_size[] = {4, 8, 12, 24, 100, 1024, 1536, 3072, 8192};
+static uint32_t test6_flags[] = {SLAB_ALIGN_8, SLAB_ALIGN_16,
+								SLAB_HWCACHE_ALIGN};
+
+
+static void __slab_test6(void)
+{
+	void **ptrs;
+	int obj_size;
+	size_t align;
+	slab_cache_t *slab_cache;
+
+	printf("================= TEST6 =================\n");
+
+	ptrs = malloc(test6_no * sizeof(void *));
+	assert(ptrs);
+
+	//
+	for (int f = 0; f < ARRAY_SIZE(test6_flags); f++) {
+		for (int i = 0; i < ARRAY_SIZE(test6_size); i++) {
+			obj_size = test6_size[i];
+
+			slab_cache = slab_cache_create_flags(obj_size, "struct test6",
+												test6_flags[f]);
+			assert(slab_cache);
+
+			align = slab_cache->align;
+
+			printf("size %4d align %2lu: order %lu, %3lu objects per slab\n",
+				obj_size, align, slab_cache->slab_order,
+				slab_cache->obj_per_slab);
+
+			// slab is large enough to waste little memory
+			assert(slab_cache->obj_per_slab);
+			assert(slab_cache->slab_size == PAGE_SIZE << slab_cache->slab_order);
+
+			// alloc + write
+			for (int j = 0; j < test6_no; j++) {
+				ptrs[j] = SLAB_CACHE_ALLOC(slab_cache);
+				assert(ptrs[j]);
+				assert((uintptr_t)ptrs[j] % align == 0);
+				assert(slab_cache_of(ptrs[j]) == slab_cache);
+
+				memset(ptrs[j], j % 255, obj_size);
+			}
+
+			// check + free
+			for (int j = 0; j < test6_no; j++) {
+				assert(check_pattern(ptrs[j], j % 255, obj_size));
+				SLAB_CACHE_FREE(slab_cache, ptrs[j]);
+			}
+
+			slab_cache_destroy(slab_cache);
+		}
+	}
+
+	// invalid flags
+	assert(!slab_cache_create_flags(64, "struct test6", 1U << 31));
+
+	free(ptrs);
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static int test7_no = 64 * 1024;
+
+
+static size_t __slab_free_slabs(slab_cache_t *slab_cache)
+{
+	size_t free_slabs = 0;
+
+	for (int i = 0; i < MAX_CPUS; i++)
+		free_slabs += slab_cache->_cpu[i].free_slabs;
+
+	return free_slabs;
+}
+
+static void __slab_test7(void)
+{
+	void **ptrs;
+	size_t bytes;
+	slab_cache_t *slab_cache;
+
+	printf("================= TEST7 =================\n");
+
+	ptrs = malloc(test7_no * sizeof(void *));
+	assert(ptrs);
+
+	slab_cache = slab_cache_create(64, "struct test7");
+	assert(slab_cache);
+
+	// traffic spike, then all objects freed
+	for (int j = 0; j < test7_no; j++) {
+		ptrs[j] = SLAB_CACHE_ALLOC(slab_cache);
+		assert(ptrs[j]);
+	}
+
+	for (int j = 0; j < test7_no; j++)
+		SLAB_CACHE_FREE(slab_cache, ptrs[j]);
+
+	// slabs above watermark were released on free
+	printf("Free slabs kept: %lu\n", __slab_free_slabs(slab_cache));
+	assert(__slab_free_slabs(slab_cache) <= SLAB_FREE_SLABS_MAX);
+
+	// depot magazines are given back too
+	bytes = slab_reclaim_all();
+	printf("Reclaimed: %lu bytes\n", bytes);
+	assert(bytes > 0);
+	assert(__slab_free_slabs(slab_cache) == 0);
+	assert(slab_cache_reclaim(slab_cache) == 0);
+
+	// no free slab is kept without watermark
+	assert(!slab_cache_set_watermark(slab_cache, 0));
+
+	for (int j = 0; j < test7_no; j++) {
+		ptrs[j] = SLAB_CACHE_ALLOC(slab_cache);
+		assert(ptrs[j]);
+	}
+
+	for (int j = 0; j < test7_no; j++)
+		SLAB_CACHE_FREE(slab_cache, ptrs[j]);
+
+	assert(__slab_free_slabs(slab_cache) == 0);
+
+	slab_cache_destroy(slab_cache);
+
+	free(ptrs);
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static int test4_size[] = {4, 8, 12, 24, 100, 1024};
+
+
+/**
+ * Run a faulty access in a child process, the cache must abort it.
+ */
+static void __slab_test4_abort(void (*fault)(slab_cache_t *, int),
+								uint32_t flags, int obj_size)
+{
+	int status;
+	pid_t pid;
+	slab_cache_t *slab_cache;
+
+	fflush(stdout);
+
+	pid = fork();
+	assert(pid >= 0);
+
+	if (!pid) {
+		slab_cache = slab_cache_create_flags(obj_size, "struct test4", flags);
+		assert(slab_cache);
+
+		fault(slab_cache, obj_size);
+		_exit(0);
+	}
+
+	assert(waitpid(pid, &status, 0) == pid);
+	assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+}
+
+static void __slab_test4_overrun(slab_cache_t *slab_cache, int obj_size)
+{
+	uint8_t *ptr = SLAB_CACHE_ALLOC(slab_cache);
+
+	// one byte past the object
+	ptr[obj_size] = 0x12;
+	SLAB_CACHE_FREE(slab_cache, ptr);
+}
+
+static void __slab_test4_use_after_free(slab_cache_t *slab_cache, int obj_size)
+{
+	uint8_t *ptr = SLAB_CACHE_ALLOC(slab_cache);
+
+	SLAB_CACHE_FREE(slab_cache, ptr);
+	ptr[obj_size - 1] = 0x12;
+
+	// same object given back by the thread magazine
+	ptr = SLAB_CACHE_ALLOC(slab_cache);
+}
+
+static void __slab_test4_double_free(slab_cache_t *slab_cache, int obj_size)
+{
+	void *ptr = SLAB_CACHE_ALLOC(slab_cache);
+
+	// keep slab in use
+	assert(SLAB_CACHE_ALLOC(slab_cache));
+
+	SLAB_CACHE_FREE(slab_cache, ptr);
+	SLAB_CACHE_FREE(slab_cache, ptr);
+}
 
 static void __slab_test4(void)
 {
@@ -343,7 +627,7 @@ static void __slab_test4(void)
 	int obj_size;
 	slab_cache_t *slab_cache;
 
-	printf("================= TEST1 =================\n");
+	printf("================= TEST4 =================\n");
 
 	ptrs = malloc(test1_no * sizeof(void *));
 	if (!ptrs) {
@@ -352,50 +636,387 @@ static void __slab_test4(void)
 	}
 
 	//
-	for (int i = 0; i < ARRAY_SIZE(test1_size); i++) {
-		obj_size = test1_size[i];
+	for (int i = 0; i < ARRAY_SIZE(test4_size); i++) {
+		obj_size = test4_size[i];
 
-		printf("Creating %d objects of size %d...\n", test1_no, obj_size);
+		printf("Debug cache of %d objects of size %d...\n", test1_no, obj_size);
 
 		// create slab cache
-		slab_cache = slab_cache_create(obj_size, "struct test1");
+		slab_cache = slab_cache_create_flags(obj_size, "struct test4",
+											SLAB_ALIGN_8 | SLAB_DEBUG);
 		if (!slab_cache) {
 			fprintf(stderr, "Fail to create slab cache!\n");
 			assert(0);
 		}
 
-		// alloc + corruption
+		// objects are poisoned until written
 		for (int j = 0; j < test1_no; j++) {
 			ptrs[j] = SLAB_CACHE_ALLOC(slab_cache);
 			assert(ptrs[j]);
+			assert((uintptr_t)ptrs[j] % 8 == 0);
+			assert(check_pattern(ptrs[j], SLAB_POISON_FREE, obj_size));
 
-			*(uint8_t*)(ptrs[j] + obj_size) = 0x12;
+			memset(ptrs[j], j % 255, obj_size);
 		}
 
 		// free
 		for (int j = 0; j < test1_no; j++) {
+			assert(check_pattern(ptrs[j], j % 255, obj_size));
 			SLAB_CACHE_FREE(slab_cache, ptrs[j]);
 		}
 
 		// destroy slab cache
 		slab_cache_destroy(slab_cache);
+
+		// faults
+		__slab_test4_abort(__slab_test4_overrun, SLAB_RED_ZONE, obj_size);
+		__slab_test4_abort(__slab_test4_use_after_free, SLAB_POISON, obj_size);
+		__slab_test4_abort(__slab_test4_double_free, SLAB_CONSISTENCY_CHECKS,
+							obj_size);
+	}
+
+	free(ptrs);
+	printf("SUCCESS\n");
+}
+
+/*****************************************************************************/
+
+#define test8_no		4096
+
+static int __slab_page_node(void *ptr)
+{
+	int node = -1;
+
+	if (syscall(SYS_get_mempolicy, &node, NULL, 0, ptr,
+				MPOL_F_NODE | MPOL_F_ADDR))
+		return -1;
+
+	return node;
+}
+
+static void __slab_test8(void)
+{
+	void **ptrs;
+	slab_cache_t *slab_cache[3];
+	int obj_size[] = {64, 1024, 2 * PAGE_SIZE};
+
+	printf("================= TEST8 =================\n");
+
+	ptrs = malloc(test8_no * sizeof(void *));
+	assert(ptrs);
+
+	// invalid nodes
+	assert(!slab_cache_create_node(64, "struct test8", 0, SLAB_MAX_NODES));
+	assert(!slab_cache_create_node(64, "struct test8", 0, -2));
+
+	// node 0 caches share the node arena
+	for (int i = 0; i < ARRAY_SIZE(obj_size); i++) {
+		slab_cache[i] = slab_cache_create_node(obj_size[i], "struct test8",
+												SLAB_HWCACHE_ALIGN, 0);
+		assert(slab_cache[i]);
+		assert(slab_cache[i]->arena == slab_cache[0]->arena);
+		assert(slab_cache[i]->flags & SLAB_HUGEPAGE);
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(obj_size); i++) {
+		for (int j = 0; j < test8_no; j++) {
+			ptrs[j] = SLAB_CACHE_ALLOC(slab_cache[i]);
+			assert(ptrs[j]);
+			assert(buddy_contains(slab_cache[i]->arena, ptrs[j]));
+			assert(slab_cache_of(ptrs[j]) == slab_cache[i]);
+
+			memset(ptrs[j], j % 255, obj_size[i]);
+		}
+
+		// pages are placed on the node when touched
+		assert(__slab_page_node(ptrs[0]) == 0);
+		assert(__slab_page_node(ptrs[test8_no - 1]) == 0);
+
+		for (int j = 0; j < test8_no; j++) {
+			assert(check_pattern(ptrs[j], j % 255, obj_size[i]));
+			SLAB_CACHE_FREE(slab_cache[i], ptrs[j]);
+		}
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(obj_size); i++)
+		slab_cache_destroy(slab_cache[i]);
+
+	// huge pages arena without node
+	slab_cache[0] = slab_cache_create_flags(64, "struct test8", SLAB_HUGEPAGE);
+	assert(slab_cache[0] && slab_cache[0]->arena);
+	assert(slab_cache[0]->nid == SLAB_NODE_ANY);
+
+	ptrs[0] = SLAB_CACHE_ALLOC(slab_cache[0]);
+	assert(buddy_contains(slab_cache[0]->arena, ptrs[0]));
+	SLAB_CACHE_FREE(slab_cache[0], ptrs[0]);
+
+	slab_cache_destroy(slab_cache[0]);
+
+	free(ptrs);
+	printf("SUCCESS\n");
+}
+
+/*****************************************************************************/
+
+#define TEST9_CACHES		(PTHREAD_KEYS_MAX + 64)
+
+static slab_cache_t *test9_caches[TEST9_CACHES];
+
+
+static void *__slab_test9_thread(void *arg)
+{
+	void *ptr;
+
+	// magazines of every cache, given back at thread exit
+	for (int i = 0; i < TEST9_CACHES; i++) {
+		ptr = SLAB_CACHE_ALLOC(test9_caches[i]);
+		assert(ptr);
+		memset(ptr, i % 255, 64);
+		SLAB_CACHE_FREE(test9_caches[i], ptr);
+	}
+
+	return NULL;
+}
+
+static void __slab_test9(void)
+{
+	void *ptr;
+	pthread_t thread;
+
+	printf("================= TEST9 =================\n");
+
+	// caches are not limited by thread keys
+	for (int i = 0; i < TEST9_CACHES; i++) {
+		test9_caches[i] = slab_cache_create(64, "struct test9");
+		assert(test9_caches[i]);
+	}
+
+	pthread_create(&thread, NULL, __slab_test9_thread, NULL);
+	pthread_join(thread, NULL);
+
+	__slab_test9_thread(NULL);
+
+	// ids of destroyed caches are reused, stale thread entries are ignored
+	for (int i = 0; i < TEST9_CACHES; i += 2) {
+		slab_cache_destroy(test9_caches[i]);
+		test9_caches[i] = slab_cache_create(128, "struct test9");
+		assert(test9_caches[i]);
 	}
 
+	for (int i = 0; i < TEST9_CACHES; i++) {
+		ptr = SLAB_CACHE_ALLOC(test9_caches[i]);
+		assert(ptr && slab_cache_of(ptr) == test9_caches[i]);
+		SLAB_CACHE_FREE(test9_caches[i], ptr);
+	}
+
+	for (int i = 0; i < TEST9_CACHES; i++)
+		slab_cache_destroy(test9_caches[i]);
+
+	printf("SUCCESS\n");
+}
+
+/*****************************************************************************/
+
+#define TEST10_OBJS			256
+
+static void __slab_test10(void)
+{
+	void *ptrs[TEST10_OBJS];
+	slab_t *slab, *forged;
+	slab_cache_t *slab_cache, *decoy;
+	void *q = NULL;
+
+	printf("================= TEST10 ================\n");
+
+	// multi page slabs, order 0 decoy cache
+	slab_cache = slab_cache_create(1536, "struct test10");
+	decoy = slab_cache_create(64, "struct test10 decoy");
+	assert(slab_cache && decoy);
+	assert(slab_cache->slab_order > 0 && decoy->slab_order == 0);
+
+	for (int i = 0; i < TEST10_OBJS; i++) {
+		ptrs[i] = SLAB_CACHE_ALLOC(slab_cache);
+		assert(ptrs[i]);
+	}
+
+	// an object past the first page of its slab
+	for (int i = 0; i < TEST10_OBJS && !q; i++) {
+		slab = (slab_t *)((uintptr_t)ptrs[i] & ~(slab_cache->slab_size - 1));
+		if ((void *)PAGE_PTR_ALIGN((uintptr_t)ptrs[i] + 1) - PAGE_SIZE >
+			(void *)slab)
+			q = ptrs[i];
+	}
+	assert(q);
+
+	/******************************************************
+	 * Object bytes at the page start look like a header
+	 ******************************************************/
+	forged = (slab_t *)((uintptr_t)q & ~(PAGE_SIZE - 1));
+
+	// unregistered cache
+	memset(forged, 0, sizeof(slab_t));
+	forged->magic = SLAB_MAGIC;
+	forged->order = 0;
+	forged->cache_id = 0;
+	forged->slab_cache = (slab_cache_t *)ptrs[0];
+	assert(slab_cache_of(q) == slab_cache);
+
+	// registered cache, other id
+	forged->cache_id = SLAB_MAX_CACHES - 1;
+	forged->slab_cache = decoy;
+	assert(slab_cache_of(q) == slab_cache);
+
+	// registered cache of another order
+	forged->cache_id = decoy->id;
+	forged->slab_cache = decoy;
+	forged->order = 1;
+	assert(slab_cache_of(q) == slab_cache);
+
+	memset(forged, 0, sizeof(slab_t));
+
+	for (int i = 0; i < TEST10_OBJS; i++)
+		SLAB_CACHE_FREE(slab_cache, ptrs[i]);
+
+	slab_cache_destroy(decoy);
+	slab_cache_destroy(slab_cache);
+
+	printf("SUCCESS\n");
+}
+
+/*****************************************************************************/
+
+#define TEST11_OBJS			4096
+#define TEST11_BLKS			4096
+
+static void __slab_test11(void)
+{
+	void **ptrs, **blks;
+	int blks_no = 0;
+	buddy_t *arena;
+	slab_cache_t *idle, *busy;
+	void *ptr;
+
+	printf("================= TEST11 ================\n");
+
+	ptrs = malloc(TEST11_OBJS * sizeof(void *));
+	blks = malloc(TEST11_BLKS * sizeof(void *));
+	assert(ptrs && blks);
+
+	// two caches sharing an arena
+	idle = slab_cache_create_flags(64, "struct test11 idle", SLAB_HUGEPAGE);
+	busy = slab_cache_create_flags(256, "struct test11 busy", SLAB_HUGEPAGE);
+	assert(idle && busy && idle->arena == busy->arena);
+	arena = idle->arena;
+
+	// free slabs of idle are kept (arena memory)
+	assert(!slab_cache_set_watermark(idle, TEST11_OBJS));
+
+	for (int j = 0; j < TEST11_OBJS; j++) {
+		ptrs[j] = SLAB_CACHE_ALLOC(idle);
+		assert(ptrs[j] && buddy_contains(arena, ptrs[j]));
+	}
+
+	for (int j = 0; j < TEST11_OBJS; j++)
+		SLAB_CACHE_FREE(idle, ptrs[j]);
+
+	assert(__slab_free_slabs(idle) > 0);
+
+	// nothing to give back to another buddy
+	assert(slab_shrinker(NULL) == 0);
+
+	/******************************************************
+	 * Exhaust the arena without its shrinker
+	 ******************************************************/
+	assert(!buddy_unregister_shrinker(arena, slab_shrinker, arena));
+
+	for (int order = arena->orders; order >= 0; order--) {
+		while ((ptr = buddy_alloc(arena, ORDER_2_SIZE(order)))) {
+			assert(blks_no < TEST11_BLKS);
+			blks[blks_no++] = ptr;
+		}
+	}
+
+	assert(!buddy_alloc(arena, PAGE_SIZE));
+
+	/******************************************************
+	 * New slab of busy: the arena allocation fails, the
+	 * shrinker gives the free slabs of idle back and the
+	 * retried allocation succeeds (from busy allocation
+	 * path, no self deadlock)
+	 ******************************************************/
+	assert(!buddy_register_shrinker(arena, slab_shrinker, arena));
+
+	ptr = SLAB_CACHE_ALLOC(busy);
+	assert(ptr && buddy_contains(arena, ptr));
+	assert(__slab_free_slabs(idle) == 0);
+
+	// idle has nothing left to give, busy holds all reclaimed memory
+	while ((blks[blks_no] = buddy_alloc(arena, PAGE_SIZE)))
+		assert(++blks_no < TEST11_BLKS);
+
+	assert(slab_shrinker(arena) == 0);
+
+	//
+	SLAB_CACHE_FREE(busy, ptr);
+
+	for (int j = 0; j < blks_no; j++)
+		buddy_free(arena, blks[j]);
+
+	slab_cache_destroy(busy);
+	slab_cache_destroy(idle);
+
+	free(blks);
 	free(ptrs);
 	printf("SUCCESS\n");
 }
 
-#endif // RED_ZONE
+/*****************************************************************************/
 
 /*****************************************************************************/
 
+static void __slab_test12(void)
+{
+	slab_cache_t *slab_cache;
+	void *ptr;
+
+	printf("================= TEST12 ================\n");
+
+	// cpu id is validated without debug flags
+	slab_cache = slab_cache_create(64, "struct test12");
+	assert(slab_cache);
+
+	assert(!slab_cache_alloc(slab_cache, MAX_CPUS + 4));
+	assert(!slab_cache_alloc(slab_cache, MAX_CPUS));
+	assert(!slab_cache_alloc(slab_cache, -2));
+
+	ptr = slab_cache_alloc(slab_cache, MAX_CPUS - 1);
+	assert(ptr);
+
+	// rejected free leaves the object allocated (freed once below)
+	slab_cache_free(slab_cache, ptr, MAX_CPUS);
+	slab_cache_free(slab_cache, ptr, SLAB_CPU_ANY);
+
+	ptr = slab_cache_alloc(slab_cache, 0);
+	assert(ptr && ptr != slab_cache_alloc(slab_cache, 0));
+
+	slab_cache_destroy(slab_cache);
+
+	printf("SUCCESS\n");
+}
+
 int main() {
 	__slab_test1();
 	__slab_test2();
 	__slab_test3();
-#if RED_ZONE
 	__slab_test4();
-#endif
+	__slab_test5();
+	__slab_test6();
+	__slab_test7();
+	__slab_test8();
+	__slab_test9();
+	__slab_test10();
+	__slab_test11();
+	__slab_test12();
 
 	return 0;
 }
@@ -0,0 +1,260 @@
+/**
+ * Slab size classes (slab_malloc) test.
+ * Copyright (C) 2025 Lazar Razvan.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "allocator/slab_malloc.h"
+
+
+/*****************************************************************************/
+
+#define TEST_OBJS					4096
+#define TEST_THREADS				4
+#define TEST_ROUNDS					64
+
+
+/*****************************************************************************/
+
+static inline uint64_t now_ns() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int check_pattern(void *ptr, uint8_t pattern, size_t size) {
+	uint8_t *p = ptr;
+
+	for (size_t i = 0; i < size; ++i) {
+		if (p[i] != pattern)
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/*****************************************************************************/
+
+static void test_size_classes(void)
+{
+	size_t class, prev = 0;
+
+	printf("============= SIZE CLASSES ==============\n");
+
+	//
+	for (size_t size = 1; size <= SLAB_MALLOC_MAX_SIZE; size++) {
+		class = slab_malloc_class_size(size);
+
+		// smallest class that fits the size
+		assert(class >= size);
+		assert(class >= prev);
+		assert(prev < size || class == prev);
+
+		if (class != prev)
+			printf("class %zu\n", class);
+
+		prev = class;
+	}
+
+	assert(slab_malloc_class_size(0) == 0);
+	assert(slab_malloc_class_size(SLAB_MALLOC_MAX_SIZE + 1) == 0);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static void test_alloc_free(void)
+{
+	void **ptrs;
+	size_t *sizes;
+
+	printf("============== ALLOC/FREE ===============\n");
+
+	ptrs = malloc(TEST_OBJS * sizeof(void *));
+	sizes = malloc(TEST_OBJS * sizeof(size_t));
+	assert(ptrs && sizes);
+
+	// random sizes of all classes
+	for (int i = 0; i < TEST_OBJS; i++) {
+		sizes[i] = 1 + rand() % SLAB_MALLOC_MAX_SIZE;
+
+		ptrs[i] = slab_malloc(sizes[i]);
+		assert(ptrs[i]);
+		assert(slab_cache_of(ptrs[i])->obj_size ==
+				slab_malloc_class_size(sizes[i]));
+
+		memset(ptrs[i], i % 255, sizes[i]);
+	}
+
+	//
+	for (int i = 0; i < TEST_OBJS; i++) {
+		assert(check_pattern(ptrs[i], i % 255, sizes[i]));
+		slab_free(ptrs[i]);
+	}
+
+	free(sizes);
+	free(ptrs);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static void test_large(buddy_t *buddy)
+{
+	void *small, *large[4];
+	size_t sizes[] = { SLAB_MALLOC_MAX_SIZE + 1, PAGE_SIZE, 3 * PAGE_SIZE,
+						8 * PAGE_SIZE };
+
+	printf("================= LARGE =================\n");
+
+	small = slab_malloc(64);
+	assert(small);
+
+	// served by buddy
+	for (int i = 0; i < ARRAY_SIZE(sizes); i++) {
+		large[i] = slab_malloc(sizes[i]);
+		assert(large[i]);
+		assert(buddy_contains(buddy, large[i]));
+
+		memset(large[i], i, sizes[i]);
+	}
+
+	//
+	for (int i = 0; i < ARRAY_SIZE(sizes); i++) {
+		assert(check_pattern(large[i], i, sizes[i]));
+		slab_free(large[i]);
+	}
+
+	// buddy memory is available again
+	large[0] = slab_malloc(8 * PAGE_SIZE);
+	assert(large[0]);
+	slab_free(large[0]);
+
+	slab_free(small);
+	slab_free(NULL);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static void *test_thread(void *arg)
+{
+	void *ptrs[256];
+	unsigned int seed = (unsigned int)(intptr_t)arg;
+	size_t size;
+
+	for (int r = 0; r < TEST_ROUNDS; r++) {
+		for (int i = 0; i < ARRAY_SIZE(ptrs); i++) {
+			size = 1 + rand_r(&seed) % 512;
+
+			ptrs[i] = slab_malloc(size);
+			assert(ptrs[i]);
+			memset(ptrs[i], 0xA5, size);
+		}
+
+		for (int i = 0; i < ARRAY_SIZE(ptrs); i++)
+			slab_free(ptrs[i]);
+	}
+
+	return NULL;
+}
+
+static void test_threads(void)
+{
+	pthread_t threads[TEST_THREADS];
+
+	printf("================ THREADS ================\n");
+
+	for (intptr_t i = 0; i < TEST_THREADS; i++)
+		pthread_create(&threads[i], NULL, test_thread, (void *)(i + 1));
+
+	for (int i = 0; i < TEST_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	printf("SUCCESS\n");
+}
+
+
+/*****************************************************************************/
+
+static void test_benchmark(void)
+{
+	void **ptrs;
+	uint64_t start, end;
+
+	printf("=============== BENCHMARK ===============\n");
+
+	ptrs = malloc(TEST_OBJS * sizeof(void *));
+	assert(ptrs);
+
+	//
+	start = now_ns();
+	for (int r = 0; r < TEST_ROUNDS; r++) {
+		for (int i = 0; i < TEST_OBJS; i++)
+			ptrs[i] = slab_malloc(16 + i % 256);
+		for (int i = 0; i < TEST_OBJS; i++)
+			slab_free(ptrs[i]);
+	}
+	end = now_ns();
+
+	printf("slab_malloc/slab_free : %.2f ns/op\n",
+		(double)(end - start) / (TEST_ROUNDS * TEST_OBJS));
+
+	//
+	start = now_ns();
+	for (int r = 0; r < TEST_ROUNDS; r++) {
+		for (int i = 0; i < TEST_OBJS; i++)
+			ptrs[i] = malloc(16 + i % 256);
+		for (int i = 0; i < TEST_OBJS; i++)
+			free(ptrs[i]);
+	}
+	end = now_ns();
+
+	printf("malloc/free           : %.2f ns/op\n",
+		(double)(end - start) / (TEST_ROUNDS * TEST_OBJS));
+
+	free(ptrs);
+}
+
+
+/*****************************************************************************/
+
+int main()
+{
+	buddy_t *buddy;
+
+	//
+	buddy = buddy_init(32 * PAGE_SIZE);
+	assert(buddy);
+
+	assert(slab_malloc(8) == NULL);
+	assert(slab_malloc_init(buddy) == 0);
+	assert(slab_malloc_init(buddy) < 0);
+
+	//
+	test_size_classes();
+	test_alloc_free();
+	test_large(buddy);
+	test_threads();
+	test_benchmark();
+
+	//
+	slab_malloc_destroy();
+	buddy_destroy(buddy);
+
+	return 0;
+}